@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#include <sequence/midi.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief How allocate_channels() picks among the free channels.
+ */
+enum class ChannelPolicy : std::uint8_t
+{
+    /// Takes the first free channel after the one used last, cycling through the range.
+    round_robin,
+    /// Takes the free channel that has been silent the longest, which gives the
+    /// release tail of its last note the most time before it is bent again.
+    least_recently_used,
+};
+
+/**
+ * @brief The channels allocate_channels() may use, and how it picks among them.
+ *
+ * Channels are zero-based, [first_channel, first_channel + channel_count) must lie
+ * within the 16 MIDI channels.
+ */
+struct ChannelAllocation
+{
+    std::uint8_t first_channel = 0;
+    std::uint8_t channel_count = 16;
+    ChannelPolicy policy = ChannelPolicy::round_robin;
+
+    auto operator==(ChannelAllocation const &) const -> bool = default;
+    auto operator!=(ChannelAllocation const &) const -> bool = default;
+};
+
+/**
+ * @brief Returns the member channels of an MPE lower zone.
+ *
+ * The lower zone's manager channel is channel 0, its members are channels 1 to
+ * \p member_channels.
+ *
+ * @throws std::invalid_argument if \p member_channels is not in [1, 15].
+ */
+[[nodiscard]]
+auto mpe_lower_zone(std::uint8_t member_channels,
+                    ChannelPolicy policy = ChannelPolicy::least_recently_used)
+    -> ChannelAllocation;
+
+/**
+ * @brief Returns the member channels of an MPE upper zone.
+ *
+ * The upper zone's manager channel is channel 15, its members are the
+ * \p member_channels channels below it.
+ *
+ * @throws std::invalid_argument if \p member_channels is not in [1, 15].
+ */
+[[nodiscard]]
+auto mpe_upper_zone(std::uint8_t member_channels,
+                    ChannelPolicy policy = ChannelPolicy::least_recently_used)
+    -> ChannelAllocation;
+
+/**
+ * @brief Assigns each note its own channel, so per-note pitch bends do not collide.
+ *
+ * Makes one pass over \p notes, which must be sorted by begin, such as the output of
+ * lazy_flatten_to_midi() or Timeline::notes(). A channel is free once the note on it
+ * has ended, and each note takes a free channel chosen by \p allocation.policy. When
+ * every channel is busy, the note steals the channel of the oldest sounding note,
+ * whose end is cut to the begin of the new note. O(n * channel_count).
+ *
+ * @param notes The notes to assign channels to, updated in place.
+ * @param allocation The channels to use and the policy to pick them by.
+ * @return std::size_t - The number of notes that were cut short by voice stealing.
+ * @throws std::invalid_argument if \p allocation does not describe a range of MIDI
+ * channels, or if \p notes is not sorted by begin.
+ */
+auto allocate_channels(std::span<TimedMidiNote> notes,
+                       ChannelAllocation const &allocation) -> std::size_t;
+
+} // namespace sequence::midi
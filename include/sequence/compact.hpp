@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include <sequence/midi.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief Removes the notes of \p notes that would only add MIDI messages, and sorts
+ * the rest by begin.
+ *
+ * Notes with end <= begin are dropped, they have no duration to sound. Notes that
+ * overlap an earlier note with the same channel, note, velocity and pitch bend are
+ * merged into it, extending it to the later end; on a MIDI port the second note on
+ * would only retrigger a note that is already sounding, and the first note off would
+ * cut both short. Notes that merely touch are kept apart.
+ *
+ * The notes that remain keep their relative order among notes that begin together.
+ * O(n log n) for the sort, then one linear pass.
+ *
+ * @param notes The notes to compact, in any order, updated in place.
+ * @return std::size_t - The number of notes removed.
+ */
+auto compact_notes(std::vector<TimedMidiNote> &notes) -> std::size_t;
+
+/**
+ * @brief Removes the pitch_bend events of \p events that repeat the last pitch bend
+ * sent on their channel.
+ *
+ * \p events must be sorted by time, such as the output of flatten_to_midi_events().
+ * Repeated material renders long runs of notes with the same bend, and each note
+ * starts with a pitch_bend event; only the first of each run changes anything. The
+ * first pitch_bend of each channel is always kept, as the receiver's state is unknown.
+ * One linear pass.
+ *
+ * @param events The time-sorted events to compact, updated in place.
+ * @return std::size_t - The number of events removed.
+ */
+auto remove_redundant_pitch_bends(std::vector<MidiEvent> &events) -> std::size_t;
+
+} // namespace sequence::midi
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <sequence/sequence.hpp>
+
+namespace sequence
+{
+
+/**
+ * @brief Note storage split into one contiguous array per Note field.
+ *
+ * Entry i of every column describes the same note. Keeping each field contiguous lets
+ * bulk edits such as shifting every velocity run as a tight loop over one array that
+ * the compiler can vectorize.
+ */
+struct NoteColumns
+{
+    std::vector<int> pitch;
+    std::vector<float> velocity;
+    std::vector<float> delay;
+    std::vector<float> gate;
+    std::vector<std::uint32_t> cell; // Index of the FlatSequence cell holding the note.
+
+    [[nodiscard]]
+    auto size() const -> std::size_t
+    {
+        return pitch.size();
+    }
+
+    /**
+     * @brief Reassembles the Note stored at \p index.
+     */
+    [[nodiscard]]
+    auto note(std::size_t index) const -> Note
+    {
+        return Note{pitch[index], velocity[index], delay[index], gate[index]};
+    }
+
+    /**
+     * @brief Appends \p note to every column, owned by the cell at \p cell_index.
+     */
+    auto push_back(Note const &note, std::uint32_t cell_index) -> void
+    {
+        pitch.push_back(note.pitch);
+        velocity.push_back(note.velocity);
+        delay.push_back(note.delay);
+        gate.push_back(note.gate);
+        cell.push_back(cell_index);
+    }
+};
+
+/**
+ * @brief A Cell tree stored in contiguous, index-linked arrays.
+ *
+ * Every Cell, MusicElement, Note and Sequence of a tree lives in a flat array instead
+ * of in its own heap allocation, with Note fields split into NoteColumns. The children
+ * of a node are stored contiguously and referenced by a [begin, begin + count) range
+ * into the next array down, so traversals walk arrays instead of chasing pointers.
+ *
+ * cells[0] is always the root Cell. Nodes are laid out breadth-first, so a parent
+ * Cell always has a lower index than any of its descendants.
+ */
+struct FlatSequence
+{
+    struct CellNode
+    {
+        std::uint32_t elements_begin; // Index into elements.
+        std::uint32_t elements_count;
+        float weight;
+    };
+
+    struct ElementNode
+    {
+        enum class Kind : std::uint8_t
+        {
+            Note,
+            Sequence,
+        };
+
+        Kind kind;
+        std::uint32_t index; // Index into notes or sequences, depending on kind.
+    };
+
+    struct SequenceNode
+    {
+        std::uint32_t cells_begin; // Index into cells.
+        std::uint32_t cells_count;
+    };
+
+    std::vector<CellNode> cells;
+    std::vector<ElementNode> elements;
+    NoteColumns notes;
+    std::vector<SequenceNode> sequences;
+};
+
+/**
+ * @brief Converts a recursive Cell tree into a FlatSequence.
+ *
+ * @param cell The root Cell of the tree.
+ * @return FlatSequence - The flat tree, with \p cell stored at cells[0].
+ */
+[[nodiscard]]
+auto to_flat(Cell const &cell) -> FlatSequence;
+
+/**
+ * @brief Converts a FlatSequence back into a recursive Cell tree.
+ *
+ * This is the inverse of to_flat(), from_flat(to_flat(cell)) == cell.
+ *
+ * @param flat The flat tree to convert.
+ * @return Cell - The root Cell of the tree, or an empty Cell if \p flat has no cells.
+ */
+[[nodiscard]]
+auto from_flat(FlatSequence const &flat) -> Cell;
+
+} // namespace sequence
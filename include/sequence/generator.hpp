@@ -0,0 +1,186 @@
+#pragma once
+
+#include <coroutine>
+#include <cstddef>
+#include <exception>
+#include <iterator>
+#include <memory>
+#include <utility>
+
+namespace sequence
+{
+
+/**
+ * @brief A lazily evaluated input range of values produced by a coroutine.
+ *
+ * A coroutine returning Generator<T> produces its values with co_yield, and runs
+ * only as far as needed to produce the next value each time the range is advanced.
+ * Yielded values are referenced rather than copied, and stay valid until the range is
+ * advanced. An exception thrown by the coroutine is rethrown from begin() or from the
+ * increment that resumed it.
+ *
+ * @example
+ * auto count(int n) -> Generator<int>
+ * {
+ *     for (auto i = 0; i < n; ++i)
+ *     {
+ *         co_yield i;
+ *     }
+ * }
+ */
+template <typename T>
+class Generator
+{
+  public:
+    struct promise_type
+    {
+        T const *value = nullptr;
+        std::exception_ptr exception;
+
+        auto get_return_object() -> Generator
+        {
+            return Generator{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+
+        auto initial_suspend() noexcept -> std::suspend_always
+        {
+            return {};
+        }
+
+        auto final_suspend() noexcept -> std::suspend_always
+        {
+            return {};
+        }
+
+        auto yield_value(T const &yielded) noexcept -> std::suspend_always
+        {
+            value = std::addressof(yielded);
+            return {};
+        }
+
+        auto return_void() noexcept -> void
+        {
+        }
+
+        auto unhandled_exception() noexcept -> void
+        {
+            exception = std::current_exception();
+        }
+
+        // Generators only yield, they cannot await.
+        template <typename U>
+        auto await_transform(U &&) -> std::suspend_never = delete;
+    };
+
+    class Iterator
+    {
+      public:
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+
+        Iterator() = default;
+
+        explicit Iterator(std::coroutine_handle<promise_type> handle) : handle_{handle}
+        {
+        }
+
+        [[nodiscard]]
+        auto operator*() const -> T const &
+        {
+            return *handle_.promise().value;
+        }
+
+        [[nodiscard]]
+        auto operator->() const -> T const *
+        {
+            return handle_.promise().value;
+        }
+
+        auto operator++() -> Iterator &
+        {
+            resume(handle_);
+            return *this;
+        }
+
+        auto operator++(int) -> void
+        {
+            ++*this;
+        }
+
+        [[nodiscard]]
+        friend auto operator==(Iterator const &it, std::default_sentinel_t) -> bool
+        {
+            return !it.handle_ || it.handle_.done();
+        }
+
+      private:
+        std::coroutine_handle<promise_type> handle_;
+    };
+
+    Generator(Generator const &) = delete;
+    auto operator=(Generator const &) -> Generator & = delete;
+
+    Generator(Generator &&other) noexcept
+        : handle_{std::exchange(other.handle_, nullptr)}
+    {
+    }
+
+    auto operator=(Generator &&other) noexcept -> Generator &
+    {
+        if (this != &other)
+        {
+            this->destroy();
+            handle_ = std::exchange(other.handle_, nullptr);
+        }
+        return *this;
+    }
+
+    ~Generator()
+    {
+        this->destroy();
+    }
+
+    /**
+     * @brief Runs the coroutine to its first value, a Generator can only be iterated
+     * once.
+     */
+    [[nodiscard]]
+    auto begin() -> Iterator
+    {
+        resume(handle_);
+        return Iterator{handle_};
+    }
+
+    [[nodiscard]]
+    auto end() const noexcept -> std::default_sentinel_t
+    {
+        return std::default_sentinel;
+    }
+
+  private:
+    explicit Generator(std::coroutine_handle<promise_type> handle) : handle_{handle}
+    {
+    }
+
+    static auto resume(std::coroutine_handle<promise_type> handle) -> void
+    {
+        handle.resume();
+        if (auto exception = std::exchange(handle.promise().exception, nullptr))
+        {
+            std::rethrow_exception(exception);
+        }
+    }
+
+    auto destroy() noexcept -> void
+    {
+        if (handle_)
+        {
+            handle_.destroy();
+        }
+    }
+
+  private:
+    std::coroutine_handle<promise_type> handle_;
+};
+
+} // namespace sequence
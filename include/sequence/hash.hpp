@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+
+namespace sequence
+{
+
+/**
+ * @brief Structural hash of a Note.
+ *
+ * Only the pitch is hashed. velocity, delay, gate and Cell weights are compared with a
+ * tolerance by operator==, which cannot be made consistent with a hash of their
+ * values, so they are left out. Equal values always have equal hashes.
+ */
+[[nodiscard]]
+auto hash(Note const &note) -> std::size_t;
+
+/**
+ * @brief Structural hash of a MusicElement, see hash(Note const &).
+ */
+[[nodiscard]]
+auto hash(MusicElement const &element) -> std::size_t;
+
+/**
+ * @brief Structural hash of a Cell tree, see hash(Note const &).
+ */
+[[nodiscard]]
+auto hash(Cell const &cell) -> std::size_t;
+
+/**
+ * @brief Structural hash of a Sequence tree, see hash(Note const &).
+ */
+[[nodiscard]]
+auto hash(Sequence const &seq) -> std::size_t;
+
+/**
+ * @brief Structural hash of a PersistentCell tree.
+ *
+ * hash(to_persistent(cell)) == hash(cell). Nested sequences contribute their cached
+ * PersistentSequence::structural_hash(), so this is O(size of cell.elements).
+ */
+[[nodiscard]]
+auto hash(PersistentCell const &cell) -> std::size_t;
+
+/**
+ * @brief Structural hash of a PersistentSequence tree.
+ *
+ * Computed from seq.cells and the cached hashes of nested nodes, this is the value
+ * every node caches on construction, see PersistentSequence::structural_hash().
+ */
+[[nodiscard]]
+auto hash(PersistentSequence const &seq) -> std::size_t;
+
+/**
+ * @brief Hash-conses PersistentSequence nodes, so equal subtrees share one node.
+ *
+ * Every Sequence interned through the same Interner that compares equal to one seen
+ * before is replaced by the node already in the table. Repetitive material, such as
+ * the output of modify::repeat, then stores each distinct subtree once, and caches can
+ * key on node pointers since equal subtrees have the same address.
+ *
+ * The table holds a reference to every node it has returned, so nodes live at least as
+ * long as the Interner.
+ */
+class Interner
+{
+  public:
+    /**
+     * @brief Converts \p cell into a PersistentCell made of interned nodes.
+     */
+    [[nodiscard]]
+    auto intern(Cell const &cell) -> PersistentCell;
+
+    /**
+     * @brief Returns a copy of \p cell whose nested sequences are interned nodes.
+     *
+     * Nodes that are already in the table are reused without being visited again.
+     */
+    [[nodiscard]]
+    auto intern(PersistentCell const &cell) -> PersistentCell;
+
+    /**
+     * @brief Returns the number of distinct nodes in the table.
+     */
+    [[nodiscard]]
+    auto size() const -> std::size_t
+    {
+        return nodes_.size();
+    }
+
+    /**
+     * @brief Empties the table, releasing its references to the interned nodes.
+     */
+    auto clear() -> void
+    {
+        buckets_.clear();
+        nodes_.clear();
+    }
+
+  private:
+    /**
+     * @brief Returns the interned node with \p cells, inserting it if it is new.
+     *
+     * The nested sequences of \p cells must already be interned.
+     */
+    [[nodiscard]]
+    auto find_or_insert(std::vector<PersistentCell> cells) -> PersistentSequencePtr;
+
+  private:
+    std::unordered_map<std::size_t, std::vector<PersistentSequencePtr>> buckets_;
+    std::unordered_set<PersistentSequence const *> nodes_;
+};
+
+} // namespace sequence
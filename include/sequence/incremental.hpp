@@ -0,0 +1,164 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/timing.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief Re-renders PersistentCell trees, reusing the notes of unchanged subtrees.
+ *
+ * The render of every nested PersistentSequence is cached per node, hashed by its
+ * structural_hash(), and per length of the sample span it was rendered over. Cached
+ * notes are relative to the start of their span and are shifted as they are spliced
+ * in, so a node repeated at several offsets with the same length is rendered once.
+ * A cached render holds its own notes and refers to the renders of its nested nodes
+ * rather than copying them, so caching a node costs time and memory proportional to
+ * the node itself, not to its subtree.
+ *
+ * Edits made through the persistent API, such as replace_cell() or transform_notes()
+ * on a PersistentCell, only reallocate the nodes along the path to the change and
+ * share every other node. Rendering the edited tree then computes only the new nodes
+ * and copies each note into the result once. A changed weight changes the lengths of
+ * its siblings' spans, so those subtrees are rendered again too.
+ *
+ * Cached entries stay alive while any tree still holds their node, so switching
+ * between the entries of an undo history is cheap as well. Entries for nodes no other
+ * tree holds are released as the cache grows. Each node keeps only the span lengths
+ * the latest render() that reached it used, so renders at an old tempo or length are
+ * dropped once the node is rendered at the new one.
+ *
+ * Produces the same notes, in the same order, as flatten_to_midi applied to
+ * to_cell(root).elements with the same PitchMap.
+ */
+class IncrementalRenderer
+{
+  public:
+    explicit IncrementalRenderer(PitchMap pitch_map);
+
+    /**
+     * @brief Renders the elements of \p root over [sample_offset, sample_offset +
+     * sample_count).
+     *
+     * @return The rendered notes, valid until the next call to render().
+     * @throws std::invalid_argument if any visited Sequence has a total child weight
+     * that is not greater than zero.
+     */
+    auto render(PersistentCell const &root,
+                SampleTime sample_offset,
+                SampleTime sample_count) -> std::vector<TimedMidiNote> const &;
+
+    /**
+     * @brief Returns the number of nodes the last render() computed instead of
+     * reusing from the cache.
+     */
+    [[nodiscard]]
+    auto nodes_rendered() const -> std::size_t
+    {
+        return nodes_rendered_;
+    }
+
+    /**
+     * @brief Returns the number of nodes with cached renders.
+     */
+    [[nodiscard]]
+    auto cache_size() const -> std::size_t
+    {
+        return cache_.size();
+    }
+
+    /**
+     * @brief Returns the number of cached renders, over all nodes and span lengths.
+     */
+    [[nodiscard]]
+    auto render_count() const -> std::size_t;
+
+    /**
+     * @brief Empties the cache, releasing its references to the cached nodes.
+     */
+    auto clear() -> void
+    {
+        cache_.clear();
+        prune_size_ = min_prune_size;
+    }
+
+  private:
+    struct NodeHash
+    {
+        [[nodiscard]]
+        auto operator()(PersistentSequence const *node) const -> std::size_t
+        {
+            return node->structural_hash();
+        }
+    };
+
+    struct Fragment;
+
+    /// An immutable cached render, shared by the renders of the nodes that nest it.
+    using FragmentPtr = std::shared_ptr<Fragment const>;
+
+    struct Render
+    {
+        SampleTime length;
+        FragmentPtr fragment;
+        std::uint64_t generation; // The last render() that used this fragment.
+    };
+
+    struct Entry
+    {
+        PersistentSequencePtr node; // Keeps the key from being reused by a new node.
+        std::vector<Render> renders;
+    };
+
+    class Visitor;
+
+    /**
+     * @brief Returns the cached render of \p seq over a span of \p length samples, or
+     * nullptr.
+     */
+    auto find(PersistentSequencePtr const &seq, SampleTime length) -> FragmentPtr;
+
+    /**
+     * @brief Caches the render of \p seq over a span of \p length samples.
+     */
+    auto store(PersistentSequencePtr const &seq,
+               SampleTime length,
+               FragmentPtr fragment) -> void;
+
+    /**
+     * @brief Marks \p entry as used by the current render(), see evict_stale().
+     */
+    auto touch(Entry &entry, Render &render) -> void;
+
+    /**
+     * @brief Drops the renders of touched entries at span lengths the current render()
+     * did not use.
+     */
+    auto evict_stale() -> void;
+
+    /**
+     * @brief Drops the entries whose node is only held by the cache.
+     */
+    auto prune() -> void;
+
+  private:
+    static constexpr auto min_prune_size = std::size_t{64};
+
+    PitchMap pitch_map_;
+    std::unordered_map<PersistentSequence const *, Entry, NodeHash> cache_;
+    std::vector<TimedMidiNote> notes_;
+    std::vector<PersistentSequence const *> touched_; // Entries used by this render().
+    std::uint64_t generation_ = 0;                   // Counts calls to render().
+    std::size_t nodes_rendered_ = 0;
+    std::size_t prune_size_ = min_prune_size; // Cache size that triggers prune().
+};
+
+} // namespace sequence::midi
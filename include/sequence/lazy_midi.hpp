@@ -0,0 +1,35 @@
+#pragma once
+
+#include <span>
+
+#include <sequence/generator.hpp>
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/timing.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief Lazily flattens simultaneous music elements into timed MIDI notes, in order
+ * of begin.
+ *
+ * Yields the notes of flatten_to_midi(elements, sample_offset, sample_count,
+ * pitch_map) sorted by begin, rendering them only as the range is advanced. Notes
+ * that begin together are yielded in an unspecified but deterministic order. Instead
+ * of the whole timeline, only the cells along the current path, their pending next
+ * siblings and the notes of their simultaneous elements are held in memory.
+ *
+ * \p elements and \p pitch_map are referenced, not copied, and must outlive the
+ * returned Generator.
+ *
+ * @throws std::invalid_argument when the range is advanced to a Sequence whose total
+ * child weight is not greater than zero.
+ */
+[[nodiscard]]
+auto lazy_flatten_to_midi(std::span<MusicElement const> elements,
+                          SampleTime sample_offset,
+                          SampleTime sample_count,
+                          PitchMap const &pitch_map) -> Generator<TimedMidiNote>;
+
+} // namespace sequence::midi
@@ -1,9 +1,14 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
+#include <initializer_list>
+#include <span>
 #include <vector>
 
+#include <sequence/flat.hpp>
 #include <sequence/sequence.hpp>
+#include <sequence/timing.hpp>
 #include <sequence/tuning.hpp>
 
 namespace sequence::midi
@@ -14,19 +19,164 @@ namespace sequence::midi
  *
  * begin and end are absolute sample positions in the rendered timeline. note,
  * velocity, and pitch_bend together describe the MIDI event to play over that span.
+ * channel is the zero-based MIDI channel, the renderers leave it at 0 and
+ * allocate_channels() assigns one per note.
  */
 struct TimedMidiNote
 {
-    std::uint32_t begin;
-    std::uint32_t end;
+    SampleTime begin;
+    SampleTime end;
     std::uint8_t note;
     std::uint8_t velocity;
     std::uint16_t pitch_bend;
+    std::uint8_t channel = 0;
 
     auto operator==(TimedMidiNote const &) const -> bool = default;
     auto operator!=(TimedMidiNote const &) const -> bool = default;
 };
 
+/**
+ * @brief A discrete MIDI event with an absolute sample time.
+ *
+ * note, velocity, pitch_bend and channel are copied from the TimedMidiNote the event
+ * belongs to, except that note_off events have a velocity of 0.
+ */
+struct MidiEvent
+{
+    /// Ordered the way events at the same time are sent.
+    enum class Kind : std::uint8_t
+    {
+        note_off,
+        pitch_bend,
+        note_on,
+    };
+
+    SampleTime time;
+    Kind kind;
+    std::uint8_t note;
+    std::uint8_t velocity;
+    std::uint16_t pitch_bend;
+    std::uint8_t channel = 0;
+
+    auto operator==(MidiEvent const &) const -> bool = default;
+    auto operator!=(MidiEvent const &) const -> bool = default;
+};
+
+/**
+ * @brief A MIDI note to represent any microtone using pitch bend.
+ *
+ * pitch_bend is the 14-bit MIDI pitch bend value, 8192 meaning no bend.
+ */
+struct MicrotonalNote
+{
+    std::uint8_t note = 60;
+    std::uint16_t pitch_bend = 8'192;
+
+    auto operator==(MicrotonalNote const &) const -> bool = default;
+    auto operator!=(MicrotonalNote const &) const -> bool = default;
+};
+
+/**
+ * @brief Creates a timed MIDI note from a Note, its MIDI pitch and its sample span.
+ *
+ * The returned note uses \p span as the containing timespan for the note, then
+ * applies Note.delay and Note.gate within that span to calculate the final begin and
+ * end sample positions. This is how every flatten_to_midi overload places a note.
+ */
+[[nodiscard]]
+auto create_timed_midi_note(Note const &note,
+                            SampleSpan span,
+                            MicrotonalNote pitch) noexcept -> TimedMidiNote;
+
+/**
+ * @brief Why a render could not place every note, see try_flatten_to_midi.
+ */
+enum class RenderStatus
+{
+    ok,
+    /// A visited Sequence has a total child weight that is not greater than zero.
+    invalid_weight,
+};
+
+/**
+ * @brief The outcome of try_flatten_to_midi.
+ */
+struct RenderResult
+{
+    /// The number of notes the elements render to, which may exceed the buffer size.
+    std::size_t note_count;
+    RenderStatus status;
+
+    auto operator==(RenderResult const &) const -> bool = default;
+    auto operator!=(RenderResult const &) const -> bool = default;
+};
+
+/**
+ * @brief Precomputed mapping from Note.pitch to MIDI note and pitch bend.
+ *
+ * Built once from the arguments every flatten_to_midi overload takes, so repeated
+ * renders with the same tuning skip the per-note logarithm, division and modulo.
+ * Every pitch that can land inside the MIDI note range, plus an octave either side,
+ * is looked up in a table; any other pitch is computed on demand. Either way the
+ * result is identical to that of the overloads that take a Tuning.
+ */
+class PitchMap
+{
+  public:
+    /**
+     * @brief Builds the lookup table for \p tuning.
+     *
+     * @param tuning The tuning used to translate note pitches.
+     * @param base_frequency The base frequency for note pitch 0.
+     * @param pb_range The pitch bend range expected by the MIDI receiver.
+     * @throws std::invalid_argument if \p tuning is empty, if \p base_frequency is
+     * not greater than zero, or if \p pb_range is not greater than zero.
+     */
+    PitchMap(Tuning tuning, float base_frequency, float pb_range);
+
+    /**
+     * @brief Returns the MIDI note and pitch bend for \p pitch.
+     */
+    [[nodiscard]]
+    auto operator()(int pitch) const noexcept -> MicrotonalNote
+    {
+        // Pitches below first_pitch_ wrap around to large indices.
+        auto const index = static_cast<std::uint32_t>(pitch) -
+                           static_cast<std::uint32_t>(first_pitch_);
+        return index < table_.size() ? table_[index] : this->compute(pitch);
+    }
+
+    /**
+     * @brief Returns the MIDI note of \p pitch as a fractional note in [0, 127],
+     * before it is quantized to a note and a 14-bit pitch bend.
+     *
+     * Computed on every call, for renderers with more pitch resolution than
+     * MicrotonalNote, such as UmpRenderer.
+     */
+    [[nodiscard]]
+    auto fractional_note(int pitch) const noexcept -> float;
+
+    /**
+     * @brief Returns the tuning the map was built from.
+     */
+    [[nodiscard]]
+    auto tuning() const -> Tuning const &
+    {
+        return tuning_;
+    }
+
+  private:
+    [[nodiscard]]
+    auto compute(int pitch) const noexcept -> MicrotonalNote;
+
+  private:
+    Tuning tuning_;
+    float base_note_;
+    float pb_range_;
+    int first_pitch_;
+    std::vector<MicrotonalNote> table_;
+};
+
 /**
  * @brief Flattens a set of recursive simultaneous music elements into timed MIDI notes.
  *
@@ -47,11 +197,269 @@ struct TimedMidiNote
  * Sequence has a total child weight that is not greater than zero.
  */
 [[nodiscard]]
-auto flatten_to_midi(std::vector<MusicElement> const &elements,
-                     std::uint32_t sample_offset,
-                     std::uint32_t sample_count,
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Flattens simultaneous music elements, appending the notes to \p out.
+ *
+ * Produces the same notes, in the same order, as the overload that returns a vector,
+ * but appends them to \p out so a caller rendering repeatedly can reuse one buffer.
+ * Apart from growing \p out, this does not allocate for trees up to 32 levels deep;
+ * reserve \p out beforehand to render without allocating at all.
+ *
+ * @throws std::invalid_argument under the same conditions as the vector overload.
+ * The notes of the valid parts of \p elements are left in \p out.
+ */
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range,
+                     std::vector<TimedMidiNote> &out) -> void;
+
+/**
+ * @brief Flattens simultaneous music elements into the fixed-size buffer \p out.
+ *
+ * Writes the first out.size() notes, in the same order as the vector overloads, and
+ * never allocates for trees up to 32 levels deep. If the return value is greater
+ * than out.size(), \p out was too small: the notes past its end were dropped, and
+ * the return value is the capacity needed to render them all.
+ *
+ * @return std::size_t - The number of notes the elements render to.
+ * @throws std::invalid_argument under the same conditions as the vector overload.
+ */
+[[nodiscard]]
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range,
+                     std::span<TimedMidiNote> out) -> std::size_t;
+
+/**
+ * @brief Flattens a braced list of simultaneous music elements into timed MIDI notes.
+ *
+ * Equivalent to the std::span overload, keeps calls such as flatten_to_midi({}, ...)
+ * unambiguous.
+ */
+[[nodiscard]]
+auto flatten_to_midi(std::initializer_list<MusicElement> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
                      Tuning const &tuning,
                      float base_frequency,
                      float pb_range) -> std::vector<TimedMidiNote>;
 
+/**
+ * @brief Flattens the root Cell of a FlatSequence into timed MIDI notes.
+ *
+ * Produces the same notes as the recursive overload applied to
+ * from_flat(flat).elements, but walks the flat arrays in a single forward pass with
+ * no recursion. Notes are emitted in the breadth-first order of the flat layout, not
+ * in the depth-first order of the recursive overload.
+ *
+ * @throws std::invalid_argument under the same conditions as the recursive overload.
+ */
+[[nodiscard]]
+auto flatten_to_midi(FlatSequence const &flat,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Flattens simultaneous music elements, mapping pitches with \p pitch_map.
+ *
+ * Produces the same notes as the overload that takes the Tuning \p pitch_map was
+ * built from. The arguments were validated when \p pitch_map was built.
+ *
+ * @throws std::invalid_argument if any visited Sequence has a total child weight that
+ * is not greater than zero.
+ */
+[[nodiscard]]
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Appends the notes of \p elements to \p out, see the PitchMap and the
+ * std::vector & overloads.
+ */
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map,
+                     std::vector<TimedMidiNote> &out) -> void;
+
+/**
+ * @brief Writes the notes of \p elements to \p out, see the PitchMap and the
+ * std::span<TimedMidiNote> overloads.
+ */
+[[nodiscard]]
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map,
+                     std::span<TimedMidiNote> out) -> std::size_t;
+
+/**
+ * @brief Flattens simultaneous music elements into \p out without throwing.
+ *
+ * The render core behind every flatten_to_midi overload, for callers that cannot
+ * throw, such as a noexcept audio callback. All argument checks happened when
+ * \p pitch_map was built, so the only remaining failure is a visited Sequence with a
+ * total child weight that is not greater than zero. Such a Sequence is skipped, the
+ * rest of \p elements is still rendered, and the status reports the failure where the
+ * other overloads throw.
+ *
+ * Writes the first out.size() notes like the std::span<TimedMidiNote> overload. Trees
+ * deeper than 32 levels allocate, and terminate if that allocation fails.
+ *
+ * @return RenderResult - The number of notes the elements render to, and whether any
+ * Sequence was skipped.
+ */
+[[nodiscard]]
+auto try_flatten_to_midi(std::span<MusicElement const> elements,
+                         SampleTime sample_offset,
+                         SampleTime sample_count,
+                         PitchMap const &pitch_map,
+                         std::span<TimedMidiNote> out) noexcept -> RenderResult;
+
+/**
+ * @brief Flattens a braced list of music elements, see the PitchMap overload.
+ */
+[[nodiscard]]
+auto flatten_to_midi(std::initializer_list<MusicElement> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Flattens the root Cell of a FlatSequence, mapping pitches with \p pitch_map.
+ */
+[[nodiscard]]
+auto flatten_to_midi(FlatSequence const &flat,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Flattens only the notes that intersect [window_begin, window_end).
+ *
+ * Returns the notes flatten_to_midi(elements, sample_offset, sample_count, pitch_map)
+ * would return that overlap the window, in the same order, for hosts that only need
+ * the events of the current audio block. A note of zero length is included if it
+ * begins inside the window. Cells whose sample span lies outside the window are
+ * skipped along with everything nested in them, but their spans are still computed,
+ * as each depends on the weights of the cells before it. The cost is therefore
+ * O(siblings per level on the path to the window + notes near the window): a deep
+ * tree is cheap to render block by block, while a flat Sequence of N bars still costs
+ * O(N) per block. An empty window yields no notes.
+ *
+ * @throws std::invalid_argument if a Sequence visited within the window has a total
+ * child weight that is not greater than zero.
+ */
+[[nodiscard]]
+auto flatten_to_midi_window(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            SampleTime window_begin,
+                            SampleTime window_end,
+                            PitchMap const &pitch_map) -> std::vector<TimedMidiNote>;
+
+/**
+ * @brief Appends the notes that intersect [window_begin, window_end) to \p out, see
+ * the overload that returns a vector.
+ */
+auto flatten_to_midi_window(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            SampleTime window_begin,
+                            SampleTime window_end,
+                            PitchMap const &pitch_map,
+                            std::vector<TimedMidiNote> &out) -> void;
+
+/**
+ * @brief Writes the notes that intersect [window_begin, window_end) to \p out without
+ * throwing, see flatten_to_midi_window and try_flatten_to_midi.
+ */
+[[nodiscard]]
+auto try_flatten_to_midi_window(std::span<MusicElement const> elements,
+                                SampleTime sample_offset,
+                                SampleTime sample_count,
+                                SampleTime window_begin,
+                                SampleTime window_end,
+                                PitchMap const &pitch_map,
+                                std::span<TimedMidiNote> out) noexcept -> RenderResult;
+
+/**
+ * @brief Flattens simultaneous music elements into a time-sorted MIDI event stream.
+ *
+ * Each note of flatten_to_midi(elements, sample_offset, sample_count, pitch_map)
+ * becomes a pitch_bend and a note_on event at its begin, and a note_off event at its
+ * end. Events are sorted by time. At equal times every note_off comes first, then
+ * the pitch_bend and note_on of each note together, in the order flatten_to_midi
+ * returns the notes. A note of zero length has no duration to sound, so it produces
+ * no events.
+ *
+ * The stream is built without a full sort: the cells of a Sequence follow each other
+ * in time, so their streams are concatenated, and only the simultaneous elements of
+ * each cell are merged.
+ *
+ * @throws std::invalid_argument if any visited Sequence has a total child weight that
+ * is not greater than zero.
+ */
+[[nodiscard]]
+auto flatten_to_midi_events(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            PitchMap const &pitch_map) -> std::vector<MidiEvent>;
+
+/**
+ * @brief Flattens simultaneous music elements into a time-sorted MIDI event stream,
+ * see the PitchMap overload.
+ *
+ * @throws std::invalid_argument under the same conditions as flatten_to_midi().
+ */
+[[nodiscard]]
+auto flatten_to_midi_events(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            Tuning const &tuning,
+                            float base_frequency,
+                            float pb_range) -> std::vector<MidiEvent>;
+
+/**
+ * @brief Flattens simultaneous music elements into timed MIDI notes on several
+ * threads.
+ *
+ * Returns the same notes, in the same order, as flatten_to_midi(elements,
+ * sample_offset, sample_count, pitch_map). The child cells of each top-level
+ * Sequence cover disjoint spans that are computed up front, so each cell is rendered
+ * as an independent task into its own buffer, and the buffers are concatenated in
+ * tree order. Work is only split at the top level, so a tree with few top-level cells
+ * gains little.
+ *
+ * @param thread_count The maximum number of threads to render on, including the
+ * calling thread. 0 uses std::thread::hardware_concurrency().
+ * @throws std::invalid_argument if any visited Sequence has a total child weight that
+ * is not greater than zero.
+ */
+[[nodiscard]]
+auto flatten_to_midi_parallel(std::span<MusicElement const> elements,
+                              SampleTime sample_offset,
+                              SampleTime sample_count,
+                              PitchMap const &pitch_map,
+                              std::size_t thread_count = 0)
+    -> std::vector<TimedMidiNote>;
+
 } // namespace sequence::midi
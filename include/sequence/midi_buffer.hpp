@@ -0,0 +1,17 @@
+#pragma once
+
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/triple_buffer.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief Hands rendered notes from an editing thread to an audio thread without
+ * locking, see TripleBuffer.
+ */
+using NoteBuffer = TripleBuffer<std::vector<TimedMidiNote>>;
+
+} // namespace sequence::midi
@@ -1,15 +1,26 @@
 #pragma once
 
+#include <algorithm>
 #include <cstddef>
+#include <random>
+#include <variant>
 #include <vector>
 
+#include <sequence/flat.hpp>
 #include <sequence/pattern.hpp>
+#include <sequence/persistent.hpp>
 #include <sequence/sequence.hpp>
 #include <sequence/utility.hpp>
 
 namespace sequence::modify
 {
 
+// FlatSequence overloads apply the same edit as the Cell overload to the root cell of
+// the flat tree, running each edit as one loop over a NoteColumns column.
+//
+// PersistentCell overloads apply the same edit as the Cell overload, but only rebuild
+// the nodes on the path to changed notes and share every other subtree with the input.
+
 /// Randomizes note pitches in the selected target. For sequences, pattern matching is
 /// evaluated independently at each sequence level. Throws if min > max.
 [[nodiscard]]
@@ -19,6 +30,14 @@ auto randomize_pitch(MusicElement element, Pattern const &pattern, int min, int
 [[nodiscard]]
 auto randomize_pitch(Cell cell, Pattern const &pattern, int min, int max) -> Cell;
 
+[[nodiscard]]
+auto randomize_pitch(FlatSequence flat, Pattern const &pattern, int min, int max)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto randomize_pitch(PersistentCell cell, Pattern const &pattern, int min, int max)
+    -> PersistentCell;
+
 /// Randomizes note velocities in the selected target. Pattern matching is evaluated
 /// independently at each sequence level. Throws if min > max or either bound is
 /// outside [0, 1].
@@ -32,6 +51,16 @@ auto randomize_velocity(MusicElement element,
 auto randomize_velocity(Cell cell, Pattern const &pattern, float min, float max)
     -> Cell;
 
+[[nodiscard]]
+auto randomize_velocity(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto randomize_velocity(PersistentCell cell,
+                        Pattern const &pattern,
+                        float min,
+                        float max) -> PersistentCell;
+
 /// Randomizes note delays in the selected target. Pattern matching is evaluated
 /// independently at each sequence level. Throws if min > max or either bound is
 /// outside [0, 1].
@@ -42,6 +71,14 @@ auto randomize_delay(MusicElement element, Pattern const &pattern, float min, fl
 [[nodiscard]]
 auto randomize_delay(Cell cell, Pattern const &pattern, float min, float max) -> Cell;
 
+[[nodiscard]]
+auto randomize_delay(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto randomize_delay(PersistentCell cell, Pattern const &pattern, float min, float max)
+    -> PersistentCell;
+
 /// Randomizes note gates in the selected target. Pattern matching is evaluated
 /// independently at each sequence level. Throws if min > max or either bound is
 /// outside [0, 1].
@@ -52,6 +89,14 @@ auto randomize_gate(MusicElement element, Pattern const &pattern, float min, flo
 [[nodiscard]]
 auto randomize_gate(Cell cell, Pattern const &pattern, float min, float max) -> Cell;
 
+[[nodiscard]]
+auto randomize_gate(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto randomize_gate(PersistentCell cell, Pattern const &pattern, float min, float max)
+    -> PersistentCell;
+
 /// Shifts note pitch by a constant amount. Pattern matching is evaluated
 /// independently at each sequence level.
 [[nodiscard]]
@@ -61,6 +106,13 @@ auto shift_pitch(MusicElement element, Pattern const &pattern, int amount)
 [[nodiscard]]
 auto shift_pitch(Cell cell, Pattern const &pattern, int amount) -> Cell;
 
+[[nodiscard]]
+auto shift_pitch(FlatSequence flat, Pattern const &pattern, int amount) -> FlatSequence;
+
+[[nodiscard]]
+auto shift_pitch(PersistentCell cell, Pattern const &pattern, int amount)
+    -> PersistentCell;
+
 /// Shifts note velocities by a constant amount, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -70,6 +122,14 @@ auto shift_velocity(MusicElement element, Pattern const &pattern, float amount)
 [[nodiscard]]
 auto shift_velocity(Cell cell, Pattern const &pattern, float amount) -> Cell;
 
+[[nodiscard]]
+auto shift_velocity(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto shift_velocity(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell;
+
 /// Shifts note delays by a constant amount, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -79,6 +139,14 @@ auto shift_delay(MusicElement element, Pattern const &pattern, float amount)
 [[nodiscard]]
 auto shift_delay(Cell cell, Pattern const &pattern, float amount) -> Cell;
 
+[[nodiscard]]
+auto shift_delay(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto shift_delay(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell;
+
 /// Shifts note gates by a constant amount, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -88,6 +156,14 @@ auto shift_gate(MusicElement element, Pattern const &pattern, float amount)
 [[nodiscard]]
 auto shift_gate(Cell cell, Pattern const &pattern, float amount) -> Cell;
 
+[[nodiscard]]
+auto shift_gate(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto shift_gate(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell;
+
 /// Sets note pitch to a constant value. Pattern matching is evaluated independently at
 /// each sequence level.
 [[nodiscard]]
@@ -96,6 +172,13 @@ auto set_pitch(MusicElement element, Pattern const &pattern, int pitch) -> Music
 [[nodiscard]]
 auto set_pitch(Cell cell, Pattern const &pattern, int pitch) -> Cell;
 
+[[nodiscard]]
+auto set_pitch(FlatSequence flat, Pattern const &pattern, int pitch) -> FlatSequence;
+
+[[nodiscard]]
+auto set_pitch(PersistentCell cell, Pattern const &pattern, int pitch)
+    -> PersistentCell;
+
 /// Sets note octave while preserving degree within the tuning length. Pattern matching
 /// is evaluated independently at each sequence level. Throws if tuning_length is zero.
 [[nodiscard]]
@@ -110,6 +193,18 @@ auto set_octave(Cell cell,
                 int octave,
                 std::size_t tuning_length) -> Cell;
 
+[[nodiscard]]
+auto set_octave(FlatSequence flat,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> FlatSequence;
+
+[[nodiscard]]
+auto set_octave(PersistentCell cell,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> PersistentCell;
+
 /// Sets note velocity to a constant value, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -119,6 +214,14 @@ auto set_velocity(MusicElement element, Pattern const &pattern, float velocity)
 [[nodiscard]]
 auto set_velocity(Cell cell, Pattern const &pattern, float velocity) -> Cell;
 
+[[nodiscard]]
+auto set_velocity(FlatSequence flat, Pattern const &pattern, float velocity)
+    -> FlatSequence;
+
+[[nodiscard]]
+auto set_velocity(PersistentCell cell, Pattern const &pattern, float velocity)
+    -> PersistentCell;
+
 /// Sets note delay to a constant value, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -128,6 +231,13 @@ auto set_delay(MusicElement element, Pattern const &pattern, float delay)
 [[nodiscard]]
 auto set_delay(Cell cell, Pattern const &pattern, float delay) -> Cell;
 
+[[nodiscard]]
+auto set_delay(FlatSequence flat, Pattern const &pattern, float delay) -> FlatSequence;
+
+[[nodiscard]]
+auto set_delay(PersistentCell cell, Pattern const &pattern, float delay)
+    -> PersistentCell;
+
 /// Sets note gate to a constant value, clamped to [0, 1]. Pattern matching is
 /// evaluated independently at each sequence level.
 [[nodiscard]]
@@ -136,6 +246,13 @@ auto set_gate(MusicElement element, Pattern const &pattern, float gate) -> Music
 [[nodiscard]]
 auto set_gate(Cell cell, Pattern const &pattern, float gate) -> Cell;
 
+[[nodiscard]]
+auto set_gate(FlatSequence flat, Pattern const &pattern, float gate) -> FlatSequence;
+
+[[nodiscard]]
+auto set_gate(PersistentCell cell, Pattern const &pattern, float gate)
+    -> PersistentCell;
+
 /// Rotates sequence cell order. Positive values shift right, negative values shift
 /// left. Non-sequence cells are unchanged.
 [[nodiscard]]
@@ -153,6 +270,13 @@ auto mirror(MusicElement element, Pattern const &pattern, int center_note)
 [[nodiscard]]
 auto mirror(Cell cell, Pattern const &pattern, int center_note) -> Cell;
 
+[[nodiscard]]
+auto mirror(FlatSequence flat, Pattern const &pattern, int center_note) -> FlatSequence;
+
+[[nodiscard]]
+auto mirror(PersistentCell cell, Pattern const &pattern, int center_note)
+    -> PersistentCell;
+
 /// Reverses sequence cell order recursively through nested sequences.
 [[nodiscard]]
 auto reverse(MusicElement element) -> MusicElement;
@@ -197,4 +321,317 @@ auto shuffle(Cell cell) -> Cell;
 [[nodiscard]]
 auto note(int pitch, float velocity, float delay, float gate) -> MusicElement;
 
+/// The per-note edits behind the attribute functions above, shared by their overloads
+/// and by Pipeline. Each edits one Note per call; the modify functions validate their
+/// arguments, and clamp set_* values, before building one.
+namespace edit
+{
+
+struct RandomizePitch
+{
+    int min;
+    int max;
+
+    auto operator()(Note &note, std::mt19937 &gen) const -> void
+    {
+        note.pitch = std::uniform_int_distribution{min, max}(gen);
+    }
+};
+
+/// Draws a float attribute, velocity, delay or gate, from [min, max].
+template <float Note::*Attribute>
+struct RandomizeUnit
+{
+    float min;
+    float max;
+
+    auto operator()(Note &note, std::mt19937 &gen) const -> void
+    {
+        note.*Attribute = std::uniform_real_distribution{min, max}(gen);
+    }
+};
+
+struct ShiftPitch
+{
+    int amount;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        note.pitch += amount;
+    }
+};
+
+/// Adds to a float attribute, clamping the result to [0, 1].
+template <float Note::*Attribute>
+struct ShiftUnit
+{
+    float amount;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        note.*Attribute = std::clamp(note.*Attribute + amount, 0.f, 1.f);
+    }
+};
+
+struct SetPitch
+{
+    int pitch;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        note.pitch = pitch;
+    }
+};
+
+struct SetOctave
+{
+    int octave;
+    int tuning_length;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        auto const degree_in_current_octave =
+            (note.pitch % tuning_length + tuning_length) % tuning_length;
+        note.pitch = degree_in_current_octave + (octave * tuning_length);
+    }
+};
+
+/// Sets a float attribute to a value already clamped to [0, 1].
+template <float Note::*Attribute>
+struct SetUnit
+{
+    float value;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        note.*Attribute = value;
+    }
+};
+
+struct Mirror
+{
+    int center_note;
+
+    auto operator()(Note &note, std::mt19937 &) const -> void
+    {
+        note.pitch = center_note + (center_note - note.pitch);
+    }
+};
+
+using RandomizeVelocity = RandomizeUnit<&Note::velocity>;
+using RandomizeDelay = RandomizeUnit<&Note::delay>;
+using RandomizeGate = RandomizeUnit<&Note::gate>;
+using ShiftVelocity = ShiftUnit<&Note::velocity>;
+using ShiftDelay = ShiftUnit<&Note::delay>;
+using ShiftGate = ShiftUnit<&Note::gate>;
+using SetVelocity = SetUnit<&Note::velocity>;
+using SetDelay = SetUnit<&Note::delay>;
+using SetGate = SetUnit<&Note::gate>;
+
+} // namespace edit
+
+/**
+ * @brief A chain of note edits applied in as few tree traversals as possible.
+ *
+ * Each builder call appends one edit and returns *this, for example
+ * Pipeline{}.shift_pitch(p, 7).set_velocity(p, 0.5f).randomize_delay(p, 0.f, 0.1f).
+ * Consecutive edits that share the same Pattern are fused into one Stage. Applying the
+ * pipeline traverses the target once per Stage and runs every edit of that Stage on
+ * each selected note, instead of traversing and copying the whole tree once per edit.
+ *
+ * The result matches chaining the individual modify calls, except that values of
+ * randomize edits fused into the same Stage are drawn in a different order. Arguments
+ * are validated, and set_* values clamped, when an edit is added.
+ */
+class Pipeline
+{
+  public:
+    /// Held by value and dispatched with std::visit, so running an edit is a switch
+    /// over its kind rather than a call through a type-erased pointer.
+    using Edit = std::variant<edit::RandomizePitch,
+                              edit::RandomizeVelocity,
+                              edit::RandomizeDelay,
+                              edit::RandomizeGate,
+                              edit::ShiftPitch,
+                              edit::ShiftVelocity,
+                              edit::ShiftDelay,
+                              edit::ShiftGate,
+                              edit::SetPitch,
+                              edit::SetOctave,
+                              edit::SetVelocity,
+                              edit::SetDelay,
+                              edit::SetGate,
+                              edit::Mirror>;
+
+    struct Stage
+    {
+        Pattern pattern;
+        std::vector<Edit> edits;
+    };
+
+    auto randomize_pitch(Pattern const &pattern, int min, int max) -> Pipeline &;
+
+    auto randomize_velocity(Pattern const &pattern, float min, float max) -> Pipeline &;
+
+    auto randomize_delay(Pattern const &pattern, float min, float max) -> Pipeline &;
+
+    auto randomize_gate(Pattern const &pattern, float min, float max) -> Pipeline &;
+
+    auto shift_pitch(Pattern const &pattern, int amount) -> Pipeline &;
+
+    auto shift_velocity(Pattern const &pattern, float amount) -> Pipeline &;
+
+    auto shift_delay(Pattern const &pattern, float amount) -> Pipeline &;
+
+    auto shift_gate(Pattern const &pattern, float amount) -> Pipeline &;
+
+    auto set_pitch(Pattern const &pattern, int pitch) -> Pipeline &;
+
+    auto set_octave(Pattern const &pattern, int octave, std::size_t tuning_length)
+        -> Pipeline &;
+
+    auto set_velocity(Pattern const &pattern, float velocity) -> Pipeline &;
+
+    auto set_delay(Pattern const &pattern, float delay) -> Pipeline &;
+
+    auto set_gate(Pattern const &pattern, float gate) -> Pipeline &;
+
+    auto mirror(Pattern const &pattern, int center_note) -> Pipeline &;
+
+    /**
+     * @brief The fused stages, in the order they are applied.
+     */
+    [[nodiscard]]
+    auto stages() const -> std::vector<Stage> const &;
+
+  private:
+    /**
+     * @brief Appends \p edit to the last Stage if it uses \p pattern, otherwise
+     * starts a new Stage.
+     */
+    auto add(Pattern const &pattern, Edit edit) -> Pipeline &;
+
+    std::vector<Stage> stages_;
+};
+
+/// Applies every edit of \p pipeline to the target, one traversal per Stage.
+[[nodiscard]]
+auto apply(Pipeline const &pipeline, MusicElement element) -> MusicElement;
+
+[[nodiscard]]
+auto apply(Pipeline const &pipeline, Cell cell) -> Cell;
+
+[[nodiscard]]
+auto apply(Pipeline const &pipeline, PersistentCell cell) -> PersistentCell;
+
+/// In-place counterparts of the functions above. Each applies the same edit directly
+/// to its target instead of returning a modified copy, so attribute edits never
+/// allocate and structural edits reuse the target's existing storage. Arguments are
+/// validated before the target is modified.
+namespace inplace
+{
+
+auto randomize_pitch(MusicElement &element, Pattern const &pattern, int min, int max)
+    -> void;
+
+auto randomize_pitch(Cell &cell, Pattern const &pattern, int min, int max) -> void;
+
+auto randomize_velocity(MusicElement &element,
+                        Pattern const &pattern,
+                        float min,
+                        float max) -> void;
+
+auto randomize_velocity(Cell &cell, Pattern const &pattern, float min, float max)
+    -> void;
+
+auto randomize_delay(MusicElement &element,
+                     Pattern const &pattern,
+                     float min,
+                     float max) -> void;
+
+auto randomize_delay(Cell &cell, Pattern const &pattern, float min, float max) -> void;
+
+auto randomize_gate(MusicElement &element, Pattern const &pattern, float min, float max)
+    -> void;
+
+auto randomize_gate(Cell &cell, Pattern const &pattern, float min, float max) -> void;
+
+auto shift_pitch(MusicElement &element, Pattern const &pattern, int amount) -> void;
+
+auto shift_pitch(Cell &cell, Pattern const &pattern, int amount) -> void;
+
+auto shift_velocity(MusicElement &element, Pattern const &pattern, float amount)
+    -> void;
+
+auto shift_velocity(Cell &cell, Pattern const &pattern, float amount) -> void;
+
+auto shift_delay(MusicElement &element, Pattern const &pattern, float amount) -> void;
+
+auto shift_delay(Cell &cell, Pattern const &pattern, float amount) -> void;
+
+auto shift_gate(MusicElement &element, Pattern const &pattern, float amount) -> void;
+
+auto shift_gate(Cell &cell, Pattern const &pattern, float amount) -> void;
+
+auto set_pitch(MusicElement &element, Pattern const &pattern, int pitch) -> void;
+
+auto set_pitch(Cell &cell, Pattern const &pattern, int pitch) -> void;
+
+auto set_octave(MusicElement &element,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> void;
+
+auto set_octave(Cell &cell,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> void;
+
+auto set_velocity(MusicElement &element, Pattern const &pattern, float velocity)
+    -> void;
+
+auto set_velocity(Cell &cell, Pattern const &pattern, float velocity) -> void;
+
+auto set_delay(MusicElement &element, Pattern const &pattern, float delay) -> void;
+
+auto set_delay(Cell &cell, Pattern const &pattern, float delay) -> void;
+
+auto set_gate(MusicElement &element, Pattern const &pattern, float gate) -> void;
+
+auto set_gate(Cell &cell, Pattern const &pattern, float gate) -> void;
+
+auto rotate(MusicElement &element, int amount) -> void;
+
+auto rotate(Cell &cell, int amount) -> void;
+
+auto mirror(MusicElement &element, Pattern const &pattern, int center_note) -> void;
+
+auto mirror(Cell &cell, Pattern const &pattern, int center_note) -> void;
+
+auto reverse(MusicElement &element) -> void;
+
+auto reverse(Cell &cell) -> void;
+
+auto repeat(MusicElement &element, std::size_t count) -> void;
+
+auto repeat(Cell &cell, std::size_t count) -> void;
+
+auto stretch(MusicElement &element, Pattern const &pattern, std::size_t amount) -> void;
+
+auto stretch(Cell &cell, Pattern const &pattern, std::size_t amount) -> void;
+
+auto compress(MusicElement &element, Pattern const &pattern) -> void;
+
+auto compress(Cell &cell, Pattern const &pattern) -> void;
+
+auto shuffle(MusicElement &element) -> void;
+
+auto shuffle(Cell &cell) -> void;
+
+auto apply(Pipeline const &pipeline, MusicElement &element) -> void;
+
+auto apply(Pipeline const &pipeline, Cell &cell) -> void;
+
+} // namespace inplace
+
 } // namespace sequence::modify
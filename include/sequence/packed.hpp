@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <sequence/flat.hpp>
+#include <sequence/sequence.hpp>
+
+namespace sequence
+{
+
+/**
+ * @brief An 8 byte, quantized encoding of a Note.
+ *
+ * velocity, delay and gate are stored as 16 bit fixed point fractions of 1.0, which
+ * keeps the quantization error well below the tolerance of Note's operator==, so
+ * unpack(pack(note)) == note for every packable note.
+ */
+struct PackedNote
+{
+    std::int16_t pitch;
+    std::uint16_t velocity;
+    std::uint16_t delay;
+    std::uint16_t gate;
+
+    auto operator==(PackedNote const &) const -> bool = default;
+    auto operator!=(PackedNote const &) const -> bool = default;
+};
+
+static_assert(sizeof(PackedNote) == 8);
+
+/**
+ * @brief Quantizes \p note into a PackedNote.
+ *
+ * @throws std::out_of_range if the pitch does not fit in 16 bits, or if velocity,
+ * delay or gate is outside of [0, 1].
+ */
+[[nodiscard]]
+auto pack(Note const &note) -> PackedNote;
+
+/**
+ * @brief Expands \p note back into a Note.
+ */
+[[nodiscard]]
+auto unpack(PackedNote const &note) -> Note;
+
+/**
+ * @brief A compact, read-only Cell tree for holding large pattern banks in memory.
+ *
+ * Uses the same breadth-first, index-linked layout as FlatSequence, but stores notes
+ * as PackedNotes without an owning cell column, and packs each element into a single
+ * 32 bit word. Convert to a FlatSequence or a Cell to edit or render it.
+ */
+struct PackedSequence
+{
+    using CellNode = FlatSequence::CellNode;
+    using SequenceNode = FlatSequence::SequenceNode;
+
+    struct ElementNode
+    {
+        static constexpr std::uint32_t sequence_bit = std::uint32_t{1} << 31;
+
+        std::uint32_t value; // Index into notes, or into sequences if sequence_bit.
+
+        [[nodiscard]]
+        auto is_sequence() const -> bool
+        {
+            return (value & sequence_bit) != 0;
+        }
+
+        [[nodiscard]]
+        auto index() const -> std::uint32_t
+        {
+            return value & ~sequence_bit;
+        }
+    };
+
+    std::vector<CellNode> cells;
+    std::vector<ElementNode> elements;
+    std::vector<PackedNote> notes;
+    std::vector<SequenceNode> sequences;
+};
+
+/**
+ * @brief Packs a FlatSequence into a PackedSequence.
+ *
+ * @throws std::out_of_range if a note cannot be packed, see pack(), or if the tree
+ * has 2^31 or more notes or sequences.
+ */
+[[nodiscard]]
+auto to_packed(FlatSequence const &flat) -> PackedSequence;
+
+/**
+ * @brief Packs a recursive Cell tree into a PackedSequence.
+ *
+ * @throws std::out_of_range under the same conditions as the FlatSequence overload.
+ */
+[[nodiscard]]
+auto to_packed(Cell const &cell) -> PackedSequence;
+
+/**
+ * @brief Expands a PackedSequence into a FlatSequence with the same layout.
+ */
+[[nodiscard]]
+auto to_flat(PackedSequence const &packed) -> FlatSequence;
+
+/**
+ * @brief Expands a PackedSequence back into a recursive Cell tree.
+ *
+ * from_packed(to_packed(cell)) == cell for every packable \p cell.
+ */
+[[nodiscard]]
+auto from_packed(PackedSequence const &packed) -> Cell;
+
+} // namespace sequence
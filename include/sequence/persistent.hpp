@@ -0,0 +1,394 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sequence/pattern.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/traverse.hpp>
+
+namespace sequence
+{
+
+struct PersistentCell;
+class PersistentSequence;
+
+/**
+ * @brief Shared, immutable handle to a nested PersistentSequence.
+ *
+ * Copying a handle never copies the subtree, so many trees (for example every entry of
+ * an undo history) can share the subtrees they have in common.
+ */
+using PersistentSequencePtr = std::shared_ptr<PersistentSequence const>;
+
+using PersistentElement = std::variant<Note, PersistentSequencePtr>;
+
+/**
+ * @brief A Cell whose nested sequences are shared, immutable nodes.
+ *
+ * Mirrors Cell, but each nested Sequence is held through a PersistentSequencePtr.
+ * Copying a PersistentCell is shallow and edits never modify a node in place, instead
+ * they rebuild only the path from the root to the changed nodes.
+ */
+struct PersistentCell
+{
+    std::vector<PersistentElement> elements;
+    float weight = 1.f; // Defines length, in relation to sibling Cells
+};
+
+/**
+ * @brief An immutable nested sequence of a PersistentCell tree.
+ *
+ * The structural hash of cells is computed on construction, and cells cannot be
+ * modified afterwards, so the cached hash always matches the node.
+ */
+class PersistentSequence
+{
+  public:
+    /**
+     * @brief Creates a node holding \p cells and caches its structural hash.
+     *
+     * The hash is computed from the cached hashes of the nested nodes, so this is
+     * O(size of \p cells), not O(size of the subtree).
+     */
+    explicit PersistentSequence(std::vector<PersistentCell> cells);
+
+    std::vector<PersistentCell> const cells;
+
+  public:
+    /**
+     * @brief Returns the structural hash of cells, see sequence::hash().
+     */
+    [[nodiscard]]
+    auto structural_hash() const -> std::size_t
+    {
+        return structural_hash_;
+    }
+
+  private:
+    std::size_t structural_hash_;
+};
+
+/**
+ * @brief Compares two PersistentCell trees for equality, like Cell's operator==.
+ *
+ * Nested sequences held by the same node compare equal without being visited, and
+ * nodes with different cached hashes compare unequal without being visited, so
+ * comparing an edited tree against the one it was derived from only walks the path
+ * to the changed nodes.
+ */
+[[nodiscard]]
+auto operator==(PersistentCell const &lhs, PersistentCell const &rhs) -> bool;
+
+/**
+ * @brief Compares two PersistentSequence nodes for equality.
+ *
+ * O(1) when \p lhs and \p rhs are the same node or their cached hashes differ.
+ */
+[[nodiscard]]
+auto operator==(PersistentSequence const &lhs, PersistentSequence const &rhs) -> bool;
+
+namespace detail
+{
+
+/**
+ * @brief PersistentCell trees hand out the shared handle of each nested Sequence, so
+ * visitors can keep nodes alive or key caches by them.
+ */
+template <>
+struct Tree<PersistentElement const>
+{
+    using SequenceT = PersistentSequencePtr const;
+    using CellT = PersistentCell const;
+
+    static auto sequence(PersistentElement const &element) -> SequenceT &
+    {
+        return *std::get_if<PersistentSequencePtr>(&element);
+    }
+
+    static auto cells(SequenceT &seq) -> std::vector<PersistentCell> const &
+    {
+        return seq->cells;
+    }
+};
+
+} // namespace detail
+
+/**
+ * @brief Walks the tree below the elements of a PersistentCell, see
+ * traverse(std::span...).
+ */
+template <typename... Args>
+auto traverse(PersistentCell const &cell, Args &&...args) -> void
+{
+    traverse(std::span<PersistentElement const>{cell.elements},
+             std::forward<Args>(args)...);
+}
+
+/**
+ * @brief One step of a path from a root PersistentCell down to a nested cell.
+ *
+ * Selects the Sequence at elements[element] of the current cell, then its child cell at
+ * cells[cell].
+ */
+struct PathStep
+{
+    std::size_t element;
+    std::size_t cell;
+};
+
+/**
+ * @brief Creates a new shared PersistentSequence node holding \p cells.
+ */
+[[nodiscard]]
+auto make_persistent_sequence(std::vector<PersistentCell> cells)
+    -> PersistentSequencePtr;
+
+/**
+ * @brief Converts a Cell tree into a PersistentCell tree.
+ */
+[[nodiscard]]
+auto to_persistent(Cell const &cell) -> PersistentCell;
+
+/**
+ * @brief Converts a PersistentCell tree back into a Cell tree.
+ *
+ * This is the inverse of to_persistent(), to_cell(to_persistent(cell)) == cell.
+ */
+[[nodiscard]]
+auto to_cell(PersistentCell const &cell) -> Cell;
+
+/**
+ * @brief Returns a copy of \p root with the cell at \p path replaced by \p replacement.
+ *
+ * Only the nodes along \p path are reallocated, every other subtree is shared with
+ * \p root. An empty \p path replaces \p root itself.
+ *
+ * @throws std::out_of_range if a step of \p path does not name an existing Sequence
+ * element and child cell.
+ */
+[[nodiscard]]
+auto replace_cell(PersistentCell const &root,
+                  std::span<PathStep const> path,
+                  PersistentCell replacement) -> PersistentCell;
+
+namespace detail
+{
+
+/**
+ * @brief Builds a PersistentCell from a Cell tree in one traverse() pass.
+ *
+ * Keeps one PersistentCell per open cell and one cell list per open Sequence, and
+ * turns each closed Sequence into a node with \p make_node, invoked as
+ * make_node(std::vector<PersistentCell>) -> PersistentSequencePtr.
+ */
+template <typename MakeNode>
+class PersistentBuilder
+{
+  public:
+    PersistentBuilder(float root_weight, MakeNode make_node)
+        : make_node_{std::move(make_node)}
+    {
+        cells_.push_back(PersistentCell{.elements = {}, .weight = root_weight});
+    }
+
+    [[nodiscard]]
+    auto result() && -> PersistentCell
+    {
+        return std::move(cells_.front());
+    }
+
+    auto note(Note const &note) -> void
+    {
+        cells_.back().elements.emplace_back(note);
+    }
+
+    auto enter_sequence(Sequence const &seq) -> void
+    {
+        sequences_.emplace_back().reserve(seq.cells.size());
+    }
+
+    auto exit_sequence(Sequence const &) -> void
+    {
+        auto node = make_node_(std::move(sequences_.back()));
+        sequences_.pop_back();
+        cells_.back().elements.emplace_back(std::move(node));
+    }
+
+    auto enter_cell(Cell const &cell) -> void
+    {
+        cells_.push_back(PersistentCell{.elements = {}, .weight = cell.weight});
+        cells_.back().elements.reserve(cell.elements.size());
+    }
+
+    auto exit_cell(Cell const &) -> void
+    {
+        sequences_.back().push_back(std::move(cells_.back()));
+        cells_.pop_back();
+    }
+
+  private:
+    MakeNode make_node_;
+    SmallVector<PersistentCell, 16> cells_;
+    SmallVector<std::vector<PersistentCell>, 16> sequences_;
+};
+
+[[nodiscard]]
+inline auto identical(Note const &lhs, Note const &rhs) -> bool
+{
+    // std::ranges::equal_to used to avoid float comparison warning.
+    return lhs.pitch == rhs.pitch &&
+           std::ranges::equal_to{}(lhs.velocity, rhs.velocity) &&
+           std::ranges::equal_to{}(lhs.delay, rhs.delay) &&
+           std::ranges::equal_to{}(lhs.gate, rhs.gate);
+}
+
+/**
+ * @brief Applies a note function to a PersistentCell tree during one traverse() pass.
+ *
+ * Keeps the element position of each open cell, and for each open Sequence a copy of
+ * its cells, made when the first of its elements changes. Closing a changed Sequence
+ * turns the copy into a new node and stores it in the parent, so only the nodes on
+ * the path to a changed note are rebuilt and every other node stays shared.
+ */
+template <typename NoteFn>
+class NoteTransformer
+{
+  public:
+    NoteTransformer(PersistentCell root, NoteFn const &note_fn)
+        : root_{std::move(root)}, note_fn_{note_fn}
+    {
+    }
+
+    [[nodiscard]]
+    auto result() && -> PersistentCell
+    {
+        return std::move(root_);
+    }
+
+    auto note(Note const &note) -> void
+    {
+        auto const element = this->next_element();
+        auto updated = note_fn_(note);
+        if (!identical(updated, note))
+        {
+            this->replace(element, updated);
+        }
+    }
+
+    auto enter_sequence(PersistentSequencePtr const &seq) -> void
+    {
+        auto const element = this->next_element();
+        sequences_.push_back(
+            OpenSequence{.node = &seq, .cells = std::nullopt, .element = element});
+    }
+
+    auto exit_sequence(PersistentSequencePtr const &) -> void
+    {
+        auto closed = std::move(sequences_.back());
+        sequences_.pop_back();
+        if (closed.cells.has_value())
+        {
+            this->replace(closed.element,
+                          make_persistent_sequence(std::move(*closed.cells)));
+        }
+    }
+
+    auto enter_cell(PersistentCell const &cell) -> void
+    {
+        auto const &cells = (*sequences_.back().node)->cells;
+        auto const index = static_cast<std::size_t>(&cell - cells.data());
+        cells_.push_back(OpenCell{.index = index, .element = 0});
+    }
+
+    auto exit_cell(PersistentCell const &) -> void
+    {
+        cells_.pop_back();
+    }
+
+  private:
+    struct OpenCell
+    {
+        std::size_t index;   // Position in the parent Sequence's cells.
+        std::size_t element; // Position of the next element to be visited.
+    };
+
+    struct OpenSequence
+    {
+        PersistentSequencePtr const *node;
+        std::optional<std::vector<PersistentCell>> cells; // Set once anything changes.
+        std::size_t element; // Position in the parent cell's elements.
+    };
+
+    /**
+     * @brief Returns the position of the element about to be visited in the current
+     * cell, counting the root cell's elements while no Sequence is open.
+     */
+    auto next_element() -> std::size_t
+    {
+        return sequences_.empty() ? root_element_++ : cells_.back().element++;
+    }
+
+    /**
+     * @brief Replaces an element of the current cell, copying the cells of the
+     * enclosing Sequence first if this is its first change.
+     */
+    auto replace(std::size_t element, PersistentElement value) -> void
+    {
+        if (sequences_.empty())
+        {
+            root_.elements[element] = std::move(value);
+            return;
+        }
+        auto &open = sequences_.back();
+        if (!open.cells.has_value())
+        {
+            open.cells = (*open.node)->cells; // Shallow, nested sequences stay shared.
+        }
+        (*open.cells)[cells_.back().index].elements[element] = std::move(value);
+    }
+
+  private:
+    PersistentCell root_;
+    NoteFn const &note_fn_;
+    std::size_t root_element_ = 0;
+    SmallVector<OpenCell, 16> cells_;
+    SmallVector<OpenSequence, 16> sequences_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Applies \p note_fn to every note selected by \p pattern.
+ *
+ * Uses the same selection rules as the sequence::modify functions: every element of
+ * \p cell is visited and each nested Sequence only descends into child cells selected
+ * by \p pattern. Nodes whose notes are all left unchanged are shared with \p cell, so
+ * the cost in time and memory is proportional to the selected region and the number
+ * of changed nodes, not to the size of the tree.
+ *
+ * @param cell The root of the tree to transform.
+ * @param pattern The pattern applied independently at each sequence level.
+ * @param note_fn Invoked as note_fn(Note const &) -> Note for each selected note.
+ * @return PersistentCell - The transformed tree.
+ */
+template <typename NoteFn>
+[[nodiscard]]
+auto transform_notes(PersistentCell const &cell,
+                     Pattern const &pattern,
+                     NoteFn const &note_fn) -> PersistentCell
+{
+    // The walk reads cell while the transformer edits its own shallow copy.
+    auto transformer = detail::NoteTransformer{cell, note_fn};
+    traverse(cell, pattern, transformer);
+    return std::move(transformer).result();
+}
+
+} // namespace sequence
@@ -4,6 +4,8 @@
 #include <variant>
 #include <vector>
 
+#include <sequence/small_vector.hpp>
+
 namespace sequence
 {
 
@@ -27,9 +29,15 @@ struct Sequence
 
 using MusicElement = std::variant<Note, Sequence>;
 
+/**
+ * @brief A set of simultaneous MusicElements, with a weight relative to its siblings.
+ *
+ * Most cells hold a single Note or Sequence, so elements keeps one element inline and
+ * only allocates for chords and other multi-element cells.
+ */
 struct Cell
 {
-    std::vector<MusicElement> elements;
+    SmallVector<MusicElement, 1> elements;
     float weight = 1.f; // Defines length, in relation to sibling Cells
 };
 
@@ -57,14 +65,21 @@ constexpr auto operator!=(Note const &lhs, Note const &rhs) -> bool
     return !(lhs == rhs);
 }
 
+/**
+ * @brief Compares two Cells for equality, visiting every nested element.
+ *
+ * The weight is compared first, as it is the cheapest way to tell Cells apart. Cell
+ * trees carry no cached hashes, so telling an edited copy from the original is
+ * O(size of the tree); convert to a PersistentCell tree for O(1) change detection.
+ */
 [[nodiscard]]
-constexpr auto operator==(Cell const &lhs, Cell const &rhs) -> bool
+inline auto operator==(Cell const &lhs, Cell const &rhs) -> bool
 {
-    return lhs.elements == rhs.elements && std::fabs(lhs.weight - rhs.weight) < 0.0001f;
+    return std::fabs(lhs.weight - rhs.weight) < 0.0001f && lhs.elements == rhs.elements;
 }
 
 [[nodiscard]]
-constexpr auto operator!=(Cell const &lhs, Cell const &rhs) -> bool
+inline auto operator!=(Cell const &lhs, Cell const &rhs) -> bool
 {
     return !(lhs == rhs);
 }
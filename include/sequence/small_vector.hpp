@@ -0,0 +1,641 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+namespace sequence
+{
+
+/**
+ * @brief A contiguous, std::vector-like container that stores its first N elements
+ * inline.
+ *
+ * No heap allocation is made until the container grows beyond N elements, after which
+ * it behaves like a std::vector, and it offers the same sequence container interface,
+ * without allocator support. Iterators are plain pointers, so a SmallVector is a
+ * contiguous range and converts to std::span.
+ *
+ * Unlike std::vector, moving a SmallVector that is using its inline storage moves each
+ * element individually, and invalidates pointers into the moved-from container.
+ *
+ * @tparam T The element type.
+ * @tparam N The number of elements stored inline, must be at least 1.
+ */
+template <typename T, std::size_t N>
+class SmallVector
+{
+    static_assert(N > 0, "SmallVector: inline capacity must be at least 1.");
+
+  public:
+    using value_type = T;
+    using size_type = std::size_t;
+    using difference_type = std::ptrdiff_t;
+    using reference = T &;
+    using const_reference = T const &;
+    using pointer = T *;
+    using const_pointer = T const *;
+    using iterator = T *;
+    using const_iterator = T const *;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+
+  public:
+    SmallVector() = default;
+
+    explicit SmallVector(size_type count)
+    {
+        this->resize(count);
+    }
+
+    SmallVector(size_type count, T const &value)
+    {
+        this->assign(count, value);
+    }
+
+    SmallVector(std::initializer_list<T> values)
+        : SmallVector(values.begin(), values.end())
+    {
+    }
+
+    template <std::input_iterator It>
+    SmallVector(It first, It last)
+    {
+        if constexpr (std::forward_iterator<It>)
+        {
+            this->reserve(static_cast<size_type>(std::distance(first, last)));
+        }
+        for (; first != last; ++first)
+        {
+            this->emplace_back(*first);
+        }
+    }
+
+    SmallVector(SmallVector const &other) : SmallVector(other.begin(), other.end())
+    {
+    }
+
+    SmallVector(SmallVector &&other) noexcept(std::is_nothrow_move_constructible_v<T>)
+    {
+        this->take(std::move(other));
+    }
+
+    auto operator=(SmallVector const &other) -> SmallVector &
+    {
+        if (this != &other)
+        {
+            auto copy = other;
+            this->clear();
+            this->release();
+            this->take(std::move(copy));
+        }
+        return *this;
+    }
+
+    auto operator=(SmallVector &&other) noexcept(
+        std::is_nothrow_move_constructible_v<T>) -> SmallVector &
+    {
+        if (this != &other)
+        {
+            this->clear();
+            this->release();
+            this->take(std::move(other));
+        }
+        return *this;
+    }
+
+    auto operator=(std::initializer_list<T> values) -> SmallVector &
+    {
+        this->assign(values);
+        return *this;
+    }
+
+    ~SmallVector()
+    {
+        this->clear();
+        this->release();
+    }
+
+  public:
+    [[nodiscard]]
+    auto size() const -> size_type
+    {
+        return size_;
+    }
+
+    [[nodiscard]]
+    auto empty() const -> bool
+    {
+        return size_ == 0;
+    }
+
+    [[nodiscard]]
+    auto max_size() const -> size_type
+    {
+        return std::allocator_traits<std::allocator<T>>::max_size(std::allocator<T>{});
+    }
+
+    [[nodiscard]]
+    auto capacity() const -> size_type
+    {
+        return capacity_;
+    }
+
+    /**
+     * @brief Returns true if the elements live in the inline buffer.
+     */
+    [[nodiscard]]
+    auto is_inline() const -> bool
+    {
+        return data_ == this->inline_data();
+    }
+
+    [[nodiscard]]
+    auto data() -> T *
+    {
+        return data_;
+    }
+
+    [[nodiscard]]
+    auto data() const -> T const *
+    {
+        return data_;
+    }
+
+    [[nodiscard]]
+    auto begin() -> iterator
+    {
+        return data_;
+    }
+
+    [[nodiscard]]
+    auto begin() const -> const_iterator
+    {
+        return data_;
+    }
+
+    [[nodiscard]]
+    auto cbegin() const -> const_iterator
+    {
+        return data_;
+    }
+
+    [[nodiscard]]
+    auto end() -> iterator
+    {
+        return data_ + size_;
+    }
+
+    [[nodiscard]]
+    auto end() const -> const_iterator
+    {
+        return data_ + size_;
+    }
+
+    [[nodiscard]]
+    auto cend() const -> const_iterator
+    {
+        return data_ + size_;
+    }
+
+    [[nodiscard]]
+    auto rbegin() -> reverse_iterator
+    {
+        return reverse_iterator{this->end()};
+    }
+
+    [[nodiscard]]
+    auto rbegin() const -> const_reverse_iterator
+    {
+        return const_reverse_iterator{this->end()};
+    }
+
+    [[nodiscard]]
+    auto crbegin() const -> const_reverse_iterator
+    {
+        return this->rbegin();
+    }
+
+    [[nodiscard]]
+    auto rend() -> reverse_iterator
+    {
+        return reverse_iterator{this->begin()};
+    }
+
+    [[nodiscard]]
+    auto rend() const -> const_reverse_iterator
+    {
+        return const_reverse_iterator{this->begin()};
+    }
+
+    [[nodiscard]]
+    auto crend() const -> const_reverse_iterator
+    {
+        return this->rend();
+    }
+
+    [[nodiscard]]
+    auto operator[](size_type index) -> T &
+    {
+        return data_[index];
+    }
+
+    [[nodiscard]]
+    auto operator[](size_type index) const -> T const &
+    {
+        return data_[index];
+    }
+
+    [[nodiscard]]
+    auto at(size_type index) -> T &
+    {
+        if (index >= size_)
+        {
+            throw std::out_of_range{"SmallVector::at: index out of range"};
+        }
+        return data_[index];
+    }
+
+    [[nodiscard]]
+    auto at(size_type index) const -> T const &
+    {
+        if (index >= size_)
+        {
+            throw std::out_of_range{"SmallVector::at: index out of range"};
+        }
+        return data_[index];
+    }
+
+    [[nodiscard]]
+    auto front() -> T &
+    {
+        return data_[0];
+    }
+
+    [[nodiscard]]
+    auto front() const -> T const &
+    {
+        return data_[0];
+    }
+
+    [[nodiscard]]
+    auto back() -> T &
+    {
+        return data_[size_ - 1];
+    }
+
+    [[nodiscard]]
+    auto back() const -> T const &
+    {
+        return data_[size_ - 1];
+    }
+
+  public:
+    auto reserve(size_type new_capacity) -> void
+    {
+        if (new_capacity > capacity_)
+        {
+            this->reallocate(new_capacity, [](T *) -> T * { return nullptr; });
+        }
+    }
+
+    /**
+     * @brief Moves a heap buffer to the inline buffer, or to a smaller heap buffer,
+     * when it holds more capacity than elements.
+     */
+    auto shrink_to_fit() -> void
+    {
+        if (this->is_inline() || size_ == capacity_)
+        {
+            return;
+        }
+        auto shrunk = SmallVector{};
+        shrunk.reserve(size_);
+        for (auto &value : *this)
+        {
+            shrunk.emplace_back(std::move_if_noexcept(value));
+        }
+        *this = std::move(shrunk);
+    }
+
+    auto resize(size_type count) -> void
+    {
+        this->resize_with(count, [this] { this->emplace_back(); });
+    }
+
+    auto resize(size_type count, T const &value) -> void
+    {
+        this->resize_with(count, [&] { this->emplace_back(value); });
+    }
+
+    auto assign(size_type count, T const &value) -> void
+    {
+        auto const copy = T(value);
+        this->clear();
+        this->reserve(count);
+        for (auto i = size_type{0}; i < count; ++i)
+        {
+            this->emplace_back(copy);
+        }
+    }
+
+    template <std::input_iterator It>
+    auto assign(It first, It last) -> void
+    {
+        this->clear();
+        this->insert(this->end(), first, last);
+    }
+
+    auto assign(std::initializer_list<T> values) -> void
+    {
+        this->assign(values.begin(), values.end());
+    }
+
+    template <typename... Args>
+    auto emplace_back(Args &&...args) -> T &
+    {
+        if (size_ < capacity_)
+        {
+            std::construct_at(data_ + size_, std::forward<Args>(args)...);
+        }
+        else
+        {
+            // The new element is constructed before the old ones are moved, in case
+            // args refer to an element of this container.
+            this->reallocate(capacity_ * 2, [&](T *new_data) {
+                return std::construct_at(new_data + size_, std::forward<Args>(args)...);
+            });
+        }
+        return data_[size_++];
+    }
+
+    auto push_back(T const &value) -> void
+    {
+        this->emplace_back(value);
+    }
+
+    auto push_back(T &&value) -> void
+    {
+        this->emplace_back(std::move(value));
+    }
+
+    auto pop_back() -> void
+    {
+        std::destroy_at(data_ + --size_);
+    }
+
+    template <typename... Args>
+    auto emplace(const_iterator position, Args &&...args) -> iterator
+    {
+        auto const index = position - data_;
+        this->emplace_back(std::forward<Args>(args)...);
+        std::rotate(data_ + index, data_ + size_ - 1, data_ + size_);
+        return data_ + index;
+    }
+
+    auto insert(const_iterator position, T const &value) -> iterator
+    {
+        return this->emplace(position, value);
+    }
+
+    auto insert(const_iterator position, T &&value) -> iterator
+    {
+        return this->emplace(position, std::move(value));
+    }
+
+    auto insert(const_iterator position, size_type count, T const &value) -> iterator
+    {
+        auto const copy = T(value);
+        return this->append_and_rotate(position, count, [&] {
+            for (auto i = size_type{0}; i < count; ++i)
+            {
+                this->emplace_back(copy);
+            }
+        });
+    }
+
+    template <std::input_iterator It>
+    auto insert(const_iterator position, It first, It last) -> iterator
+    {
+        auto count = size_type{0};
+        if constexpr (std::forward_iterator<It>)
+        {
+            count = static_cast<size_type>(std::distance(first, last));
+        }
+        return this->append_and_rotate(position, count, [&] {
+            for (; first != last; ++first)
+            {
+                this->emplace_back(*first);
+            }
+        });
+    }
+
+    auto insert(const_iterator position, std::initializer_list<T> values) -> iterator
+    {
+        return this->insert(position, values.begin(), values.end());
+    }
+
+    auto erase(const_iterator first, const_iterator last) -> iterator
+    {
+        auto *const begin = data_ + (first - data_);
+        auto *const end = data_ + (last - data_);
+        auto *const new_end = std::move(end, data_ + size_, begin);
+        std::destroy(new_end, data_ + size_);
+        size_ -= static_cast<size_type>(end - begin);
+        return begin;
+    }
+
+    auto erase(const_iterator position) -> iterator
+    {
+        return this->erase(position, position + 1);
+    }
+
+    auto clear() -> void
+    {
+        std::destroy(data_, data_ + size_);
+        size_ = 0;
+    }
+
+    auto swap(SmallVector &other) noexcept(std::is_nothrow_move_constructible_v<T>)
+        -> void
+    {
+        auto temp = std::move(other);
+        other = std::move(*this);
+        *this = std::move(temp);
+    }
+
+  private:
+    [[nodiscard]]
+    auto inline_data() -> T *
+    {
+        return std::launder(reinterpret_cast<T *>(inline_));
+    }
+
+    [[nodiscard]]
+    auto inline_data() const -> T const *
+    {
+        return std::launder(reinterpret_cast<T const *>(inline_));
+    }
+
+    /**
+     * @brief Moves the elements to a new heap buffer of \p new_capacity.
+     *
+     * \p construct_new is invoked with the new buffer before the existing elements
+     * are moved into it, and returns the element it constructed there, or nullptr.
+     * If constructing or moving any element throws, everything built in the new
+     * buffer is destroyed, the buffer is freed and this container is unchanged,
+     * unless an element with a throwing move and no copy was already moved from.
+     */
+    template <typename Fn>
+    auto reallocate(size_type new_capacity, Fn &&construct_new) -> void
+    {
+        auto allocator = std::allocator<T>{};
+        auto *const new_data = allocator.allocate(new_capacity);
+        T *constructed = nullptr;
+        auto moved = size_type{0};
+        try
+        {
+            constructed = construct_new(new_data);
+            for (; moved < size_; ++moved)
+            {
+                auto &old = data_[moved];
+                std::construct_at(new_data + moved, std::move_if_noexcept(old));
+            }
+        }
+        catch (...)
+        {
+            std::destroy(new_data, new_data + moved);
+            if (constructed != nullptr)
+            {
+                std::destroy_at(constructed);
+            }
+            allocator.deallocate(new_data, new_capacity);
+            throw;
+        }
+        std::destroy(data_, data_ + size_);
+        this->release();
+        data_ = new_data;
+        capacity_ = new_capacity;
+    }
+
+    /**
+     * @brief Grows or shrinks to \p count elements, calling \p append to add each
+     * missing one.
+     */
+    template <typename Fn>
+    auto resize_with(size_type count, Fn &&append) -> void
+    {
+        if (count <= size_)
+        {
+            this->erase(data_ + count, data_ + size_);
+            return;
+        }
+        this->reserve(count);
+        while (size_ < count)
+        {
+            append();
+        }
+    }
+
+    /**
+     * @brief Inserts at \p position the elements that \p append adds to the end.
+     *
+     * \p count is the number of elements \p append is expected to add, or 0 if not
+     * known in advance. If \p append throws, the elements it added are removed again.
+     */
+    template <typename Fn>
+    auto append_and_rotate(const_iterator position, size_type count, Fn &&append)
+        -> iterator
+    {
+        auto const index = position - data_;
+        auto const old_size = size_;
+        if (size_ + count > capacity_)
+        {
+            this->reserve(std::max(size_ + count, capacity_ * 2));
+        }
+        try
+        {
+            append();
+        }
+        catch (...)
+        {
+            this->erase(data_ + old_size, data_ + size_);
+            throw;
+        }
+        std::rotate(data_ + index, data_ + old_size, data_ + size_);
+        return data_ + index;
+    }
+
+    /**
+     * @brief Frees the heap buffer, if any, and points back at the inline buffer.
+     *
+     * The container must already be empty.
+     */
+    auto release() -> void
+    {
+        if (!this->is_inline())
+        {
+            std::allocator<T>{}.deallocate(data_, capacity_);
+            data_ = this->inline_data();
+            capacity_ = N;
+        }
+    }
+
+    /**
+     * @brief Takes over the contents of \p other, which is left empty.
+     *
+     * This container must be empty and using its inline buffer.
+     */
+    auto take(SmallVector &&other) -> void
+    {
+        if (other.is_inline())
+        {
+            for (auto i = size_type{0}; i < other.size_; ++i)
+            {
+                std::construct_at(data_ + i, std::move(other.data_[i]));
+            }
+            size_ = other.size_;
+            other.clear();
+        }
+        else
+        {
+            data_ = std::exchange(other.data_, other.inline_data());
+            size_ = std::exchange(other.size_, 0);
+            capacity_ = std::exchange(other.capacity_, N);
+        }
+    }
+
+  private:
+    alignas(T) std::byte inline_[N * sizeof(T)];
+    T *data_ = this->inline_data();
+    size_type size_ = 0;
+    size_type capacity_ = N;
+};
+
+template <typename T, std::size_t N>
+[[nodiscard]]
+auto operator==(SmallVector<T, N> const &lhs, SmallVector<T, N> const &rhs) -> bool
+{
+    if (lhs.size() != rhs.size())
+    {
+        return false;
+    }
+    return std::equal(lhs.begin(), lhs.end(), rhs.begin());
+}
+
+template <typename T, std::size_t N>
+auto swap(SmallVector<T, N> &lhs,
+          SmallVector<T, N> &rhs) noexcept(std::is_nothrow_move_constructible_v<T>)
+    -> void
+{
+    lhs.swap(rhs);
+}
+
+} // namespace sequence
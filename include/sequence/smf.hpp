@@ -0,0 +1,188 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <ios>
+#include <iosfwd>
+#include <queue>
+#include <span>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/time_signature.hpp>
+#include <sequence/timing.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief The layout of a Standard MIDI File.
+ */
+enum class SmfFormat : std::uint8_t
+{
+    /// Type 0, one track holding the tempo, time signature and every note.
+    single_track = 0,
+    /// Type 1, a conductor track holding the tempo and time signature, followed by a
+    /// track holding every note.
+    multi_track = 1,
+};
+
+/**
+ * @brief The timing and layout of a Standard MIDI File.
+ *
+ * sample_rate and bpm must match the values the notes were rendered with, sample
+ * positions are converted to ticks with samples_to_ticks().
+ */
+struct SmfSettings
+{
+    std::uint32_t sample_rate = 44'100;
+    float bpm = 120.f;
+    /// At most 32'767, the top bit of the division selects SMPTE timing.
+    std::uint16_t ticks_per_quarter = 480;
+    /// The denominator must be a power of two.
+    TimeSignature time_signature = {4, 4};
+    SmfFormat format = SmfFormat::single_track;
+};
+
+/**
+ * @brief Streams TimedMidiNotes to a Standard MIDI File.
+ *
+ * Notes are written in begin order as they arrive. Each note becomes a note on, and a
+ * note off that is held in a queue until the stream reaches its end, so memory is
+ * bounded by the number of notes sounding at once rather than the length of the file.
+ * Bytes are buffered and the stream is only written in large blocks.
+ *
+ * Events use running status, and note offs are written as note ons with a velocity
+ * of 0 so that runs of notes on one channel share a status byte. When a note's pitch
+ * bend differs from the last one sent on its channel, a pitch bend event is written
+ * before its note on; give sounding notes their own channels with allocate_channels()
+ * so their bends do not collide.
+ *
+ * The length of the note track is only known at the end, finish() seeks back to
+ * patch it, so \p out must be seekable, such as a std::ofstream opened in binary mode
+ * or a std::stringstream.
+ */
+class SmfWriter
+{
+  public:
+    /**
+     * @brief Writes the header of the file, and the conductor track of a multi_track
+     * file, to \p out.
+     *
+     * @throws std::invalid_argument if \p settings.sample_rate or
+     * \p settings.ticks_per_quarter is zero or ticks_per_quarter is over 32'767, if
+     * \p settings.bpm is out of the range of a MIDI tempo, or if
+     * \p settings.time_signature does not have a power of two denominator.
+     * @throws std::runtime_error if writing to \p out fails.
+     */
+    SmfWriter(std::ostream &out, SmfSettings const &settings);
+
+    SmfWriter(SmfWriter const &) = delete;
+    auto operator=(SmfWriter const &) -> SmfWriter & = delete;
+
+    /**
+     * @brief Calls finish() if it has not been called, ignoring any error.
+     */
+    ~SmfWriter();
+
+    /**
+     * @brief Writes \p note, which must not begin before the previously written note.
+     *
+     * Notes with end <= begin are skipped.
+     *
+     * @throws std::invalid_argument if \p note begins before the previous note.
+     * @throws std::logic_error if finish() has been called.
+     * @throws std::runtime_error if writing to the stream fails.
+     */
+    auto write(TimedMidiNote const &note) -> void;
+
+    /**
+     * @brief Writes each of \p notes, which must be sorted by begin.
+     */
+    auto write(std::span<TimedMidiNote const> notes) -> void;
+
+    /**
+     * @brief Writes the remaining note offs and the end of the track, then patches the
+     * track length and flushes the stream. Later calls do nothing.
+     *
+     * @throws std::runtime_error if writing to or seeking the stream fails.
+     */
+    auto finish() -> void;
+
+    /**
+     * @brief Returns the number of channel events written so far.
+     */
+    [[nodiscard]]
+    auto event_count() const -> std::size_t
+    {
+        return event_count_;
+    }
+
+  private:
+    struct NoteOff
+    {
+        std::uint64_t tick;
+        std::uint8_t channel;
+        std::uint8_t note;
+
+        auto operator<=>(NoteOff const &) const = default;
+    };
+
+    auto to_ticks(SampleTime sample) const -> std::uint64_t;
+
+    auto write_tempo_and_time_signature() -> void;
+
+    auto write_note_offs(std::uint64_t until) -> void;
+
+    auto write_channel_event(std::uint64_t tick,
+                             std::uint8_t status,
+                             std::uint8_t data1,
+                             std::uint8_t data2) -> void;
+
+    auto write_delta(std::uint64_t tick) -> void;
+
+    auto put(std::uint8_t byte) -> void;
+
+    auto flush() -> void;
+
+  private:
+    std::ostream *out_;
+    SmfSettings settings_;
+    std::vector<char> buffer_;
+
+    std::streamoff position_ = 0;
+    std::streamoff length_position_ = 0;
+    std::uint32_t track_length_ = 0;
+    std::uint64_t tick_ = 0;
+    SampleTime previous_begin_ = 0;
+    std::uint8_t running_status_ = 0;
+    std::array<std::uint16_t, 16> pitch_bends_;
+    std::priority_queue<NoteOff, std::vector<NoteOff>, std::greater<>> note_offs_;
+    std::size_t event_count_ = 0;
+    bool finished_ = false;
+};
+
+/**
+ * @brief Writes \p notes, sorted by begin, as a Standard MIDI File to \p out.
+ *
+ * @throws std::invalid_argument under the same conditions as SmfWriter.
+ * @throws std::runtime_error if writing to \p out fails.
+ */
+auto write_smf(std::ostream &out,
+               std::span<TimedMidiNote const> notes,
+               SmfSettings const &settings) -> void;
+
+/**
+ * @brief Writes \p notes, sorted by begin, as a Standard MIDI File to \p file.
+ *
+ * @throws std::invalid_argument under the same conditions as SmfWriter.
+ * @throws std::runtime_error if \p file cannot be opened or written.
+ */
+auto write_smf(std::filesystem::path const &file,
+               std::span<TimedMidiNote const> notes,
+               SmfSettings const &settings) -> void;
+
+} // namespace sequence::midi
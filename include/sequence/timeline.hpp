@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/tuning.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief An immutable, indexed set of rendered notes for repeated range queries.
+ *
+ * Notes are sorted by begin, keeping the render order of notes that begin together,
+ * and indexed by a segment tree holding the latest end of each range of notes. A
+ * query only descends into ranges that hold a reported note, visiting the ancestors of
+ * each reported note plus O(log n) other nodes: O(log n + k log(n / k)) for k reported
+ * notes, and O(log n + k) when they are adjacent. A host can compile a pattern once
+ * and ask for the notes of each audio block without rendering or sorting again.
+ */
+class Timeline
+{
+  public:
+    Timeline() = default;
+
+    /**
+     * @brief Sorts and indexes \p notes.
+     */
+    explicit Timeline(std::vector<TimedMidiNote> notes);
+
+    /**
+     * @brief Returns every note, sorted by begin.
+     */
+    [[nodiscard]]
+    auto notes() const -> std::span<TimedMidiNote const>
+    {
+        return notes_;
+    }
+
+    [[nodiscard]]
+    auto size() const -> std::size_t
+    {
+        return notes_.size();
+    }
+
+    [[nodiscard]]
+    auto empty() const -> bool
+    {
+        return notes_.empty();
+    }
+
+    /**
+     * @brief Returns the notes that begin in [begin, end), sorted by begin.
+     *
+     * O(log n), the result is a view into the Timeline.
+     */
+    [[nodiscard]]
+    auto starting_in(SampleTime begin, SampleTime end) const
+        -> std::span<TimedMidiNote const>;
+
+    /**
+     * @brief Appends the notes that intersect [begin, end) to \p out, sorted by begin.
+     *
+     * A note of zero length intersects if it begins inside the window, the same as
+     * flatten_to_midi_window(). O(log n + k log(n / k)) for k reported notes.
+     */
+    auto overlapping(SampleTime begin,
+                     SampleTime end,
+                     std::vector<TimedMidiNote> &out) const -> void;
+
+    /**
+     * @brief Returns the notes that intersect [begin, end), sorted by begin.
+     */
+    [[nodiscard]]
+    auto overlapping(SampleTime begin, SampleTime end) const
+        -> std::vector<TimedMidiNote>;
+
+    /**
+     * @brief Returns the notes sounding at \p sample, those with begin <= sample < end.
+     *
+     * O(log n + k log(n / k)) for k reported notes.
+     */
+    [[nodiscard]]
+    auto active_at(SampleTime sample) const -> std::vector<TimedMidiNote>;
+
+  private:
+    /**
+     * @brief Appends the notes among the first \p count whose end is after \p sample.
+     */
+    auto ending_after(std::size_t count,
+                      SampleTime sample,
+                      std::vector<TimedMidiNote> &out) const -> void;
+
+  private:
+    std::vector<TimedMidiNote> notes_;
+
+    // Segment tree over notes_, node 1 is the root and node i has children 2i and
+    // 2i + 1. Leaf leaves_ + i holds notes_[i].end, padding leaves hold 0.
+    std::vector<SampleTime> max_end_;
+    std::size_t leaves_ = 0;
+};
+
+/**
+ * @brief Renders \p cell and compiles the result into a Timeline.
+ *
+ * @throws std::invalid_argument under the same conditions as flatten_to_midi().
+ */
+[[nodiscard]]
+auto to_timeline(Cell const &cell,
+                 SampleTime sample_offset,
+                 SampleTime sample_count,
+                 PitchMap const &pitch_map) -> Timeline;
+
+/**
+ * @brief Renders \p cell and compiles the result into a Timeline.
+ *
+ * @throws std::invalid_argument under the same conditions as flatten_to_midi().
+ */
+[[nodiscard]]
+auto to_timeline(Cell const &cell,
+                 SampleTime sample_offset,
+                 SampleTime sample_count,
+                 Tuning const &tuning,
+                 float base_frequency,
+                 float pb_range) -> Timeline;
+
+} // namespace sequence::midi
@@ -1,20 +1,98 @@
 #pragma once
 
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
+#include <stdexcept>
 
 #include <sequence/time_signature.hpp>
 
 namespace sequence
 {
 
+/**
+ * @brief A sample position or number of samples.
+ *
+ * 64-bit, so a timeline at 192 kHz runs for millions of years before it overflows.
+ */
+using SampleTime = std::uint64_t;
+
+/**
+ * @brief A span of samples, [offset, offset + count).
+ */
+struct SampleSpan
+{
+    SampleTime offset;
+    SampleTime count;
+
+    auto operator==(SampleSpan const &) const -> bool = default;
+    auto operator!=(SampleSpan const &) const -> bool = default;
+};
+
+/**
+ * @brief Splits a sample span across sibling cells in proportion to their weights.
+ *
+ * Call next() once per child cell, in order, with the cell's weight. Child boundaries
+ * are rounded to the nearest sample and the last child always ends exactly at the end
+ * of the parent span, so the children tile the parent without gaps or overlap.
+ *
+ * Each boundary is computed from the weight of every cell before it, rather than by
+ * adding up the lengths of the previous cells, so rounding errors do not accumulate
+ * across siblings. For integer weights and spans under 2^40 samples, every boundary is
+ * the exact rational boundary rounded to the nearest sample.
+ */
+class Subdivision
+{
+  public:
+    /**
+     * @param span The parent span to split.
+     * @param total_weight The sum of the weights of all child cells.
+     * @param cell_count The number of child cells.
+     * @throws std::invalid_argument if \p total_weight is not greater than zero.
+     */
+    Subdivision(SampleSpan span, double total_weight, std::size_t cell_count)
+        : span_{span}, begin_{span.offset}, total_weight_{total_weight},
+          remaining_{cell_count}
+    {
+        if (total_weight <= 0.)
+        {
+            throw std::invalid_argument("sequence total weight must be greater than 0");
+        }
+    }
+
+    /**
+     * @brief Returns the span of the next child cell, which has \p weight.
+     */
+    [[nodiscard]]
+    auto next(float weight) -> SampleSpan
+    {
+        weight_before_ += static_cast<double>(weight);
+        auto const end =
+            --remaining_ == 0
+                ? span_.offset + span_.count
+                : span_.offset + static_cast<SampleTime>(std::llround(
+                                     static_cast<double>(span_.count) * weight_before_ /
+                                     total_weight_));
+        auto const span = SampleSpan{.offset = begin_, .count = end - begin_};
+        begin_ = end;
+        return span;
+    }
+
+  private:
+    SampleSpan span_;
+    SampleTime begin_;
+    double weight_before_ = 0.;
+    double total_weight_;
+    std::size_t remaining_;
+};
+
 /**
  * @brief Calculates the number of samples in the given top-level measure.
  *
  * @param time_signature The top-level time signature for the measure.
  * @param sample_rate The sample rate of the audio.
  * @param bpm The beats per minute of the audio.
- * @return std::uint32_t - The number of samples in the measure.
+ * @return SampleTime - The number of samples in the measure.
  *
  * @throws std::invalid_argument if \p time_signature.denominator is zero, if
  * \p sample_rate is zero, or if \p bpm is not greater than zero.
@@ -22,6 +100,28 @@ namespace sequence
 [[nodiscard]]
 auto samples_count(TimeSignature const &time_signature,
                    std::uint32_t sample_rate,
-                   float bpm) -> std::uint32_t;
+                   float bpm) -> SampleTime;
+
+/**
+ * @brief Converts a sample position to MIDI ticks, with a quarter note per beat.
+ *
+ * Uses the same beat length as samples_count(), so a measure of samples_count()
+ * samples is numerator * 4 / denominator quarter notes of ticks. Rounds to the nearest
+ * tick.
+ *
+ * @param sample The sample position to convert.
+ * @param sample_rate The sample rate of the audio.
+ * @param bpm The beats per minute of the audio.
+ * @param ticks_per_quarter The number of ticks in a quarter note.
+ * @return std::uint64_t - The tick position of \p sample.
+ *
+ * @throws std::invalid_argument if \p sample_rate or \p ticks_per_quarter is zero, or
+ * if \p bpm is not greater than zero.
+ */
+[[nodiscard]]
+auto samples_to_ticks(SampleTime sample,
+                      std::uint32_t sample_rate,
+                      float bpm,
+                      std::uint16_t ticks_per_quarter) -> std::uint64_t;
 
 } // namespace sequence
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <concepts>
+#include <cstddef>
+#include <span>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <variant>
+
+#include <sequence/pattern.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+
+namespace sequence
+{
+
+namespace detail
+{
+
+/**
+ * @brief Applies the const qualification of \p From to \p To.
+ */
+template <typename From, typename To>
+using like_const_t = std::conditional_t<std::is_const_v<From>, To const, To>;
+
+/**
+ * @brief Invokes a visitor callback that may return bool, returning true if it
+ * returns void.
+ */
+template <typename Fn>
+auto invoke_predicate(Fn &&fn) -> bool
+{
+    if constexpr (std::is_void_v<decltype(fn())>)
+    {
+        fn();
+        return true;
+    }
+    else
+    {
+        return static_cast<bool>(fn());
+    }
+}
+
+/**
+ * @brief The node types of the tree an element type belongs to, and how to reach them.
+ *
+ * Specialized for each element type traverse() walks, see TraversableElement.
+ */
+template <typename Element>
+struct Tree;
+
+template <typename Element>
+    requires std::same_as<std::remove_const_t<Element>, MusicElement>
+struct Tree<Element>
+{
+    using SequenceT = like_const_t<Element, Sequence>;
+    using CellT = like_const_t<Element, Cell>;
+
+    static auto sequence(Element &element) -> SequenceT &
+    {
+        return *std::get_if<Sequence>(&element);
+    }
+
+    static auto cells(SequenceT &seq) -> auto &
+    {
+        return seq.cells;
+    }
+};
+
+/**
+ * @brief The element types traverse() walks: MusicElement, and any other element type
+ * whose header specializes Tree, such as PersistentElement const in persistent.hpp.
+ */
+template <typename Element>
+concept TraversableElement = requires { typename Tree<Element>::SequenceT; };
+
+template <typename Element, typename Visitor>
+class Traversal
+{
+    using SequenceT = typename Tree<Element>::SequenceT;
+    using CellT = typename Tree<Element>::CellT;
+
+    struct Frame
+    {
+        SequenceT *seq;
+        std::size_t cell;     // Index of the current child cell.
+        std::size_t interval; // Index of the pattern interval to step by next.
+        std::size_t element;  // Index of the next element of the current cell.
+        bool entered;         // True once enter_cell has run for the current cell.
+    };
+
+  public:
+    Traversal(Pattern const *pattern, Visitor &visitor)
+        : pattern_{pattern}, visitor_{visitor}
+    {
+    }
+
+    auto run(std::span<Element> elements) -> void
+    {
+        for (auto &element : elements)
+        {
+            this->visit(element);
+            this->drain();
+        }
+    }
+
+  private:
+    /**
+     * @brief Visits a Note, or pushes a frame for a Sequence.
+     */
+    auto visit(Element &element) -> void
+    {
+        if (auto *note = std::get_if<Note>(&element))
+        {
+            if constexpr (requires { visitor_.note(*note); })
+            {
+                visitor_.note(*note);
+            }
+            return;
+        }
+
+        auto &seq = Tree<Element>::sequence(element);
+        if constexpr (requires { visitor_.enter_sequence(seq); })
+        {
+            if (!invoke_predicate([&] { return visitor_.enter_sequence(seq); }))
+            {
+                return;
+            }
+        }
+        if (pattern_ != nullptr && pattern_->intervals.empty())
+        {
+            throw std::invalid_argument("traverse: Pattern should not be empty.");
+        }
+        stack_.push_back(Frame{
+            .seq = &seq,
+            .cell = pattern_ != nullptr ? pattern_->offset : 0,
+            .interval = 0,
+            .element = 0,
+            .entered = false,
+        });
+    }
+
+    /**
+     * @brief Runs until every frame pushed since the stack was last empty is done.
+     */
+    auto drain() -> void
+    {
+        while (!stack_.empty())
+        {
+            auto &frame = stack_.back();
+            auto &cells = Tree<Element>::cells(*frame.seq);
+
+            if (frame.cell >= cells.size())
+            {
+                auto &seq = *frame.seq;
+                stack_.pop_back();
+                if constexpr (requires { visitor_.exit_sequence(seq); })
+                {
+                    visitor_.exit_sequence(seq);
+                }
+                continue;
+            }
+
+            CellT &cell = cells[frame.cell];
+            if (!frame.entered)
+            {
+                frame.entered = true;
+                if constexpr (requires { visitor_.enter_cell(cell); })
+                {
+                    if (!invoke_predicate([&] { return visitor_.enter_cell(cell); }))
+                    {
+                        this->advance(frame);
+                        continue;
+                    }
+                }
+            }
+
+            if (frame.element < cell.elements.size())
+            {
+                // May push a frame and invalidate frame, so it is not used after.
+                this->visit(cell.elements[frame.element++]);
+                continue;
+            }
+
+            if constexpr (requires { visitor_.exit_cell(cell); })
+            {
+                visitor_.exit_cell(cell);
+            }
+            this->advance(frame);
+        }
+    }
+
+    /**
+     * @brief Steps \p frame to the next child cell selected by the pattern.
+     */
+    auto advance(Frame &frame) const -> void
+    {
+        if (pattern_ == nullptr)
+        {
+            ++frame.cell;
+        }
+        else
+        {
+            frame.cell += pattern_->intervals[frame.interval];
+            frame.interval = (frame.interval + 1) % pattern_->intervals.size();
+        }
+        frame.element = 0;
+        frame.entered = false;
+    }
+
+  private:
+    Pattern const *pattern_;
+    Visitor &visitor_;
+    SmallVector<Frame, 32> stack_;
+};
+
+} // namespace detail
+
+/**
+ * @brief Walks a tree of MusicElements depth-first, without recursion.
+ *
+ * Every element of \p elements is visited, and each nested Sequence only descends into
+ * the child cells selected by \p pattern, which is applied independently at each
+ * level. Elements are visited in the same order as a recursive depth-first walk.
+ *
+ * The walk keeps its position in an explicit stack instead of on the call stack, so
+ * arbitrarily deep trees neither overflow the call stack nor allocate per level; the
+ * first 32 levels need no allocation at all.
+ *
+ * \p visitor may define any of the following members, missing ones are skipped:
+ * - note(Note &): called for each visited Note.
+ * - enter_sequence(Sequence &): called before a Sequence's cells are visited, and may
+ *   reorder them. If it returns false, the Sequence's cells are skipped and
+ *   exit_sequence is not called.
+ * - exit_sequence(Sequence &): called after a Sequence's selected cells are visited.
+ * - enter_cell(Cell &): called before a selected child cell's elements are visited.
+ *   If it returns false, the elements are skipped and exit_cell is not called.
+ * - exit_cell(Cell &): called after a child cell's elements are visited, and may
+ *   replace them.
+ * enter_cell and exit_cell are not called for the cell that holds \p elements. If
+ * \p elements is const, the members are called with const references.
+ *
+ * PersistentCell trees are walked the same way, see persistent.hpp: the sequence
+ * members are called with the PersistentSequencePtr const & that holds each node, and
+ * the cell members with PersistentCell const &.
+ *
+ * @param elements The root elements to walk.
+ * @param pattern The pattern applied at each sequence level.
+ * @param visitor The callbacks, see above.
+ * @throws std::invalid_argument if a Sequence is entered and \p pattern has no
+ * intervals.
+ */
+template <typename Element, typename Visitor>
+    requires detail::TraversableElement<Element>
+auto traverse(std::span<Element> elements, Pattern const &pattern, Visitor &&visitor)
+    -> void
+{
+    using Traversal = detail::Traversal<Element, std::remove_reference_t<Visitor>>;
+    Traversal{&pattern, visitor}.run(elements);
+}
+
+/**
+ * @brief Walks a tree of MusicElements depth-first, visiting every cell.
+ *
+ * Equivalent to traverse(elements, Pattern{0, {1}}, visitor).
+ */
+template <typename Element, typename Visitor>
+    requires detail::TraversableElement<Element>
+auto traverse(std::span<Element> elements, Visitor &&visitor) -> void
+{
+    using Traversal = detail::Traversal<Element, std::remove_reference_t<Visitor>>;
+    Traversal{nullptr, visitor}.run(elements);
+}
+
+/**
+ * @brief Walks the tree below a single element, see traverse(std::span...).
+ */
+template <typename Element, typename... Args>
+    requires detail::TraversableElement<Element>
+auto traverse(Element &element, Args &&...args) -> void
+{
+    traverse(std::span<Element>{&element, 1}, std::forward<Args>(args)...);
+}
+
+/**
+ * @brief Walks the tree below the elements of \p cell, see traverse(std::span...).
+ */
+template <typename CellT, typename... Args>
+    requires std::same_as<std::remove_const_t<CellT>, Cell>
+auto traverse(CellT &cell, Args &&...args) -> void
+{
+    using Element = detail::like_const_t<CellT, MusicElement>;
+    traverse(std::span<Element>{cell.elements.data(), cell.elements.size()},
+             std::forward<Args>(args)...);
+}
+
+} // namespace sequence
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+namespace sequence
+{
+
+/**
+ * @brief Hands values from one writer thread to one reader thread without locks.
+ *
+ * Holds three values: the reader's front, the writer's back, and a middle that the
+ * two swap with. The writer fills back() and publish()es it into the middle, the
+ * reader's read() takes the middle if it is newer than its front. Each side is a
+ * single atomic exchange, so read() is wait-free and never blocks behind the writer,
+ * and the reader sees every value either whole or not at all.
+ *
+ * Values are only ever assigned, moved and destroyed on the writer's thread: read()
+ * swaps indices and nothing else, so a reader on an audio thread never frees memory.
+ * Filling back() in place reuses the capacity of an old value, so a writer that
+ * renders with the out-parameter overloads of flatten_to_midi() stops allocating once
+ * the buffers have grown.
+ *
+ * Only one thread may call back() and publish(), and only one thread may call read().
+ *
+ * @tparam T The value type, such as std::vector<midi::TimedMidiNote> or midi::Timeline.
+ *
+ * @example
+ * // Writer thread.
+ * auto &notes = buffer.back();
+ * notes.clear();
+ * midi::flatten_to_midi(cell.elements, 0, samples, pitch_map, notes);
+ * buffer.publish();
+ *
+ * // Audio thread.
+ * for (auto const &note : buffer.read()) { ... }
+ */
+template <typename T>
+class TripleBuffer
+{
+  public:
+    TripleBuffer() = default;
+
+    /**
+     * @brief Starts every value as a copy of \p initial.
+     */
+    explicit TripleBuffer(T const &initial) : values_{initial, initial, initial}
+    {
+    }
+
+    TripleBuffer(TripleBuffer const &) = delete;
+    auto operator=(TripleBuffer const &) -> TripleBuffer & = delete;
+
+    /**
+     * @brief Returns the writer's value, to be filled before publish().
+     *
+     * Holds whatever the reader was last given before it moved on, not the last
+     * published value.
+     */
+    [[nodiscard]]
+    auto back() -> T &
+    {
+        return values_[back_];
+    }
+
+    /**
+     * @brief Makes back() the value the reader sees next.
+     */
+    auto publish() -> void
+    {
+        back_ = middle_.exchange(back_ | fresh, std::memory_order_acq_rel) & index;
+    }
+
+    /**
+     * @brief Replaces back() with \p value and publishes it.
+     *
+     * The value replaced is destroyed on the calling thread.
+     */
+    auto publish(T value) -> void
+    {
+        values_[back_] = std::move(value);
+        this->publish();
+    }
+
+    /**
+     * @brief Returns the most recently published value. Wait-free.
+     *
+     * The reference stays valid, and the value unchanged, until the next call to
+     * read().
+     */
+    [[nodiscard]]
+    auto read() -> T const &
+    {
+        if (middle_.load(std::memory_order_relaxed) & fresh)
+        {
+            front_ = middle_.exchange(front_, std::memory_order_acq_rel) & index;
+        }
+        return values_[front_];
+    }
+
+  private:
+    static constexpr auto index = std::uint8_t{0b011};
+    static constexpr auto fresh = std::uint8_t{0b100}; // Published since last read.
+
+    std::array<T, 3> values_{};
+    std::uint8_t back_ = 0;
+    // Kept off the writer's cache line, so the reader only contends on publish.
+    alignas(64) std::atomic<std::uint8_t> middle_ = 1;
+    alignas(64) std::uint8_t front_ = 2;
+};
+
+} // namespace sequence
@@ -0,0 +1,158 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/timing.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief The timing and addressing of a Universal MIDI Packet stream.
+ *
+ * sample_rate and bpm must match the values the notes are rendered with, sample
+ * positions are converted to Delta Clockstamp ticks with samples_to_ticks().
+ */
+struct UmpSettings
+{
+    std::uint32_t sample_rate = 44'100;
+    float bpm = 120.f;
+    std::uint16_t ticks_per_quarter = 480;
+    /// The UMP group of every message, in [0, 15].
+    std::uint8_t group = 0;
+    /// The MIDI channel of every message, in [0, 15], except notes moved off it to keep
+    /// their own pitch bend, see UmpRenderer.
+    std::uint8_t channel = 0;
+    /// The per-note pitch bend range expected by the receiver, in semitones. MIDI 2.0
+    /// receivers default to 48.
+    float pitch_bend_range = 48.f;
+};
+
+/**
+ * @brief The outcome of UmpRenderer::render.
+ */
+struct UmpResult
+{
+    /// The number of words the elements render to, which may exceed the buffer size.
+    std::size_t word_count;
+    RenderStatus status;
+
+    auto operator==(UmpResult const &) const -> bool = default;
+    auto operator!=(UmpResult const &) const -> bool = default;
+};
+
+/**
+ * @brief Renders music elements to MIDI 2.0 Universal MIDI Packets.
+ *
+ * Each note is a 64-bit Note On with a 16-bit velocity and a Note Off. A 64-bit
+ * Per-Note Pitch Bend with 32-bit resolution precedes the first note of each key in a
+ * render, and any note whose bend differs from the last one sent for its key. Pitches
+ * come from PitchMap::fractional_note(), so they are not quantized to the 14-bit pitch
+ * bend of TimedMidiNote, and notes on different keys of a channel bend independently
+ * without allocate_channels().
+ *
+ * A per-note bend belongs to a key, so a note that overlaps a sounding note of the same
+ * key with a different bend is moved to the next channel of the group, counting up
+ * from settings.channel and wrapping, on which its key is silent or sounds with the
+ * same bend. If all 16 channels are taken it stays on settings.channel, and retunes
+ * the notes sounding there.
+ *
+ * The stream starts with a Delta Clockstamp Ticks Per Quarter Note message, and each
+ * change of time is a Delta Clockstamp from the previous event, or from the start of
+ * the rendered span for the first. Events at the same time are ordered note offs,
+ * pitch bends, then note ons. Notes with end <= begin are skipped.
+ *
+ * The renderer keeps its scratch buffers between renders, so once they have grown to
+ * fit a pattern, rendering it again does not allocate.
+ */
+class UmpRenderer
+{
+  public:
+    /**
+     * @throws std::invalid_argument if \p settings.sample_rate or
+     * \p settings.ticks_per_quarter is zero, if \p settings.bpm or
+     * \p settings.pitch_bend_range is not greater than zero, or if \p settings.group
+     * or \p settings.channel is over 15.
+     */
+    UmpRenderer(PitchMap pitch_map, UmpSettings const &settings);
+
+    /**
+     * @brief Renders \p elements over [sample_offset, sample_offset + sample_count)
+     * into \p out.
+     *
+     * Writes as many words as fit into \p out. Sequences with a total child weight
+     * that is not greater than zero are skipped and reported in the result.
+     *
+     * @return UmpResult - The number of words the full stream takes, and the status.
+     */
+    auto render(std::span<MusicElement const> elements,
+                SampleTime sample_offset,
+                SampleTime sample_count,
+                std::span<std::uint32_t> out) -> UmpResult;
+
+    /**
+     * @brief Returns the pitch map used to map pitches to notes.
+     */
+    [[nodiscard]]
+    auto pitch_map() const -> PitchMap const &
+    {
+        return pitch_map_;
+    }
+
+  private:
+    /**
+     * @brief A note at full resolution, before it is encoded.
+     */
+    struct Voice
+    {
+        SampleTime begin;
+        SampleTime end;
+        std::uint32_t pitch_bend;
+        std::uint16_t velocity;
+        std::uint8_t note;
+    };
+
+    struct NoteOff
+    {
+        SampleTime end;
+        std::uint8_t note;
+        std::uint8_t channel;
+
+        auto operator<=>(NoteOff const &) const = default;
+    };
+
+    class Writer;
+
+    /**
+     * @brief Returns the channel to play \p voice on, see the class documentation.
+     */
+    [[nodiscard]]
+    auto pick_channel(Voice const &voice) const -> std::uint8_t;
+
+    /**
+     * @brief Returns the index of \p note on \p channel into the per-key state.
+     */
+    [[nodiscard]]
+    static auto key_index(std::uint8_t channel, std::uint8_t note) -> std::size_t
+    {
+        return std::size_t{channel} * 128 + note;
+    }
+
+  private:
+    PitchMap pitch_map_;
+    UmpSettings settings_;
+    std::vector<Voice> voices_;
+    std::vector<NoteOff> note_offs_;
+    /// The last bend sent for each channel and key in the current render, or unsent.
+    std::array<std::uint64_t, 16 * 128> pitch_bends_;
+    /// The number of notes sounding on each channel and key.
+    std::array<std::uint16_t, 16 * 128> sounding_;
+};
+
+} // namespace sequence::midi
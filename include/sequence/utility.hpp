@@ -1,5 +1,7 @@
 #pragma once
 
+#include <cstddef>
+
 namespace sequence::utility
 {
 
@@ -17,4 +19,13 @@ struct overload : Ts...
 template <class... Ts>
 overload(Ts...) -> overload<Ts...>;
 
+/**
+ * @brief Mixes \p value into the running hash \p seed.
+ */
+[[nodiscard]]
+constexpr auto hash_combine(std::size_t seed, std::size_t value) -> std::size_t
+{
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+}
+
 } // namespace sequence::utility
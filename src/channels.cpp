@@ -0,0 +1,142 @@
+#include <sequence/channels.hpp>
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+
+#include <sequence/midi.hpp>
+#include <sequence/timing.hpp>
+
+namespace
+{
+
+constexpr auto midi_channel_count = std::size_t{16};
+
+/**
+ * @brief The note sounding on a channel, if any, and when the channel went silent.
+ */
+struct Voice
+{
+    sequence::midi::TimedMidiNote *note = nullptr;
+    sequence::SampleTime released = 0;
+};
+
+[[nodiscard]]
+auto validate_member_channels(std::uint8_t member_channels) -> std::uint8_t
+{
+    if (member_channels < 1 || member_channels > 15)
+    {
+        throw std::invalid_argument("MPE zones have between 1 and 15 member channels");
+    }
+    return member_channels;
+}
+
+} // namespace
+
+namespace sequence::midi
+{
+
+auto mpe_lower_zone(std::uint8_t member_channels, ChannelPolicy policy)
+    -> ChannelAllocation
+{
+    return ChannelAllocation{
+        .first_channel = 1,
+        .channel_count = validate_member_channels(member_channels),
+        .policy = policy,
+    };
+}
+
+auto mpe_upper_zone(std::uint8_t member_channels, ChannelPolicy policy)
+    -> ChannelAllocation
+{
+    return ChannelAllocation{
+        .first_channel =
+            static_cast<std::uint8_t>(15 - validate_member_channels(member_channels)),
+        .channel_count = member_channels,
+        .policy = policy,
+    };
+}
+
+auto allocate_channels(std::span<TimedMidiNote> notes,
+                       ChannelAllocation const &allocation) -> std::size_t
+{
+    auto const count = std::size_t{allocation.channel_count};
+    if (count == 0 || allocation.first_channel + count > midi_channel_count)
+    {
+        throw std::invalid_argument("channel allocation must lie within 16 channels");
+    }
+
+    auto voices = std::array<Voice, midi_channel_count>{};
+    auto last = count - 1; // Channel used last, so round robin starts at the first.
+    auto stolen = std::size_t{0};
+    auto previous_begin = SampleTime{0};
+
+    for (auto &note : notes)
+    {
+        if (note.begin < previous_begin)
+        {
+            throw std::invalid_argument("notes must be sorted by begin");
+        }
+        previous_begin = note.begin;
+
+        for (auto i = std::size_t{0}; i < count; ++i)
+        {
+            auto &voice = voices[i];
+            if (voice.note != nullptr && voice.note->end <= note.begin)
+            {
+                voice.released = voice.note->end;
+                voice.note = nullptr;
+            }
+        }
+
+        auto chosen = count;
+        if (allocation.policy == ChannelPolicy::round_robin)
+        {
+            for (auto step = std::size_t{1}; step <= count; ++step)
+            {
+                auto const i = (last + step) % count;
+                if (voices[i].note == nullptr)
+                {
+                    chosen = i;
+                    break;
+                }
+            }
+        }
+        else
+        {
+            for (auto i = std::size_t{0}; i < count; ++i)
+            {
+                if (voices[i].note == nullptr &&
+                    (chosen == count || voices[i].released < voices[chosen].released))
+                {
+                    chosen = i;
+                }
+            }
+        }
+
+        if (chosen == count)
+        {
+            // Every channel is busy, steal the one whose note began first.
+            chosen = 0;
+            for (auto i = std::size_t{1}; i < count; ++i)
+            {
+                if (voices[i].note->begin < voices[chosen].note->begin)
+                {
+                    chosen = i;
+                }
+            }
+            voices[chosen].note->end = note.begin;
+            ++stolen;
+        }
+
+        note.channel = static_cast<std::uint8_t>(allocation.first_channel + chosen);
+        voices[chosen].note = &note;
+        last = chosen;
+    }
+
+    return stolen;
+}
+
+} // namespace sequence::midi
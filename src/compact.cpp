@@ -0,0 +1,88 @@
+#include <sequence/compact.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <sequence/midi.hpp>
+
+namespace
+{
+
+/**
+ * @brief Returns a key that is equal for notes that may be merged.
+ */
+[[nodiscard]]
+auto merge_key(sequence::midi::TimedMidiNote const &note) -> std::uint64_t
+{
+    return std::uint64_t{note.channel} << 32 | std::uint64_t{note.note} << 24 |
+           std::uint64_t{note.velocity} << 16 | std::uint64_t{note.pitch_bend};
+}
+
+} // namespace
+
+namespace sequence::midi
+{
+
+auto compact_notes(std::vector<TimedMidiNote> &notes) -> std::size_t
+{
+    auto const original_size = notes.size();
+
+    std::erase_if(notes, [](TimedMidiNote const &note) {
+        return note.end <= note.begin;
+    });
+    std::stable_sort(notes.begin(), notes.end(),
+                     [](TimedMidiNote const &a, TimedMidiNote const &b) {
+                         return a.begin < b.begin;
+                     });
+
+    // The index in the compacted prefix of the last kept note of each key.
+    auto last_of_key = std::unordered_map<std::uint64_t, std::size_t>{};
+    auto kept = std::size_t{0};
+    for (auto const &note : notes)
+    {
+        auto const [found, inserted] = last_of_key.try_emplace(merge_key(note), kept);
+        if (!inserted)
+        {
+            auto &previous = notes[found->second];
+            if (note.begin < previous.end)
+            {
+                previous.end = std::max(previous.end, note.end);
+                continue;
+            }
+            found->second = kept;
+        }
+        notes[kept++] = note;
+    }
+    notes.resize(kept);
+
+    return original_size - kept;
+}
+
+auto remove_redundant_pitch_bends(std::vector<MidiEvent> &events) -> std::size_t
+{
+    auto const original_size = events.size();
+
+    auto sent = std::array<std::optional<std::uint16_t>, 16>{};
+    std::erase_if(events, [&](MidiEvent const &event) {
+        if (event.kind != MidiEvent::Kind::pitch_bend)
+        {
+            return false;
+        }
+        auto &bend = sent[event.channel & 0x0F];
+        if (bend == event.pitch_bend)
+        {
+            return true;
+        }
+        bend = event.pitch_bend;
+        return false;
+    });
+
+    return original_size - events.size();
+}
+
+} // namespace sequence::midi
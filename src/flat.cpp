@@ -0,0 +1,115 @@
+#include <sequence/flat.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sequence/sequence.hpp>
+#include <sequence/utility.hpp>
+
+namespace sequence
+{
+
+auto to_flat(Cell const &cell) -> FlatSequence
+{
+    auto flat = FlatSequence{};
+
+    // sources[i] is the recursive Cell that flat.cells[i] is built from. Cells are
+    // appended breadth-first, so walking the vector in order visits parents first.
+    auto sources = std::vector<Cell const *>{&cell};
+    flat.cells.push_back(
+        {.elements_begin = 0, .elements_count = 0, .weight = cell.weight});
+
+    for (auto i = std::size_t{0}; i < sources.size(); ++i)
+    {
+        auto const &source = *sources[i];
+
+        auto &node = flat.cells[i];
+        node.elements_begin = static_cast<std::uint32_t>(flat.elements.size());
+        node.elements_count = static_cast<std::uint32_t>(source.elements.size());
+
+        for (auto const &element : source.elements)
+        {
+            std::visit(
+                utility::overload{
+                    [&](Note const &note) {
+                        flat.elements.push_back({
+                            .kind = FlatSequence::ElementNode::Kind::Note,
+                            .index = static_cast<std::uint32_t>(flat.notes.size()),
+                        });
+                        flat.notes.push_back(note, static_cast<std::uint32_t>(i));
+                    },
+                    [&](Sequence const &seq) {
+                        flat.elements.push_back({
+                            .kind = FlatSequence::ElementNode::Kind::Sequence,
+                            .index = static_cast<std::uint32_t>(flat.sequences.size()),
+                        });
+                        flat.sequences.push_back({
+                            .cells_begin =
+                                static_cast<std::uint32_t>(flat.cells.size()),
+                            .cells_count =
+                                static_cast<std::uint32_t>(seq.cells.size()),
+                        });
+                        for (auto const &child : seq.cells)
+                        {
+                            sources.push_back(&child);
+                            flat.cells.push_back({.elements_begin = 0,
+                                                  .elements_count = 0,
+                                                  .weight = child.weight});
+                        }
+                    },
+                },
+                element);
+        }
+    }
+
+    return flat;
+}
+
+auto from_flat(FlatSequence const &flat) -> Cell
+{
+    if (flat.cells.empty())
+    {
+        return Cell{};
+    }
+
+    // Children always have a higher index than their parent, so building in reverse
+    // index order means every child Cell is complete before its parent needs it.
+    auto built = std::vector<Cell>(flat.cells.size());
+
+    for (auto i = flat.cells.size(); i-- > 0;)
+    {
+        auto const &node = flat.cells[i];
+        auto &cell = built[i];
+        cell.weight = node.weight;
+        cell.elements.reserve(node.elements_count);
+
+        for (auto e = node.elements_begin;
+             e < node.elements_begin + node.elements_count; ++e)
+        {
+            auto const &element = flat.elements[e];
+            if (element.kind == FlatSequence::ElementNode::Kind::Note)
+            {
+                cell.elements.push_back(flat.notes.note(element.index));
+            }
+            else
+            {
+                auto const &seq_node = flat.sequences[element.index];
+                auto seq = Sequence{};
+                seq.cells.reserve(seq_node.cells_count);
+                for (auto c = seq_node.cells_begin;
+                     c < seq_node.cells_begin + seq_node.cells_count; ++c)
+                {
+                    seq.cells.push_back(std::move(built[c]));
+                }
+                cell.elements.push_back(std::move(seq));
+            }
+        }
+    }
+
+    return std::move(built[0]);
+}
+
+} // namespace sequence
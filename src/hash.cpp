@@ -0,0 +1,288 @@
+#include <sequence/hash.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <functional>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/traverse.hpp>
+#include <sequence/utility.hpp>
+
+namespace
+{
+
+using sequence::utility::hash_combine;
+
+// Distinct seeds keep a Note and a Sequence with equal payloads from colliding.
+constexpr auto note_seed = std::size_t{0x6e6f7465};
+constexpr auto sequence_seed = std::size_t{0x73657175};
+
+/**
+ * @brief Hashes a cell from the hashes of its elements.
+ */
+template <typename CellT, typename ElementHash>
+[[nodiscard]]
+auto hash_cell(CellT const &cell, ElementHash const &element_hash) -> std::size_t
+{
+    auto seed = cell.elements.size();
+    for (auto const &element : cell.elements)
+    {
+        seed = hash_combine(seed, element_hash(element));
+    }
+    return seed;
+}
+
+/**
+ * @brief Hashes a sequence from the hashes of its cells.
+ */
+template <typename CellT, typename CellHash>
+[[nodiscard]]
+auto hash_cells(std::vector<CellT> const &cells, CellHash const &cell_hash)
+    -> std::size_t
+{
+    auto seed = hash_combine(sequence_seed, cells.size());
+    for (auto const &cell : cells)
+    {
+        seed = hash_combine(seed, cell_hash(cell));
+    }
+    return seed;
+}
+
+/**
+ * @brief Hashes a Cell tree in one traverse() pass, matching hash_cell and hash_cells.
+ *
+ * Keeps one running hash per open cell and Sequence, each folded into its parent
+ * when it is closed.
+ */
+class HashVisitor
+{
+  public:
+    explicit HashVisitor(std::size_t root_seed)
+    {
+        seeds_.push_back(root_seed);
+    }
+
+    [[nodiscard]]
+    auto result() const -> std::size_t
+    {
+        return seeds_.front();
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        seeds_.back() = hash_combine(seeds_.back(), sequence::hash(note));
+    }
+
+    auto enter_sequence(sequence::Sequence const &seq) -> void
+    {
+        seeds_.push_back(hash_combine(sequence_seed, seq.cells.size()));
+    }
+
+    auto exit_sequence(sequence::Sequence const &) -> void
+    {
+        this->close();
+    }
+
+    auto enter_cell(sequence::Cell const &cell) -> void
+    {
+        seeds_.push_back(cell.elements.size());
+    }
+
+    auto exit_cell(sequence::Cell const &) -> void
+    {
+        this->close();
+    }
+
+  private:
+    auto close() -> void
+    {
+        auto const seed = seeds_.back();
+        seeds_.pop_back();
+        seeds_.back() = hash_combine(seeds_.back(), seed);
+    }
+
+  private:
+    sequence::SmallVector<std::size_t, 32> seeds_;
+};
+
+/**
+ * @brief Rebuilds a PersistentCell tree bottom-up in one traverse() pass.
+ *
+ * Mirrors detail::PersistentBuilder for PersistentCell input: each closed Sequence is
+ * replaced by make_node(std::vector<PersistentCell>) -> PersistentSequencePtr, except
+ * nodes for which keep(PersistentSequencePtr const &) -> bool returns true, which are
+ * reused without visiting their cells.
+ */
+template <typename MakeNode, typename Keep>
+class Rebuilder
+{
+  public:
+    Rebuilder(float root_weight, MakeNode make_node, Keep keep)
+        : make_node_{std::move(make_node)}, keep_{std::move(keep)}
+    {
+        cells_.push_back(
+            sequence::PersistentCell{.elements = {}, .weight = root_weight});
+    }
+
+    [[nodiscard]]
+    auto result() && -> sequence::PersistentCell
+    {
+        return std::move(cells_.front());
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        cells_.back().elements.emplace_back(note);
+    }
+
+    auto enter_sequence(sequence::PersistentSequencePtr const &seq) -> bool
+    {
+        if (keep_(seq))
+        {
+            cells_.back().elements.emplace_back(seq);
+            return false;
+        }
+        sequences_.emplace_back().reserve(seq->cells.size());
+        return true;
+    }
+
+    auto exit_sequence(sequence::PersistentSequencePtr const &) -> void
+    {
+        auto node = make_node_(std::move(sequences_.back()));
+        sequences_.pop_back();
+        cells_.back().elements.emplace_back(std::move(node));
+    }
+
+    auto enter_cell(sequence::PersistentCell const &cell) -> void
+    {
+        cells_.push_back(
+            sequence::PersistentCell{.elements = {}, .weight = cell.weight});
+        cells_.back().elements.reserve(cell.elements.size());
+    }
+
+    auto exit_cell(sequence::PersistentCell const &) -> void
+    {
+        sequences_.back().push_back(std::move(cells_.back()));
+        cells_.pop_back();
+    }
+
+  private:
+    MakeNode make_node_;
+    Keep keep_;
+    sequence::SmallVector<sequence::PersistentCell, 16> cells_;
+    sequence::SmallVector<std::vector<sequence::PersistentCell>, 16> sequences_;
+};
+
+/**
+ * @brief Equality for interning, where nested sequences must be the same node.
+ */
+[[nodiscard]]
+auto same_node(std::vector<sequence::PersistentCell> const &lhs,
+               std::vector<sequence::PersistentCell> const &rhs) -> bool
+{
+    return std::ranges::equal(lhs, rhs, [](auto const &a, auto const &b) {
+        return std::fabs(a.weight - b.weight) < 0.0001f &&
+               std::ranges::equal(a.elements, b.elements);
+    });
+}
+
+} // namespace
+
+namespace sequence
+{
+
+auto hash(Note const &note) -> std::size_t
+{
+    return hash_combine(note_seed, std::hash<int>{}(note.pitch));
+}
+
+auto hash(MusicElement const &element) -> std::size_t
+{
+    if (auto const *note = std::get_if<Note>(&element))
+    {
+        return hash(*note);
+    }
+    return hash(std::get<Sequence>(element));
+}
+
+auto hash(Cell const &cell) -> std::size_t
+{
+    auto visitor = HashVisitor{cell.elements.size()};
+    traverse(cell, visitor);
+    return visitor.result();
+}
+
+auto hash(Sequence const &seq) -> std::size_t
+{
+    return hash_cells(seq.cells, [](Cell const &c) { return hash(c); });
+}
+
+auto hash(PersistentCell const &cell) -> std::size_t
+{
+    return hash_cell(cell, [](PersistentElement const &element) {
+        return std::visit(
+            utility::overload{
+                [](Note const &note) { return hash(note); },
+                [](PersistentSequencePtr const &seq) { return seq->structural_hash(); },
+            },
+            element);
+    });
+}
+
+auto hash(PersistentSequence const &seq) -> std::size_t
+{
+    return hash_cells(seq.cells, [](PersistentCell const &c) { return hash(c); });
+}
+
+auto Interner::intern(Cell const &cell) -> PersistentCell
+{
+    auto builder = detail::PersistentBuilder{
+        cell.weight, [this](std::vector<PersistentCell> cells) {
+            return this->find_or_insert(std::move(cells));
+        }};
+    traverse(cell, builder);
+    return std::move(builder).result();
+}
+
+auto Interner::intern(PersistentCell const &cell) -> PersistentCell
+{
+    auto rebuilder = Rebuilder{
+        cell.weight,
+        [this](std::vector<PersistentCell> cells) {
+            return this->find_or_insert(std::move(cells));
+        },
+        [this](PersistentSequencePtr const &seq) {
+            return nodes_.contains(seq.get());
+        }};
+    traverse(cell, rebuilder);
+    return std::move(rebuilder).result();
+}
+
+auto Interner::find_or_insert(std::vector<PersistentCell> cells)
+    -> PersistentSequencePtr
+{
+    auto const key =
+        hash_cells(cells, [](PersistentCell const &c) { return hash(c); });
+
+    auto &bucket = buckets_[key];
+    for (auto const &candidate : bucket)
+    {
+        if (same_node(candidate->cells, cells))
+        {
+            return candidate;
+        }
+    }
+
+    auto node = make_persistent_sequence(std::move(cells));
+    nodes_.insert(node.get());
+    bucket.push_back(node);
+    return node;
+}
+
+} // namespace sequence
@@ -0,0 +1,315 @@
+#include <sequence/incremental.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/traverse.hpp>
+
+namespace sequence::midi
+{
+
+/**
+ * @brief The notes a node renders to, relative to the start of its span.
+ *
+ * Holds the notes of the node's own cells, and splices in the fragments of its nested
+ * nodes by reference, each at the position among the own notes where flatten_to_midi
+ * would emit it.
+ */
+struct IncrementalRenderer::Fragment
+{
+    struct Splice
+    {
+        std::size_t position; // Inserted before notes[position].
+        SampleTime offset;    // Start of the nested span, relative to this one.
+        FragmentPtr fragment;
+    };
+
+    std::vector<TimedMidiNote> notes;
+    std::vector<Splice> splices; // In order of position.
+};
+
+namespace
+{
+
+/**
+ * @brief Appends the notes of \p root, shifted by \p offset, to \p out.
+ *
+ * Walks the spliced fragments with an explicit stack, so deeply nested renders are
+ * expanded without recursion. Each note is copied once.
+ */
+template <typename Fragment>
+auto append_fragment(Fragment const &root,
+                     SampleTime offset,
+                     std::vector<TimedMidiNote> &out) -> void
+{
+    struct Frame
+    {
+        Fragment const *fragment;
+        SampleTime offset;
+        std::size_t note;   // Index of the next own note.
+        std::size_t splice; // Index of the next splice.
+    };
+
+    auto stack = SmallVector<Frame, 32>{{.fragment = &root,
+                                         .offset = offset,
+                                         .note = 0,
+                                         .splice = 0}};
+    while (!stack.empty())
+    {
+        auto &frame = stack.back();
+        auto const &fragment = *frame.fragment;
+        auto const has_splice = frame.splice < fragment.splices.size();
+        auto const stop = has_splice ? fragment.splices[frame.splice].position
+                                     : fragment.notes.size();
+
+        for (; frame.note < stop; ++frame.note)
+        {
+            auto note = fragment.notes[frame.note];
+            note.begin += frame.offset;
+            note.end += frame.offset;
+            out.push_back(note);
+        }
+
+        if (!has_splice)
+        {
+            stack.pop_back();
+            continue;
+        }
+        auto const &splice = fragment.splices[frame.splice++];
+        auto const child = Frame{.fragment = splice.fragment.get(),
+                                 .offset = frame.offset + splice.offset,
+                                 .note = 0,
+                                 .splice = 0};
+        stack.push_back(child); // Invalidates frame.
+    }
+}
+
+} // namespace
+
+/**
+ * @brief Renders a PersistentCell tree for traverse(), skipping the nested sequences
+ * the cache already holds at their span length.
+ *
+ * Builds one Fragment per rendered sequence, plus one for the root cell. Notes go into
+ * the fragment of the innermost open sequence, and each nested sequence, rendered or
+ * found in the cache, is spliced into its parent's fragment, so no level copies the
+ * notes of the levels below it.
+ */
+class IncrementalRenderer::Visitor
+{
+  public:
+    Visitor(IncrementalRenderer &renderer, SampleSpan root) : renderer_{renderer}
+    {
+        spans_.push_back(root);
+        open_.push_back(Open{
+            .node = nullptr, .span = root, .fragment = std::make_shared<Fragment>()});
+    }
+
+    /**
+     * @brief Returns the fragment of the root cell, relative to the root span.
+     */
+    [[nodiscard]]
+    auto result() const -> Fragment const &
+    {
+        return *open_.front().fragment;
+    }
+
+    auto note(Note const &note) -> void
+    {
+        auto const &pitch_map = renderer_.pitch_map_;
+        auto const &open = open_.back();
+        auto timed = create_timed_midi_note(note, spans_.back(), pitch_map(note.pitch));
+        timed.begin -= open.span.offset;
+        timed.end -= open.span.offset;
+        open.fragment->notes.push_back(timed);
+    }
+
+    auto enter_sequence(PersistentSequencePtr const &seq) -> bool
+    {
+        auto const span = spans_.back();
+        if (auto fragment = renderer_.find(seq, span.count))
+        {
+            this->splice(span, std::move(fragment));
+            return false;
+        }
+
+        ++renderer_.nodes_rendered_;
+        auto total_weight = 0.;
+        for (auto const &cell : seq->cells)
+        {
+            total_weight += static_cast<double>(cell.weight);
+        }
+        subdivisions_.emplace_back(span, total_weight, seq->cells.size());
+        open_.push_back(
+            Open{.node = seq, .span = span, .fragment = std::make_shared<Fragment>()});
+        return true;
+    }
+
+    auto exit_sequence(PersistentSequencePtr const &) -> void
+    {
+        subdivisions_.pop_back();
+        auto done = std::move(open_.back());
+        open_.pop_back();
+
+        auto fragment = FragmentPtr{std::move(done.fragment)};
+        renderer_.store(done.node, done.span.count, fragment);
+        this->splice(done.span, std::move(fragment));
+    }
+
+    auto enter_cell(PersistentCell const &cell) -> void
+    {
+        spans_.push_back(subdivisions_.back().next(cell.weight));
+    }
+
+    auto exit_cell(PersistentCell const &) -> void
+    {
+        spans_.pop_back();
+    }
+
+  private:
+    /**
+     * @brief A sequence being rendered, or the root cell, and its fragment so far.
+     */
+    struct Open
+    {
+        PersistentSequencePtr node;
+        SampleSpan span;
+        std::shared_ptr<Fragment> fragment;
+    };
+
+    /**
+     * @brief Splices \p fragment, rendered over \p span, into the innermost open
+     * fragment after the notes it holds so far.
+     */
+    auto splice(SampleSpan span, FragmentPtr fragment) -> void
+    {
+        auto &parent = *open_.back().fragment;
+        parent.splices.push_back(Fragment::Splice{
+            .position = parent.notes.size(),
+            .offset = span.offset - open_.back().span.offset,
+            .fragment = std::move(fragment),
+        });
+    }
+
+  private:
+    IncrementalRenderer &renderer_;
+    std::vector<Open> open_;
+    SmallVector<Subdivision, 32> subdivisions_;
+    SmallVector<SampleSpan, 32> spans_;
+};
+
+IncrementalRenderer::IncrementalRenderer(PitchMap pitch_map)
+    : pitch_map_{std::move(pitch_map)}
+{
+}
+
+auto IncrementalRenderer::render(PersistentCell const &root,
+                                 SampleTime sample_offset,
+                                 SampleTime sample_count)
+    -> std::vector<TimedMidiNote> const &
+{
+    notes_.clear();
+    touched_.clear();
+    ++generation_;
+    nodes_rendered_ = 0;
+
+    auto visitor =
+        Visitor{*this, SampleSpan{.offset = sample_offset, .count = sample_count}};
+    traverse(root, visitor);
+    append_fragment(visitor.result(), sample_offset, notes_);
+
+    this->evict_stale();
+    if (cache_.size() >= prune_size_)
+    {
+        this->prune();
+        prune_size_ = std::max(min_prune_size, 2 * cache_.size());
+    }
+
+    return notes_;
+}
+
+auto IncrementalRenderer::render_count() const -> std::size_t
+{
+    auto count = std::size_t{0};
+    for (auto const &[node, entry] : cache_)
+    {
+        count += entry.renders.size();
+    }
+    return count;
+}
+
+auto IncrementalRenderer::find(PersistentSequencePtr const &seq, SampleTime length)
+    -> FragmentPtr
+{
+    auto const found = cache_.find(seq.get());
+    if (found == cache_.end())
+    {
+        return nullptr;
+    }
+    auto &renders = found->second.renders;
+    auto const render = std::ranges::find(renders, length, &Render::length);
+    if (render == renders.end())
+    {
+        return nullptr;
+    }
+    this->touch(found->second, *render);
+    return render->fragment;
+}
+
+auto IncrementalRenderer::store(PersistentSequencePtr const &seq,
+                                SampleTime length,
+                                FragmentPtr fragment) -> void
+{
+    auto &entry = cache_[seq.get()];
+    entry.node = seq;
+    entry.renders.push_back(
+        Render{.length = length, .fragment = std::move(fragment), .generation = 0});
+    this->touch(entry, entry.renders.back());
+}
+
+auto IncrementalRenderer::touch(Entry &entry, Render &render) -> void
+{
+    auto const touched = std::ranges::any_of(entry.renders, [&](Render const &r) {
+        return r.generation == generation_;
+    });
+    if (!touched)
+    {
+        touched_.push_back(entry.node.get());
+    }
+    render.generation = generation_;
+}
+
+auto IncrementalRenderer::evict_stale() -> void
+{
+    // Only entries this render reached may have changed length, the others keep theirs
+    // for the trees that still hold them.
+    for (auto const *node : touched_)
+    {
+        std::erase_if(cache_.at(node).renders, [&](Render const &render) {
+            return render.generation != generation_;
+        });
+    }
+}
+
+auto IncrementalRenderer::prune() -> void
+{
+    // Releasing a node can leave its children held only by the cache, so repeat until
+    // nothing more is released.
+    auto released = std::size_t{0};
+    do
+    {
+        released = std::erase_if(cache_, [](auto const &item) {
+            return item.second.node.use_count() == 1;
+        });
+    } while (released > 0);
+}
+
+} // namespace sequence::midi
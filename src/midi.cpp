@@ -1,38 +1,37 @@
 #include <sequence/midi.hpp>
 
 #include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
-#include <iterator>
-#include <numeric>
+#include <exception>
+#include <functional>
+#include <initializer_list>
+#include <limits>
+#include <mutex>
+#include <span>
 #include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include <sequence/lazy_midi.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/traverse.hpp>
 #include <sequence/utility.hpp>
 
 namespace
 {
 
-/**
- * @brief A MIDI note to represent any microtone using pitch bend.
- *
- * The note is a number from 0 to 127, where 60 is middle C. The pitch bend
- * is a number from 0 to 16383, where 8192 is the center position. This assumes the
- * pitch bend is set to cover 2 semitones, one in each direction.
- */
-struct MicrotonalNote
-{
-    std::uint8_t note = 60;
-    std::uint16_t pitch_bend = 8192;
-
-    auto operator==(MicrotonalNote const &) const -> bool = default;
-    auto operator!=(MicrotonalNote const &) const -> bool = default;
-};
+using sequence::midi::create_timed_midi_note;
+using sequence::midi::MicrotonalNote;
 
 /**
- * @brief Creates a MIDI note from a Note, Tuning and base fractional note.
+ * @brief Returns the fractional MIDI note of a pitch, clamped to [0, 127].
  *
  * @param pitch The pitch value to use, this is the value from Note.pitch, not the midi
  * note number.
@@ -40,26 +39,14 @@ struct MicrotonalNote
  * @param tuning_base The base note of the tuning, as a floating point value. This is a
  * MIDI note value but allows for fractional notes that correspond to any value
  * in between MIDI notes.
- * @param pb_range The amount of note pitch bend range expected by the midi receiver.
- * @return MicrotonalNote
- * @throws std::invalid_argument if the tuning is empty or if \p pb_range is not
- * greater than zero.
+ *
+ * The arguments must already be validated, see validate_render_arguments.
  */
 [[nodiscard]]
-auto create_midi_note(int pitch,
-                      sequence::Tuning const &tuning,
-                      float tuning_base,
-                      float pb_range) -> MicrotonalNote
+auto fractional_midi_note(int pitch,
+                          sequence::Tuning const &tuning,
+                          float tuning_base) noexcept -> float
 {
-    if (tuning.intervals.empty())
-    {
-        throw std::invalid_argument("Tuning must not be empty");
-    }
-    if (pb_range <= 0.f)
-    {
-        throw std::invalid_argument("pb_range must be greater than 0");
-    }
-
     auto const fractional_note = tuning_base + [&] {
         constexpr auto semitone_cents = 100.f;
         auto const length = (int)tuning.intervals.size();
@@ -81,57 +68,772 @@ auto create_midi_note(int pitch,
         return (octave_offset + interval_offset) / semitone_cents;
     }();
 
+    return std::clamp(fractional_note, 0.f, 127.f);
+}
+
+/**
+ * @brief Creates a MIDI note from a Note, Tuning and base fractional note.
+ *
+ * Quantizes fractional_midi_note() to a MIDI note and a 14-bit pitch bend.
+ *
+ * @param pb_range The amount of note pitch bend range expected by the midi receiver.
+ * @return MicrotonalNote
+ */
+[[nodiscard]]
+auto create_midi_note(int pitch,
+                      sequence::Tuning const &tuning,
+                      float tuning_base,
+                      float pb_range) noexcept -> MicrotonalNote
+{
     auto integral = 0.f;
     auto const fractional =
-        std::modf(std::clamp(fractional_note, 0.f, 127.f), &integral);
+        std::modf(fractional_midi_note(pitch, tuning, tuning_base), &integral);
     return MicrotonalNote{
         static_cast<std::uint8_t>(integral),
         static_cast<std::uint16_t>(8'192 + (fractional * 8'192.f / pb_range))};
 }
 
 /**
- * @brief Creates a timed MIDI note from a Note and an allocated sample span.
+ * @brief Returns the fractional MIDI note of pitch 0, given its frequency.
+ */
+[[nodiscard]]
+auto base_midi_note(float base_frequency) -> float
+{
+    constexpr auto a4 = 69;       // MIDI note number for A4
+    constexpr auto a4_hz = 440.f; // Frequency of A4
+
+    return 12.f * std::log2(base_frequency / a4_hz) + static_cast<float>(a4);
+}
+
+/**
+ * @brief Maps pitches with create_midi_note directly, without a lookup table.
  *
- * The returned note uses \p sample_offset and \p sample_count as the containing
- * timespan for the note, then applies Note.delay and Note.gate within that span to
- * calculate the final begin and end sample positions.
+ * Used by the overloads that take a Tuning, where building a PitchMap would cost more
+ * than it saves for short renders.
+ */
+class DirectPitch
+{
+  public:
+    DirectPitch(sequence::Tuning const &tuning, float base_frequency, float pb_range)
+        : tuning_{tuning}, base_note_{base_midi_note(base_frequency)},
+          pb_range_{pb_range}
+    {
+    }
+
+    [[nodiscard]]
+    auto operator()(int pitch) const noexcept -> MicrotonalNote
+    {
+        return create_midi_note(pitch, tuning_, base_note_, pb_range_);
+    }
+
+  private:
+    sequence::Tuning const &tuning_;
+    float base_note_;
+    float pb_range_;
+};
+
+/**
+ * @brief Throws if the arguments shared by every flatten_to_midi overload are invalid.
  *
  * @throws std::invalid_argument if \p tuning is empty, if \p base_frequency is not
  * greater than zero, or if \p pb_range is not greater than zero.
  */
-[[nodiscard]]
-auto create_timed_midi_note(sequence::Note const &note,
-                            std::uint32_t sample_offset,
-                            std::uint32_t sample_count,
-                            sequence::Tuning const &tuning,
-                            float base_frequency,
-                            float pb_range) -> sequence::midi::TimedMidiNote
+auto validate_render_arguments(sequence::Tuning const &tuning,
+                               float base_frequency,
+                               float pb_range) -> void
 {
+    if (tuning.intervals.empty())
+    {
+        throw std::invalid_argument("Tuning must not be empty");
+    }
     if (base_frequency <= 0.f)
     {
         throw std::invalid_argument("base_frequency must be greater than 0");
     }
+    if (pb_range <= 0.f)
+    {
+        throw std::invalid_argument("pb_range must be greater than 0");
+    }
+}
 
-    constexpr auto a4 = 69;       // MIDI note number for A4
-    constexpr auto a4_hz = 440.f; // Frequency of A4
+/**
+ * @brief Accepts every note, for renders of the whole span.
+ */
+struct Unbounded
+{
+    [[nodiscard]]
+    constexpr auto overlaps(sequence::SampleTime, sequence::SampleTime) const -> bool
+    {
+        return true;
+    }
 
-    auto const base_midi_note =
-        12.f * std::log2(base_frequency / a4_hz) + static_cast<float>(a4);
-    auto const [midi_note, pitch_bend] =
-        create_midi_note(note.pitch, tuning, base_midi_note, pb_range);
+    [[nodiscard]]
+    constexpr auto touches(sequence::SampleTime, sequence::SampleTime) const -> bool
+    {
+        return true;
+    }
+};
 
-    auto const delay =
-        static_cast<std::uint32_t>(static_cast<float>(sample_count) * note.delay);
-    auto const note_samples = static_cast<std::uint32_t>(
-        (static_cast<float>(sample_count) - static_cast<float>(delay)) * note.gate);
+/**
+ * @brief Accepts the notes that intersect [begin, end).
+ */
+struct SampleWindow
+{
+    sequence::SampleTime begin;
+    sequence::SampleTime end;
 
-    return sequence::midi::TimedMidiNote{
-        .begin = sample_offset + delay,
-        .end = sample_offset + delay + note_samples,
-        .note = midi_note,
-        .velocity = static_cast<std::uint8_t>(note.velocity * 127),
-        .pitch_bend = pitch_bend,
+    /**
+     * @brief Returns true if [first, last) intersects the window.
+     *
+     * Zero length spans intersect if first is inside the window, so notes with a gate
+     * of zero are reported in the block where they start.
+     */
+    [[nodiscard]]
+    constexpr auto overlaps(sequence::SampleTime first,
+                            sequence::SampleTime last) const -> bool
+    {
+        return begin < end && first < end &&
+               (begin < last || (first == last && begin <= first));
+    }
+
+    /**
+     * @brief Returns true if the closed span [first, last] intersects the window.
+     *
+     * A cell's notes lie within its closed span: a note with a delay of 1 begins and
+     * ends on the cell's last sample, and overlaps() reports it in the block that
+     * starts there.
+     */
+    [[nodiscard]]
+    constexpr auto touches(sequence::SampleTime first,
+                           sequence::SampleTime last) const -> bool
+    {
+        return begin < end && first < end && begin <= last;
+    }
+};
+
+/**
+ * @brief Renders the notes of a Cell tree into timed MIDI notes, for traverse().
+ *
+ * Keeps one Subdivision per open Sequence and one span per open cell, so the span of
+ * each note is the span of the innermost cell that holds it. Pitches are mapped with
+ * \p pitch, invoked as pitch(int) -> MicrotonalNote, and each rendered note is passed
+ * to \p sink, invoked as sink(TimedMidiNote const &).
+ *
+ * Only notes that \p window overlaps are passed to \p sink. Each note lies within the
+ * closed span of its cell, so a cell whose closed span \p window does not touch is
+ * pruned with all of its descendants; its siblings' spans are still computed, as each
+ * depends on the weights before it.
+ *
+ * Sequences whose total child weight is not greater than zero cannot be subdivided.
+ * They are skipped and recorded in status(), rather than thrown, so that rendering is
+ * exception-free once the arguments are validated. Trees up to 32 levels deep are
+ * rendered without allocating.
+ */
+template <typename Sink, typename Pitch, typename Window>
+class MidiRenderVisitor
+{
+  public:
+    MidiRenderVisitor(Sink &sink,
+                      sequence::SampleSpan root,
+                      Pitch const &pitch,
+                      Window const &window)
+        : sink_{sink}, pitch_{pitch}, window_{window}
+    {
+        spans_.push_back(root);
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        auto const midi_note =
+            create_timed_midi_note(note, spans_.back(), pitch_(note.pitch));
+        if (window_.overlaps(midi_note.begin, midi_note.end))
+        {
+            sink_(midi_note);
+        }
+    }
+
+    [[nodiscard]]
+    auto status() const -> sequence::midi::RenderStatus
+    {
+        return status_;
+    }
+
+    auto enter_sequence(sequence::Sequence const &seq) -> bool
+    {
+        auto total_weight = 0.;
+        for (auto const &cell : seq.cells)
+        {
+            total_weight += static_cast<double>(cell.weight);
+        }
+        if (!(total_weight > 0.))
+        {
+            status_ = sequence::midi::RenderStatus::invalid_weight;
+            return false;
+        }
+        subdivisions_.emplace_back(spans_.back(), total_weight, seq.cells.size());
+        return true;
+    }
+
+    auto exit_sequence(sequence::Sequence const &) -> void
+    {
+        subdivisions_.pop_back();
+    }
+
+    auto enter_cell(sequence::Cell const &cell) -> bool
+    {
+        auto const span = subdivisions_.back().next(cell.weight);
+        if (!window_.touches(span.offset, span.offset + span.count))
+        {
+            return false;
+        }
+        spans_.push_back(span);
+        return true;
+    }
+
+    auto exit_cell(sequence::Cell const &) -> void
+    {
+        spans_.pop_back();
+    }
+
+  private:
+    Sink &sink_;
+    Pitch const &pitch_;
+    Window const &window_;
+    sequence::midi::RenderStatus status_ = sequence::midi::RenderStatus::ok;
+    sequence::SmallVector<sequence::Subdivision, 32> subdivisions_;
+    sequence::SmallVector<sequence::SampleSpan, 32> spans_;
+};
+
+/**
+ * @brief Renders \p elements into \p sink, see MidiRenderVisitor.
+ */
+template <typename Pitch, typename Sink, typename Window>
+auto render(std::span<sequence::MusicElement const> elements,
+            sequence::SampleSpan span,
+            Pitch const &pitch,
+            Sink &sink,
+            Window const &window) -> sequence::midi::RenderStatus
+{
+    auto visitor = MidiRenderVisitor{sink, span, pitch, window};
+    sequence::traverse(elements, visitor);
+    return visitor.status();
+}
+
+/**
+ * @brief Appends the notes of \p elements that \p window overlaps to \p out.
+ */
+template <typename Pitch, typename Window = Unbounded>
+auto render_into(std::span<sequence::MusicElement const> elements,
+                 sequence::SampleSpan span,
+                 Pitch const &pitch,
+                 std::vector<sequence::midi::TimedMidiNote> &out,
+                 Window const &window = {}) -> sequence::midi::RenderStatus
+{
+    auto sink = [&out](sequence::midi::TimedMidiNote const &note) {
+        out.push_back(note);
+    };
+    return render(elements, span, pitch, sink, window);
+}
+
+/**
+ * @brief Writes the notes of \p elements that \p window overlaps to \p out,
+ * counting how many there are.
+ */
+template <typename Pitch, typename Window = Unbounded>
+auto render_into(std::span<sequence::MusicElement const> elements,
+                 sequence::SampleSpan span,
+                 Pitch const &pitch,
+                 std::span<sequence::midi::TimedMidiNote> out,
+                 Window const &window = {}) -> sequence::midi::RenderResult
+{
+    auto count = std::size_t{0};
+    auto sink = [&](sequence::midi::TimedMidiNote const &note) {
+        if (count < out.size())
+        {
+            out[count] = note;
+        }
+        ++count;
+    };
+    auto const status = render(elements, span, pitch, sink, window);
+    return {.note_count = count, .status = status};
+}
+
+/**
+ * @brief Throws for the failures reported by a RenderStatus.
+ *
+ * @throws std::invalid_argument if \p status is not RenderStatus::ok.
+ */
+auto throw_if_failed(sequence::midi::RenderStatus status) -> void
+{
+    if (status == sequence::midi::RenderStatus::invalid_weight)
+    {
+        throw std::invalid_argument("sequence total weight must be greater than 0");
+    }
+}
+
+/**
+ * @brief Throws for the failures reported by \p result, or returns its note count.
+ */
+auto throw_if_failed(sequence::midi::RenderResult result) -> std::size_t
+{
+    throw_if_failed(result.status);
+    return result.note_count;
+}
+
+/**
+ * @brief Appends the pitch bend, note-on and note-off events of \p note to \p out.
+ */
+auto append_events(sequence::midi::TimedMidiNote const &note,
+                   std::vector<sequence::midi::MidiEvent> &out) -> void
+{
+    using Kind = sequence::midi::MidiEvent::Kind;
+
+    if (note.begin == note.end)
+    {
+        return;
+    }
+    auto event = sequence::midi::MidiEvent{
+        .time = note.begin,
+        .kind = Kind::pitch_bend,
+        .note = note.note,
+        .velocity = note.velocity,
+        .pitch_bend = note.pitch_bend,
+        .channel = note.channel,
+    };
+    out.push_back(event);
+    event.kind = Kind::note_on;
+    out.push_back(event);
+    event.time = note.end;
+    event.kind = Kind::note_off;
+    event.velocity = 0;
+    out.push_back(event);
+}
+
+/**
+ * @brief Returns the key event streams are sorted by: time, then note-offs first.
+ */
+[[nodiscard]]
+auto event_order(sequence::midi::MidiEvent const &event)
+    -> std::pair<sequence::SampleTime, bool>
+{
+    return {event.time, event.kind != sequence::midi::MidiEvent::Kind::note_off};
+}
+
+/**
+ * @brief Sorts the events of \p run by event_order(), keeping the order of events
+ * that tie.
+ *
+ * The notes of a cell mostly arrive in time order, so an already sorted run is only
+ * checked. O(n log n) otherwise.
+ */
+auto sort_events(std::vector<sequence::midi::MidiEvent> &run) -> void
+{
+    auto const earlier = [](auto const &a, auto const &b) {
+        return event_order(a) < event_order(b);
+    };
+    if (!std::is_sorted(run.begin(), run.end(), earlier))
+    {
+        std::stable_sort(run.begin(), run.end(), earlier);
+    }
+}
+
+/**
+ * @brief Merges the time-sorted \p runs into one time-sorted stream, appended to
+ * \p out.
+ *
+ * At equal times note-offs come first, then the remaining events in run order, so a
+ * note's pitch bend and note-on stay together. O(n log k) for n events in k runs.
+ */
+auto merge_runs(std::span<std::vector<sequence::midi::MidiEvent> const> runs,
+                std::vector<sequence::midi::MidiEvent> &out) -> void
+{
+    if (runs.size() == 1)
+    {
+        out.insert(out.end(), runs.front().begin(), runs.front().end());
+        return;
+    }
+
+    struct Cursor
+    {
+        std::size_t run;
+        std::size_t index;
+    };
+
+    // std::push_heap keeps the largest element at the front, so this orders cursors
+    // latest first.
+    auto const later = [&](Cursor const &a, Cursor const &b) {
+        return std::pair{event_order(runs[a.run][a.index]), a.run} >
+               std::pair{event_order(runs[b.run][b.index]), b.run};
+    };
+
+    auto heap = std::vector<Cursor>{};
+    heap.reserve(runs.size());
+    for (auto i = std::size_t{0}; i < runs.size(); ++i)
+    {
+        if (!runs[i].empty())
+        {
+            heap.push_back({i, 0});
+        }
+    }
+    std::ranges::make_heap(heap, later);
+
+    while (!heap.empty())
+    {
+        std::ranges::pop_heap(heap, later);
+        auto &cursor = heap.back();
+        out.push_back(runs[cursor.run][cursor.index]);
+        if (++cursor.index < runs[cursor.run].size())
+        {
+            std::ranges::push_heap(heap, later);
+        }
+        else
+        {
+            heap.pop_back();
+        }
+    }
+}
+
+/**
+ * @brief Renders a Cell tree into a time-sorted MidiEvent stream, for traverse().
+ *
+ * Places notes with MidiRenderVisitor, then relies on the structure of the tree
+ * instead of sorting: the cells of a Sequence occupy consecutive spans, so their
+ * sorted streams are concatenated, and the elements of a cell are simultaneous, so
+ * their sorted streams are merged. Consecutive notes of a cell share one run, which
+ * is sorted once when a nested Sequence or the end of the cell closes it, so only the
+ * runs of nested Sequences are merged with it.
+ */
+template <typename Pitch>
+class MidiEventVisitor
+{
+    using MidiEvent = sequence::midi::MidiEvent;
+    using Runs = std::vector<std::vector<MidiEvent>>;
+
+    struct Sink
+    {
+        MidiEventVisitor *visitor;
+
+        auto operator()(sequence::midi::TimedMidiNote const &note) const -> void
+        {
+            auto &runs = visitor->cells_.back();
+            if (!visitor->notes_run_)
+            {
+                runs.emplace_back();
+                visitor->notes_run_ = true;
+            }
+            append_events(note, runs.back());
+        }
+    };
+
+  public:
+    MidiEventVisitor(sequence::SampleSpan root, Pitch const &pitch)
+        : sink_{this}, render_{sink_, root, pitch, Unbounded{}}
+    {
+        cells_.emplace_back();
+    }
+
+    MidiEventVisitor(MidiEventVisitor const &) = delete;
+    auto operator=(MidiEventVisitor const &) -> MidiEventVisitor & = delete;
+
+    [[nodiscard]]
+    auto status() const -> sequence::midi::RenderStatus
+    {
+        return render_.status();
+    }
+
+    /**
+     * @brief Appends the merged stream of the root elements to \p out.
+     */
+    auto finish(std::vector<MidiEvent> &out) -> void
+    {
+        this->close_notes_run();
+        merge_runs(cells_.front(), out);
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        render_.note(note);
+    }
+
+    auto enter_sequence(sequence::Sequence const &seq) -> bool
+    {
+        this->close_notes_run();
+        if (!render_.enter_sequence(seq))
+        {
+            return false;
+        }
+        sequences_.emplace_back();
+        return true;
+    }
+
+    auto exit_sequence(sequence::Sequence const &seq) -> void
+    {
+        render_.exit_sequence(seq);
+        cells_.back().push_back(std::move(sequences_.back()));
+        sequences_.pop_back();
+    }
+
+    auto enter_cell(sequence::Cell const &cell) -> void
+    {
+        (void)render_.enter_cell(cell);
+        cells_.emplace_back();
+    }
+
+    auto exit_cell(sequence::Cell const &cell) -> void
+    {
+        render_.exit_cell(cell);
+        this->close_notes_run();
+        merge_runs(cells_.back(), sequences_.back());
+        cells_.pop_back();
+    }
+
+  private:
+    /**
+     * @brief Sorts the notes run of the open cell, if it has one, so that later notes
+     * start a new run.
+     */
+    auto close_notes_run() -> void
+    {
+        if (notes_run_)
+        {
+            sort_events(cells_.back().back());
+            notes_run_ = false;
+        }
+    }
+
+  private:
+    Sink sink_;
+    MidiRenderVisitor<Sink const, Pitch, Unbounded> render_;
+    sequence::SmallVector<Runs, 32> cells_;                   // Runs per open cell.
+    sequence::SmallVector<std::vector<MidiEvent>, 32> sequences_; // Per open Sequence.
+    bool notes_run_ = false; // True if the last run of the open cell is unsorted notes.
+};
+
+/**
+ * @brief Renders \p elements into a time-sorted event stream appended to \p out.
+ */
+template <typename Pitch>
+auto render_events(std::span<sequence::MusicElement const> elements,
+                   sequence::SampleSpan span,
+                   Pitch const &pitch,
+                   std::vector<sequence::midi::MidiEvent> &out)
+    -> sequence::midi::RenderStatus
+{
+    auto visitor = MidiEventVisitor<Pitch>{span, pitch};
+    sequence::traverse(elements, visitor);
+    visitor.finish(out);
+    return visitor.status();
+}
+
+/**
+ * @brief The frontier of a lazy render, see lazy_flatten_to_midi().
+ *
+ * Holds rendered notes that are not yet yielded, and cells that are not yet expanded.
+ * Each entry is keyed by the earliest sample it can yield: a note's begin, or the
+ * start of a cell's span, which no note below the cell can begin before. Expanding
+ * entries in key order therefore yields notes in order of begin, while only the
+ * cells on the current path and their pending siblings are held in memory.
+ */
+class LazyFrontier
+{
+  public:
+    /**
+     * @brief The cell at seq.cells[index], whose span is \p span.
+     *
+     * \p rest is the Subdivision of the parent span after \p span was taken from it,
+     * so the next sibling is only placed once this one is expanded.
+     */
+    struct PendingCell
+    {
+        sequence::Sequence const *seq;
+        std::size_t index;
+        sequence::SampleSpan span;
+        sequence::Subdivision rest;
     };
+
+    using Item = std::variant<sequence::midi::TimedMidiNote, PendingCell>;
+
+    [[nodiscard]]
+    auto empty() const -> bool
+    {
+        return heap_.empty();
+    }
+
+    auto push(Item item) -> void
+    {
+        auto const key = std::visit(
+            sequence::utility::overload{
+                [](sequence::midi::TimedMidiNote const &note) { return note.begin; },
+                [](PendingCell const &cell) { return cell.span.offset; },
+            },
+            item);
+        heap_.push_back(Entry{key, counter_++, std::move(item)});
+        std::ranges::push_heap(heap_, std::greater{});
+    }
+
+    [[nodiscard]]
+    auto pop() -> Item
+    {
+        std::ranges::pop_heap(heap_, std::greater{});
+        auto item = std::move(heap_.back().item);
+        heap_.pop_back();
+        return item;
+    }
+
+    /**
+     * @brief Pushes the first cell of \p seq, which spans \p span.
+     *
+     * @throws std::invalid_argument if the total weight of \p seq is not greater than
+     * zero.
+     */
+    auto push_sequence(sequence::Sequence const &seq, sequence::SampleSpan span) -> void
+    {
+        auto total_weight = 0.;
+        for (auto const &cell : seq.cells)
+        {
+            total_weight += static_cast<double>(cell.weight);
+        }
+        auto subdivision = sequence::Subdivision{span, total_weight, seq.cells.size()};
+        this->push_cell(seq, 0, subdivision);
+    }
+
+    /**
+     * @brief Pushes seq.cells[index], taking its span from \p subdivision.
+     */
+    auto push_cell(sequence::Sequence const &seq,
+                   std::size_t index,
+                   sequence::Subdivision subdivision) -> void
+    {
+        auto const span = subdivision.next(seq.cells[index].weight);
+        this->push(PendingCell{&seq, index, span, subdivision});
+    }
+
+  private:
+    struct Entry
+    {
+        sequence::SampleTime key;
+        std::uint64_t order; // Insertion order, breaks ties deterministically.
+        Item item;
+
+        auto operator>(Entry const &other) const -> bool
+        {
+            return std::tie(key, order) > std::tie(other.key, other.order);
+        }
+    };
+
+    std::vector<Entry> heap_;
+    std::uint64_t counter_ = 0;
+};
+
+/**
+ * @brief Runs \p task(i) for every i in [0, count) on up to \p thread_count threads.
+ *
+ * Tasks are handed out one at a time, so threads that finish early pick up the
+ * remaining work. The calling thread works too.
+ *
+ * @throws The first exception thrown by a task, after every thread has finished.
+ */
+template <typename Task>
+auto run_parallel(std::size_t count, std::size_t thread_count, Task const &task) -> void
+{
+    auto next = std::atomic<std::size_t>{0};
+    auto failure = std::exception_ptr{};
+    auto failure_mutex = std::mutex{};
+
+    auto const work = [&] {
+        try
+        {
+            for (auto i = next++; i < count; i = next++)
+            {
+                task(i);
+            }
+        }
+        catch (...)
+        {
+            auto const lock = std::scoped_lock{failure_mutex};
+            if (!failure)
+            {
+                failure = std::current_exception();
+            }
+            next = count;
+        }
+    };
+
+    {
+        auto threads = std::vector<std::jthread>{};
+        threads.reserve(thread_count - 1);
+        for (auto i = std::size_t{1}; i < thread_count; ++i)
+        {
+            threads.emplace_back(work);
+        }
+        work();
+    }
+
+    if (failure)
+    {
+        std::rethrow_exception(failure);
+    }
+}
+
+/**
+ * @brief Renders the root Cell of \p flat in a single forward pass.
+ */
+template <typename Pitch>
+auto render_flat(sequence::FlatSequence const &flat,
+                 sequence::SampleSpan root,
+                 Pitch const &pitch) -> std::vector<sequence::midi::TimedMidiNote>
+{
+    using sequence::FlatSequence;
+
+    auto results = std::vector<sequence::midi::TimedMidiNote>{};
+    results.reserve(flat.notes.size());
+
+    if (flat.cells.empty())
+    {
+        return results;
+    }
+
+    // Parents are stored before their children, so a single forward pass can hand
+    // each child cell its span before that cell is reached.
+    auto spans = std::vector<sequence::SampleSpan>(flat.cells.size());
+    spans[0] = root;
+
+    for (auto i = std::size_t{0}; i < flat.cells.size(); ++i)
+    {
+        auto const &cell = flat.cells[i];
+        auto const span = spans[i];
+
+        for (auto e = cell.elements_begin;
+             e < cell.elements_begin + cell.elements_count; ++e)
+        {
+            auto const &element = flat.elements[e];
+            if (element.kind == FlatSequence::ElementNode::Kind::Note)
+            {
+                auto const note = flat.notes.note(element.index);
+                results.push_back(
+                    create_timed_midi_note(note, span, pitch(note.pitch)));
+            }
+            else
+            {
+                auto const &seq = flat.sequences[element.index];
+                auto total_weight = 0.;
+                for (auto c = seq.cells_begin; c < seq.cells_begin + seq.cells_count;
+                     ++c)
+                {
+                    total_weight += static_cast<double>(flat.cells[c].weight);
+                }
+                auto subdivision =
+                    sequence::Subdivision{span, total_weight, seq.cells_count};
+                for (auto c = seq.cells_begin; c < seq.cells_begin + seq.cells_count;
+                     ++c)
+                {
+                    spans[c] = subdivision.next(flat.cells[c].weight);
+                }
+            }
+        }
+    }
+
+    return results;
 }
 
 } // namespace
@@ -139,77 +841,366 @@ auto create_timed_midi_note(sequence::Note const &note,
 namespace sequence::midi
 {
 
-auto flatten_to_midi(std::vector<MusicElement> const &elements,
-                     std::uint32_t sample_offset,
-                     std::uint32_t sample_count,
-                     Tuning const &tuning,
-                     float base_frequency,
-                     float pb_range) -> std::vector<TimedMidiNote>
+auto create_timed_midi_note(Note const &note,
+                            SampleSpan span,
+                            MicrotonalNote pitch) noexcept -> TimedMidiNote
 {
-    if (tuning.intervals.empty())
+    // In double, a float cannot hold every sample position of a long render.
+    auto const delay = static_cast<SampleTime>(static_cast<double>(span.count) *
+                                               static_cast<double>(note.delay));
+    auto const note_samples = static_cast<SampleTime>(
+        static_cast<double>(span.count - delay) * static_cast<double>(note.gate));
+
+    return TimedMidiNote{
+        .begin = span.offset + delay,
+        .end = span.offset + delay + note_samples,
+        .note = pitch.note,
+        .velocity = static_cast<std::uint8_t>(note.velocity * 127),
+        .pitch_bend = pitch.pitch_bend,
+    };
+}
+
+PitchMap::PitchMap(Tuning tuning, float base_frequency, float pb_range)
+    : tuning_{std::move(tuning)}, base_note_{0.f}, pb_range_{pb_range}, first_pitch_{0}
+{
+    validate_render_arguments(tuning_, base_frequency, pb_range);
+    base_note_ = base_midi_note(base_frequency);
+
+    // Every pitch whose fractional MIDI note lands outside of [0, 127] clamps to the
+    // same result, so only the pitches that can land inside it, plus an octave of
+    // margin either side, are tabulated. Pitches outside the window are computed on
+    // demand, so the result is identical for every pitch either way.
+    if (!(tuning_.octave > 0.f))
     {
-        throw std::invalid_argument("Tuning must not be empty");
+        return;
     }
-    if (base_frequency <= 0.f)
+    constexpr auto max_table_size = double{1 << 16};
+    auto const degrees = static_cast<double>(tuning_.intervals.size());
+    auto const pitches_per_note = 100. * degrees / static_cast<double>(tuning_.octave);
+    auto const first =
+        std::floor((-1. - static_cast<double>(base_note_)) * pitches_per_note) -
+        degrees;
+    auto const last =
+        std::ceil((128. - static_cast<double>(base_note_)) * pitches_per_note) +
+        degrees;
+    if (last - first + 1. > max_table_size ||
+        first < static_cast<double>(std::numeric_limits<int>::min()) ||
+        last > static_cast<double>(std::numeric_limits<int>::max()))
     {
-        throw std::invalid_argument("base_frequency must be greater than 0");
+        return;
     }
-    if (pb_range <= 0.f)
+
+    first_pitch_ = static_cast<int>(first);
+    table_.reserve(static_cast<std::size_t>(last - first) + 1);
+    for (auto pitch = first_pitch_; pitch <= static_cast<int>(last); ++pitch)
     {
-        throw std::invalid_argument("pb_range must be greater than 0");
+        table_.push_back(this->compute(pitch));
     }
+}
 
+auto PitchMap::fractional_note(int pitch) const noexcept -> float
+{
+    return fractional_midi_note(pitch, tuning_, base_note_);
+}
+
+auto PitchMap::compute(int pitch) const noexcept -> MicrotonalNote
+{
+    return create_midi_note(pitch, tuning_, base_note_, pb_range_);
+}
+
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range) -> std::vector<TimedMidiNote>
+{
+    auto results = std::vector<TimedMidiNote>{};
+    flatten_to_midi(elements, sample_offset, sample_count, tuning, base_frequency,
+                    pb_range, results);
+
+    return results;
+}
+
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range,
+                     std::vector<TimedMidiNote> &out) -> void
+{
+    validate_render_arguments(tuning, base_frequency, pb_range);
+    throw_if_failed(render_into(elements, {sample_offset, sample_count},
+                                DirectPitch{tuning, base_frequency, pb_range}, out));
+}
+
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range,
+                     std::span<TimedMidiNote> out) -> std::size_t
+{
+    validate_render_arguments(tuning, base_frequency, pb_range);
+    return throw_if_failed(render_into(elements, {sample_offset, sample_count},
+                                       DirectPitch{tuning, base_frequency, pb_range},
+                                       out));
+}
+
+auto flatten_to_midi(std::initializer_list<MusicElement> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range) -> std::vector<TimedMidiNote>
+{
+    return flatten_to_midi(std::span{elements.begin(), elements.size()}, sample_offset,
+                           sample_count, tuning, base_frequency, pb_range);
+}
+
+auto flatten_to_midi(FlatSequence const &flat,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     Tuning const &tuning,
+                     float base_frequency,
+                     float pb_range) -> std::vector<TimedMidiNote>
+{
+    validate_render_arguments(tuning, base_frequency, pb_range);
+    return render_flat(flat, {sample_offset, sample_count},
+                       DirectPitch{tuning, base_frequency, pb_range});
+}
+
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>
+{
     auto results = std::vector<TimedMidiNote>{};
+    throw_if_failed(
+        render_into(elements, {sample_offset, sample_count}, pitch_map, results));
+    return results;
+}
 
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map,
+                     std::vector<TimedMidiNote> &out) -> void
+{
+    throw_if_failed(
+        render_into(elements, {sample_offset, sample_count}, pitch_map, out));
+}
+
+auto flatten_to_midi(std::span<MusicElement const> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map,
+                     std::span<TimedMidiNote> out) -> std::size_t
+{
+    return throw_if_failed(
+        render_into(elements, {sample_offset, sample_count}, pitch_map, out));
+}
+
+auto try_flatten_to_midi(std::span<MusicElement const> elements,
+                         SampleTime sample_offset,
+                         SampleTime sample_count,
+                         PitchMap const &pitch_map,
+                         std::span<TimedMidiNote> out) noexcept -> RenderResult
+{
+    return render_into(elements, {sample_offset, sample_count}, pitch_map, out);
+}
+
+auto flatten_to_midi(std::initializer_list<MusicElement> elements,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>
+{
+    return flatten_to_midi(std::span{elements.begin(), elements.size()}, sample_offset,
+                           sample_count, pitch_map);
+}
+
+auto flatten_to_midi(FlatSequence const &flat,
+                     SampleTime sample_offset,
+                     SampleTime sample_count,
+                     PitchMap const &pitch_map) -> std::vector<TimedMidiNote>
+{
+    return render_flat(flat, {sample_offset, sample_count}, pitch_map);
+}
+
+auto flatten_to_midi_window(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            SampleTime window_begin,
+                            SampleTime window_end,
+                            PitchMap const &pitch_map) -> std::vector<TimedMidiNote>
+{
+    auto results = std::vector<TimedMidiNote>{};
+    flatten_to_midi_window(elements, sample_offset, sample_count, window_begin,
+                           window_end, pitch_map, results);
+    return results;
+}
+
+auto flatten_to_midi_window(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            SampleTime window_begin,
+                            SampleTime window_end,
+                            PitchMap const &pitch_map,
+                            std::vector<TimedMidiNote> &out) -> void
+{
+    throw_if_failed(render_into(elements, {sample_offset, sample_count}, pitch_map, out,
+                                SampleWindow{window_begin, window_end}));
+}
+
+auto try_flatten_to_midi_window(std::span<MusicElement const> elements,
+                                SampleTime sample_offset,
+                                SampleTime sample_count,
+                                SampleTime window_begin,
+                                SampleTime window_end,
+                                PitchMap const &pitch_map,
+                                std::span<TimedMidiNote> out) noexcept -> RenderResult
+{
+    return render_into(elements, {sample_offset, sample_count}, pitch_map, out,
+                       SampleWindow{window_begin, window_end});
+}
+
+auto flatten_to_midi_events(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            PitchMap const &pitch_map) -> std::vector<MidiEvent>
+{
+    auto results = std::vector<MidiEvent>{};
+    throw_if_failed(
+        render_events(elements, {sample_offset, sample_count}, pitch_map, results));
+    return results;
+}
+
+auto flatten_to_midi_events(std::span<MusicElement const> elements,
+                            SampleTime sample_offset,
+                            SampleTime sample_count,
+                            Tuning const &tuning,
+                            float base_frequency,
+                            float pb_range) -> std::vector<MidiEvent>
+{
+    validate_render_arguments(tuning, base_frequency, pb_range);
+    auto results = std::vector<MidiEvent>{};
+    throw_if_failed(render_events(elements, {sample_offset, sample_count},
+                                  DirectPitch{tuning, base_frequency, pb_range},
+                                  results));
+    return results;
+}
+
+auto lazy_flatten_to_midi(std::span<MusicElement const> elements,
+                          SampleTime sample_offset,
+                          SampleTime sample_count,
+                          PitchMap const &pitch_map) -> Generator<TimedMidiNote>
+{
+    auto frontier = LazyFrontier{};
+    auto const expand = [&](auto const &cell_elements, SampleSpan span) {
+        for (auto const &element : cell_elements)
+        {
+            if (auto const *note = std::get_if<Note>(&element))
+            {
+                frontier.push(
+                    create_timed_midi_note(*note, span, pitch_map(note->pitch)));
+            }
+            else
+            {
+                frontier.push_sequence(std::get<Sequence>(element), span);
+            }
+        }
+    };
+
+    expand(elements, {sample_offset, sample_count});
+    while (!frontier.empty())
+    {
+        auto item = frontier.pop();
+        if (auto const *note = std::get_if<TimedMidiNote>(&item))
+        {
+            co_yield *note;
+            continue;
+        }
+
+        auto const &cell = std::get<LazyFrontier::PendingCell>(item);
+        if (cell.index + 1 < cell.seq->cells.size())
+        {
+            frontier.push_cell(*cell.seq, cell.index + 1, cell.rest);
+        }
+        expand(cell.seq->cells[cell.index].elements, cell.span);
+    }
+}
+
+auto flatten_to_midi_parallel(std::span<MusicElement const> elements,
+                              SampleTime sample_offset,
+                              SampleTime sample_count,
+                              PitchMap const &pitch_map,
+                              std::size_t thread_count) -> std::vector<TimedMidiNote>
+{
+    struct Task
+    {
+        std::span<MusicElement const> elements;
+        SampleSpan span;
+    };
+
+    // Each root Note is its own task, and each top-level Sequence contributes one task
+    // per child cell. In order, the tasks' notes are the notes of flatten_to_midi.
+    auto const root = SampleSpan{sample_offset, sample_count};
+    auto tasks = std::vector<Task>{};
     for (auto const &element : elements)
     {
-        std::visit(
-            utility::overload{
-                [&](Note const &note) {
-                    results.push_back(create_timed_midi_note( // TOD-
-                        note, sample_offset, sample_count, tuning, base_frequency,
-                        pb_range));
-                },
-                [&](Sequence const &seq) {
-                    auto const total_weight = std::accumulate(
-                        std::cbegin(seq.cells), std::cend(seq.cells), 0.,
-                        [](double sum, Cell const &cell) {
-                            return sum + static_cast<double>(cell.weight);
-                        });
-                    if (total_weight <= 0.)
-                    {
-                        throw std::invalid_argument(
-                            "sequence total weight must be greater than 0");
-                    }
-
-                    auto current_offset = static_cast<double>(sample_offset);
-                    auto const sequence_end = sample_offset + sample_count;
-
-                    for (auto i = 0u; i < seq.cells.size(); ++i)
-                    {
-                        auto const &cell = seq.cells[i];
-                        auto const exact_count =
-                            static_cast<double>(sample_count) *
-                            (static_cast<double>(cell.weight) / total_weight);
-                        auto const cell_sample_offset =
-                            static_cast<std::uint32_t>(std::round(current_offset));
-                        current_offset += exact_count;
-                        auto const cell_end = i + 1 == seq.cells.size()
-                                                  ? sequence_end
-                                                  : static_cast<std::uint32_t>(
-                                                        std::round(current_offset));
-                        auto const cell_sample_count = cell_end - cell_sample_offset;
-                        auto sub_results = flatten_to_midi(
-                            cell.elements, cell_sample_offset, cell_sample_count,
-                            tuning, base_frequency, pb_range);
-                        std::move(std::begin(sub_results), std::end(sub_results),
-                                  std::back_inserter(results));
-                    }
-                },
-            },
-            element);
+        auto const *seq = std::get_if<Sequence>(&element);
+        if (seq == nullptr)
+        {
+            tasks.push_back({{&element, 1}, root});
+            continue;
+        }
+
+        auto total_weight = 0.;
+        for (auto const &cell : seq->cells)
+        {
+            total_weight += static_cast<double>(cell.weight);
+        }
+        auto subdivision = Subdivision{root, total_weight, seq->cells.size()};
+        for (auto const &cell : seq->cells)
+        {
+            tasks.push_back({cell.elements, subdivision.next(cell.weight)});
+        }
     }
 
+    if (tasks.empty())
+    {
+        return {};
+    }
+    if (thread_count == 0)
+    {
+        thread_count = std::thread::hardware_concurrency();
+    }
+    thread_count = std::clamp(thread_count, std::size_t{1}, tasks.size());
+
+    auto buffers = std::vector<std::vector<TimedMidiNote>>(tasks.size());
+    auto statuses = std::vector<RenderStatus>(tasks.size(), RenderStatus::ok);
+    run_parallel(tasks.size(), thread_count, [&](std::size_t i) {
+        auto const &task = tasks[i];
+        statuses[i] = render_into(task.elements, task.span, pitch_map, buffers[i]);
+    });
+    for (auto const status : statuses)
+    {
+        throw_if_failed(status);
+    }
+
+    auto size = std::size_t{0};
+    for (auto const &buffer : buffers)
+    {
+        size += buffer.size();
+    }
+    auto results = std::vector<TimedMidiNote>{};
+    results.reserve(size);
+    for (auto const &buffer : buffers)
+    {
+        results.insert(results.end(), buffer.begin(), buffer.end());
+    }
     return results;
 }
 
@@ -2,125 +2,175 @@
 
 #include <algorithm>
 #include <cstddef>
+#include <cstdint>
 #include <iterator>
+#include <random>
 #include <stdexcept>
 #include <type_traits>
+#include <utility>
 #include <variant>
 #include <vector>
 
+#include <sequence/flat.hpp>
 #include <sequence/pattern.hpp>
+#include <sequence/persistent.hpp>
 #include <sequence/random.hpp>
+#include <sequence/traverse.hpp>
 
 namespace
 {
 
 using namespace sequence;
 
+/**
+ * @brief Calls \p note_fn on every note selected by \p pattern below \p element, and
+ * \p seq_fn on every visited Sequence before its cells are visited.
+ */
 template <typename NoteFn, typename SequenceFn>
-[[nodiscard]]
-auto visit_recursive(MusicElement const &element,
-                     Pattern const &pattern,
-                     NoteFn const &note_fn,
-                     SequenceFn const &seq_fn) -> MusicElement
-{
-    static_assert(std::is_invocable_v<NoteFn, Note const &>,
-                  "NoteFn must be invocable with a Note const&");
-    static_assert(std::is_invocable_v<SequenceFn, Sequence const &>,
-                  "SequenceFn must be invocable with a Sequence const&");
-
-    return std::visit(
-        utility::overload{
-            [&](Note const &note) -> MusicElement { return note_fn(note); },
-            [&](Sequence const &seq) -> MusicElement {
-                auto new_seq = seq_fn(seq);
-                auto view = PatternView{new_seq.cells, pattern};
-                for (auto &c : view)
-                {
-                    for (auto &elem : c.elements)
-                    {
-                        elem = visit_recursive(elem, pattern, note_fn, seq_fn);
-                    }
-                }
-                return new_seq;
-            },
-        },
-        element);
+auto visit_notes(MusicElement &element,
+                 Pattern const &pattern,
+                 NoteFn const &note_fn,
+                 SequenceFn const &seq_fn) -> void
+{
+    static_assert(std::is_invocable_v<NoteFn, Note &>,
+                  "NoteFn must be invocable with a Note&");
+    static_assert(std::is_invocable_v<SequenceFn, Sequence &>,
+                  "SequenceFn must be invocable with a Sequence&");
+
+    struct Visitor
+    {
+        NoteFn const &note_fn;
+        SequenceFn const &seq_fn;
+
+        auto note(Note &note) const -> void
+        {
+            note_fn(note);
+        }
+
+        auto enter_sequence(Sequence &seq) const -> void
+        {
+            seq_fn(seq);
+        }
+    };
+
+    traverse(element, pattern, Visitor{note_fn, seq_fn});
 }
 
 template <typename NoteFn>
-[[nodiscard]]
-auto visit_recursive(MusicElement const &element,
-                     Pattern const &pattern,
-                     NoteFn const &note_fn) -> MusicElement
+auto visit_notes(MusicElement &element, Pattern const &pattern, NoteFn const &note_fn)
+    -> void
 {
-    return visit_recursive(element, pattern, note_fn, [](Sequence s) { return s; });
+    visit_notes(element, pattern, note_fn, [](Sequence &) {});
 }
 
-} // namespace
-
-namespace sequence::modify
-{
-
-auto randomize_pitch(MusicElement element, Pattern const &pattern, int min, int max)
-    -> MusicElement
+/**
+ * @brief Flags the notes of a FlatSequence that the Cell overloads would visit.
+ *
+ * Every element of the root cell is visited, and each nested Sequence only descends
+ * into the child cells selected by \p pattern, matching visit_notes.
+ *
+ * @return One flag per note in \p flat, 1 if the note is selected, otherwise 0.
+ * @throws std::invalid_argument if a visited Sequence is reached and \p pattern has no
+ * intervals.
+ */
+[[nodiscard]]
+auto select_notes(FlatSequence const &flat, Pattern const &pattern)
+    -> std::vector<std::uint8_t>
 {
-    if (min > max)
+    auto selected_cells = std::vector<std::uint8_t>(flat.cells.size(), 0);
+    if (!selected_cells.empty())
     {
-        throw std::invalid_argument("min must be less than or equal to max");
+        selected_cells[0] = 1;
     }
 
-    auto &gen = sequence::random::engine();
-    auto dis = std::uniform_int_distribution{min, max};
+    // Parents are stored before their children, so one forward pass settles every
+    // cell before it is read.
+    for (auto i = std::size_t{0}; i < flat.cells.size(); ++i)
+    {
+        if (selected_cells[i] == 0)
+        {
+            continue;
+        }
+        auto const &cell = flat.cells[i];
+        for (auto e = cell.elements_begin;
+             e < cell.elements_begin + cell.elements_count; ++e)
+        {
+            auto const &element = flat.elements[e];
+            if (element.kind != FlatSequence::ElementNode::Kind::Sequence)
+            {
+                continue;
+            }
+            if (pattern.intervals.empty())
+            {
+                throw std::invalid_argument("Pattern should not be empty.");
+            }
+            auto const &seq = flat.sequences[element.index];
+            auto interval_index = std::size_t{0};
+            for (auto c = pattern.offset; c < seq.cells_count;
+                 c += pattern.intervals[interval_index],
+                      interval_index = (interval_index + 1) % pattern.intervals.size())
+            {
+                selected_cells[seq.cells_begin + c] = 1;
+            }
+        }
+    }
 
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.pitch = dis(gen);
-        return n;
-    });
+    auto selected_notes = std::vector<std::uint8_t>(flat.notes.size());
+    for (auto i = std::size_t{0}; i < selected_notes.size(); ++i)
+    {
+        selected_notes[i] = selected_cells[flat.notes.cell[i]];
+    }
+    return selected_notes;
 }
 
-auto randomize_pitch(Cell cell, Pattern const &pattern, int min, int max) -> Cell
+/**
+ * @brief Applies \p fn to the selected entries of a single NoteColumns column.
+ *
+ * Written as a branchless select over contiguous arrays so the loop vectorizes.
+ */
+template <typename T, typename Fn>
+auto transform_selected(std::vector<T> &column,
+                        std::vector<std::uint8_t> const &selected,
+                        Fn const &fn) -> void
 {
-    for (auto &elem : cell.elements)
+    for (auto i = std::size_t{0}; i < column.size(); ++i)
     {
-        elem = randomize_pitch(elem, pattern, min, max);
+        column[i] = selected[i] != 0 ? fn(column[i]) : column[i];
     }
-    return cell;
 }
 
-auto randomize_velocity(MusicElement element,
-                        Pattern const &pattern,
-                        float min,
-                        float max) -> MusicElement
+/**
+ * @brief Overwrites the selected entries of \p column with values drawn from \p dis.
+ */
+template <typename T, typename Distribution>
+auto randomize_selected(std::vector<T> &column,
+                        std::vector<std::uint8_t> const &selected,
+                        Distribution &dis) -> void
 {
-    if (min > max)
-    {
-        throw std::invalid_argument("min must be less than or equal to max");
-    }
-    else if (min < 0.f || min > 1.f || max < 0.f || max > 1.f)
+    auto &gen = sequence::random::engine();
+    for (auto i = std::size_t{0}; i < column.size(); ++i)
     {
-        throw std::invalid_argument("min and max must be in the range [0, 1]");
+        if (selected[i] != 0)
+        {
+            column[i] = dis(gen);
+        }
     }
-
-    auto &gen = sequence::random::engine();
-    auto dis = std::uniform_real_distribution{min, max};
-
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.velocity = dis(gen);
-        return n;
-    });
 }
 
-auto randomize_velocity(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+// Builders for the edits that take checked or clamped arguments, shared by every
+// overload of the matching modify function and by its Pipeline builder.
+
+auto randomize_pitch_edit(int min, int max) -> modify::edit::RandomizePitch
 {
-    for (auto &elem : cell.elements)
+    if (min > max)
     {
-        elem = randomize_velocity(elem, pattern, min, max);
+        throw std::invalid_argument("min must be less than or equal to max");
     }
-    return cell;
+    return {.min = min, .max = max};
 }
 
-auto randomize_delay(MusicElement element, Pattern const &pattern, float min, float max)
-    -> MusicElement
+template <float Note::*Attribute>
+auto randomize_unit_edit(float min, float max) -> modify::edit::RandomizeUnit<Attribute>
 {
     if (min > max)
     {
@@ -130,233 +180,221 @@ auto randomize_delay(MusicElement element, Pattern const &pattern, float min, fl
     {
         throw std::invalid_argument("min and max must be in the range [0, 1]");
     }
-
-    auto &gen = sequence::random::engine();
-    auto dis = std::uniform_real_distribution{min, max};
-
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.delay = dis(gen);
-        return n;
-    });
+    return {.min = min, .max = max};
 }
 
-auto randomize_delay(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+auto set_octave_edit(int octave, std::size_t tuning_length) -> modify::edit::SetOctave
 {
-    for (auto &elem : cell.elements)
+    if (tuning_length == 0)
     {
-        elem = randomize_delay(elem, pattern, min, max);
+        throw std::invalid_argument("tuning_length must be greater than 0");
     }
-    return cell;
+    return {.octave = octave, .tuning_length = static_cast<int>(tuning_length)};
 }
 
-auto randomize_gate(MusicElement element, Pattern const &pattern, float min, float max)
-    -> MusicElement
+template <float Note::*Attribute>
+auto set_unit_edit(float value) -> modify::edit::SetUnit<Attribute>
 {
-    if (min > max)
-    {
-        throw std::invalid_argument("min must be less than or equal to max");
-    }
-    else if (min < 0.f || min > 1.f || max < 0.f || max > 1.f)
-    {
-        throw std::invalid_argument("min and max must be in the range [0, 1]");
-    }
+    return {.value = std::clamp(value, 0.f, 1.f)};
+}
 
+/**
+ * @brief Runs \p edit on every note selected by \p pattern below \p element.
+ */
+template <typename Edit>
+auto apply_edit(MusicElement &element, Pattern const &pattern, Edit const &edit) -> void
+{
     auto &gen = sequence::random::engine();
-    auto dis = std::uniform_real_distribution{min, max};
-
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.gate = dis(gen);
-        return n;
-    });
+    visit_notes(element, pattern, [&](Note &n) { edit(n, gen); });
 }
 
-auto randomize_gate(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+template <typename Edit>
+auto apply_edit(Cell &cell, Pattern const &pattern, Edit const &edit) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = randomize_gate(elem, pattern, min, max);
+        apply_edit(elem, pattern, edit);
     }
-    return cell;
 }
 
-auto shift_pitch(MusicElement element, Pattern const &pattern, int amount)
-    -> MusicElement
+template <typename Edit>
+auto apply_edit(PersistentCell cell, Pattern const &pattern, Edit const &edit)
+    -> PersistentCell
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.pitch += amount;
+    auto &gen = sequence::random::engine();
+    return transform_notes(cell, pattern, [&](Note n) {
+        edit(n, gen);
         return n;
     });
 }
 
-auto shift_pitch(Cell cell, Pattern const &pattern, int amount) -> Cell
+/**
+ * @brief Runs every edit of a Pipeline Stage on one note, in the order they were added.
+ */
+struct StageEdits
 {
-    for (auto &elem : cell.elements)
+    std::vector<modify::Pipeline::Edit> const &edits;
+
+    auto operator()(Note &note, std::mt19937 &gen) const -> void
     {
-        elem = shift_pitch(elem, pattern, amount);
+        for (auto const &edit : edits)
+        {
+            std::visit([&](auto const &kernel) { kernel(note, gen); }, edit);
+        }
     }
-    return cell;
+};
+
+} // namespace
+
+namespace sequence::modify::inplace
+{
+
+auto randomize_pitch(MusicElement &element, Pattern const &pattern, int min, int max)
+    -> void
+{
+    apply_edit(element, pattern, randomize_pitch_edit(min, max));
 }
 
-auto shift_velocity(MusicElement element, Pattern const &pattern, float amount)
-    -> MusicElement
+auto randomize_pitch(Cell &cell, Pattern const &pattern, int min, int max) -> void
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.velocity = std::clamp(n.velocity + amount, 0.f, 1.f);
-        return n;
-    });
+    apply_edit(cell, pattern, randomize_pitch_edit(min, max));
 }
 
-auto shift_velocity(Cell cell, Pattern const &pattern, float amount) -> Cell
+auto randomize_velocity(MusicElement &element,
+                        Pattern const &pattern,
+                        float min,
+                        float max) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = shift_velocity(elem, pattern, amount);
-    }
-    return cell;
+    apply_edit(element, pattern, randomize_unit_edit<&Note::velocity>(min, max));
 }
 
-auto shift_delay(MusicElement element, Pattern const &pattern, float amount)
-    -> MusicElement
+auto randomize_velocity(Cell &cell, Pattern const &pattern, float min, float max)
+    -> void
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.delay = std::clamp(n.delay + amount, 0.f, 1.f);
-        return n;
-    });
+    apply_edit(cell, pattern, randomize_unit_edit<&Note::velocity>(min, max));
 }
 
-auto shift_delay(Cell cell, Pattern const &pattern, float amount) -> Cell
+auto randomize_delay(MusicElement &element,
+                     Pattern const &pattern,
+                     float min,
+                     float max) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = shift_delay(elem, pattern, amount);
-    }
-    return cell;
+    apply_edit(element, pattern, randomize_unit_edit<&Note::delay>(min, max));
 }
 
-auto shift_gate(MusicElement element, Pattern const &pattern, float amount)
-    -> MusicElement
+auto randomize_delay(Cell &cell, Pattern const &pattern, float min, float max) -> void
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.gate = std::clamp(n.gate + amount, 0.f, 1.f);
-        return n;
-    });
+    apply_edit(cell, pattern, randomize_unit_edit<&Note::delay>(min, max));
 }
 
-auto shift_gate(Cell cell, Pattern const &pattern, float amount) -> Cell
+auto randomize_gate(MusicElement &element, Pattern const &pattern, float min, float max)
+    -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = shift_gate(elem, pattern, amount);
-    }
-    return cell;
+    apply_edit(element, pattern, randomize_unit_edit<&Note::gate>(min, max));
 }
 
-auto set_pitch(MusicElement element, Pattern const &pattern, int pitch) -> MusicElement
+auto randomize_gate(Cell &cell, Pattern const &pattern, float min, float max) -> void
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.pitch = pitch;
-        return n;
-    });
+    apply_edit(cell, pattern, randomize_unit_edit<&Note::gate>(min, max));
 }
 
-auto set_pitch(Cell cell, Pattern const &pattern, int pitch) -> Cell
+auto shift_pitch(MusicElement &element, Pattern const &pattern, int amount) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = set_pitch(elem, pattern, pitch);
-    }
-    return cell;
+    apply_edit(element, pattern, edit::ShiftPitch{amount});
 }
 
-auto set_octave(MusicElement element,
-                Pattern const &pattern,
-                int octave,
-                std::size_t tuning_length) -> MusicElement
+auto shift_pitch(Cell &cell, Pattern const &pattern, int amount) -> void
 {
-    if (tuning_length == 0)
-    {
-        throw std::invalid_argument("tuning_length must be greater than 0");
-    }
+    apply_edit(cell, pattern, edit::ShiftPitch{amount});
+}
+
+auto shift_velocity(MusicElement &element, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(element, pattern, edit::ShiftVelocity{amount});
+}
 
-    return visit_recursive(element, pattern, [&](Note n) {
-        auto const tuning_length_i = static_cast<int>(tuning_length);
-        auto degree_in_current_octave =
-            (n.pitch % tuning_length_i + tuning_length_i) % tuning_length_i;
+auto shift_velocity(Cell &cell, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(cell, pattern, edit::ShiftVelocity{amount});
+}
 
-        n.pitch = degree_in_current_octave + (octave * tuning_length_i);
-        return n;
-    });
+auto shift_delay(MusicElement &element, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(element, pattern, edit::ShiftDelay{amount});
 }
 
-auto set_octave(Cell cell,
+auto shift_delay(Cell &cell, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(cell, pattern, edit::ShiftDelay{amount});
+}
+
+auto shift_gate(MusicElement &element, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(element, pattern, edit::ShiftGate{amount});
+}
+
+auto shift_gate(Cell &cell, Pattern const &pattern, float amount) -> void
+{
+    apply_edit(cell, pattern, edit::ShiftGate{amount});
+}
+
+auto set_pitch(MusicElement &element, Pattern const &pattern, int pitch) -> void
+{
+    apply_edit(element, pattern, edit::SetPitch{pitch});
+}
+
+auto set_pitch(Cell &cell, Pattern const &pattern, int pitch) -> void
+{
+    apply_edit(cell, pattern, edit::SetPitch{pitch});
+}
+
+auto set_octave(MusicElement &element,
                 Pattern const &pattern,
                 int octave,
-                std::size_t tuning_length) -> Cell
+                std::size_t tuning_length) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = set_octave(elem, pattern, octave, tuning_length);
-    }
-    return cell;
+    apply_edit(element, pattern, set_octave_edit(octave, tuning_length));
 }
 
-auto set_velocity(MusicElement element, Pattern const &pattern, float velocity)
-    -> MusicElement
+auto set_octave(Cell &cell,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> void
 {
-    velocity = std::clamp(velocity, 0.f, 1.f);
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.velocity = velocity;
-        return n;
-    });
+    apply_edit(cell, pattern, set_octave_edit(octave, tuning_length));
 }
 
-auto set_velocity(Cell cell, Pattern const &pattern, float velocity) -> Cell
+auto set_velocity(MusicElement &element, Pattern const &pattern, float velocity) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = set_velocity(elem, pattern, velocity);
-    }
-    return cell;
+    apply_edit(element, pattern, set_unit_edit<&Note::velocity>(velocity));
 }
 
-auto set_delay(MusicElement element, Pattern const &pattern, float delay)
-    -> MusicElement
+auto set_velocity(Cell &cell, Pattern const &pattern, float velocity) -> void
 {
-    delay = std::clamp(delay, 0.f, 1.f);
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.delay = delay;
-        return n;
-    });
+    apply_edit(cell, pattern, set_unit_edit<&Note::velocity>(velocity));
 }
 
-auto set_delay(Cell cell, Pattern const &pattern, float delay) -> Cell
+auto set_delay(MusicElement &element, Pattern const &pattern, float delay) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = set_delay(elem, pattern, delay);
-    }
-    return cell;
+    apply_edit(element, pattern, set_unit_edit<&Note::delay>(delay));
 }
 
-auto set_gate(MusicElement element, Pattern const &pattern, float gate) -> MusicElement
+auto set_delay(Cell &cell, Pattern const &pattern, float delay) -> void
 {
-    gate = std::clamp(gate, 0.f, 1.f);
-    return visit_recursive(element, pattern, [&](Note n) {
-        n.gate = gate;
-        return n;
-    });
+    apply_edit(cell, pattern, set_unit_edit<&Note::delay>(delay));
 }
 
-auto set_gate(Cell cell, Pattern const &pattern, float gate) -> Cell
+auto set_gate(MusicElement &element, Pattern const &pattern, float gate) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = set_gate(elem, pattern, gate);
-    }
-    return cell;
+    apply_edit(element, pattern, set_unit_edit<&Note::gate>(gate));
 }
 
-auto rotate(MusicElement element, int amount) -> MusicElement
+auto set_gate(Cell &cell, Pattern const &pattern, float gate) -> void
+{
+    apply_edit(cell, pattern, set_unit_edit<&Note::gate>(gate));
+}
+
+auto rotate(MusicElement &element, int amount) -> void
 {
     amount *= -1;
 
@@ -374,58 +412,42 @@ auto rotate(MusicElement element, int amount) -> MusicElement
                    },
                },
                element);
-
-    return element;
 }
 
-auto rotate(Cell cell, int amount) -> Cell
+auto rotate(Cell &cell, int amount) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = rotate(elem, amount);
+        rotate(elem, amount);
     }
-    return cell;
 }
 
-auto mirror(MusicElement element, Pattern const &pattern, int center_note)
-    -> MusicElement
+auto mirror(MusicElement &element, Pattern const &pattern, int center_note) -> void
 {
-    return visit_recursive(element, pattern, [&](Note n) {
-        auto const diff = center_note - n.pitch;
-        n.pitch = center_note + diff;
-        return n;
-    });
+    apply_edit(element, pattern, edit::Mirror{center_note});
 }
 
-auto mirror(Cell cell, Pattern const &pattern, int center_note) -> Cell
+auto mirror(Cell &cell, Pattern const &pattern, int center_note) -> void
 {
-    for (auto &elem : cell.elements)
-    {
-        elem = mirror(elem, pattern, center_note);
-    }
-    return cell;
+    apply_edit(cell, pattern, edit::Mirror{center_note});
 }
 
-auto reverse(MusicElement element) -> MusicElement
+auto reverse(MusicElement &element) -> void
 {
-    return visit_recursive(
-        element, {0, {1}}, [](Note n) { return n; },
-        [](Sequence seq) {
-            std::ranges::reverse(seq.cells);
-            return seq;
-        });
+    visit_notes(
+        element, {0, {1}}, [](Note &) {},
+        [](Sequence &seq) { std::ranges::reverse(seq.cells); });
 }
 
-auto reverse(Cell cell) -> Cell
+auto reverse(Cell &cell) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = reverse(elem);
+        reverse(elem);
     }
-    return cell;
 }
 
-auto repeat(MusicElement element, std::size_t count) -> MusicElement
+auto repeat(MusicElement &element, std::size_t count) -> void
 {
     if (count == 0)
     {
@@ -434,115 +456,641 @@ auto repeat(MusicElement element, std::size_t count) -> MusicElement
     auto seq = Sequence{};
     seq.cells.reserve(count);
 
-    for (auto i = std::size_t{0}; i < count; ++i)
+    for (auto i = std::size_t{1}; i < count; ++i)
     {
         seq.cells.push_back({.elements = {element}, .weight = 1.f});
     }
 
-    return seq;
+    // The last copy takes over the original element's storage.
+    auto &last = seq.cells.emplace_back();
+    last.elements.push_back(std::move(element));
+
+    element = std::move(seq);
 }
 
-auto repeat(Cell cell, std::size_t count) -> Cell
+auto repeat(Cell &cell, std::size_t count) -> void
 {
     if (count == 0)
     {
         throw std::invalid_argument{"Invalid count: " + std::to_string(count)};
     }
+    auto const weight = cell.weight;
     auto seq = Sequence{};
     seq.cells.reserve(count);
 
-    for (auto i = std::size_t{0}; i < count; ++i)
+    for (auto i = std::size_t{1}; i < count; ++i)
     {
         seq.cells.push_back(cell);
     }
 
-    return {.elements = {seq}, .weight = cell.weight};
+    // The last copy takes over the original cell's storage.
+    seq.cells.push_back(std::move(cell));
+
+    cell = Cell{};
+    cell.elements.push_back(std::move(seq));
+    cell.weight = weight;
 }
 
-auto stretch(MusicElement element, Pattern const &pattern, std::size_t amount)
-    -> MusicElement
+auto stretch(MusicElement &element, Pattern const &pattern, std::size_t amount) -> void
 {
     if (amount == 0)
     {
         throw std::invalid_argument{"Invalid amount: " + std::to_string(amount)};
     }
 
-    return std::visit(
-        utility::overload{
-            [&](Note note) -> MusicElement { return repeat(note, amount); },
-            [&](Sequence seq) -> MusicElement {
-                auto view = PatternView{seq.cells, pattern};
-                for (auto &c : view)
+    if (std::holds_alternative<Note>(element))
+    {
+        repeat(element, amount);
+        return;
+    }
+
+    // Notes are repeated once their cell has been visited, so the new sequences are
+    // not themselves walked and stretched again.
+    struct Visitor
+    {
+        std::size_t amount;
+
+        auto exit_cell(Cell &cell) const -> void
+        {
+            for (auto &elem : cell.elements)
+            {
+                if (std::holds_alternative<Note>(elem))
                 {
-                    c = stretch(c, pattern, amount);
+                    repeat(elem, amount);
                 }
-                return seq;
-            },
-        },
-        element);
+            }
+        }
+    };
+
+    traverse(element, pattern, Visitor{amount});
 }
 
-auto stretch(Cell cell, Pattern const &pattern, std::size_t amount) -> Cell
+auto stretch(Cell &cell, Pattern const &pattern, std::size_t amount) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = stretch(elem, pattern, amount);
+        stretch(elem, pattern, amount);
     }
-    return cell;
 }
 
-auto compress(MusicElement element, Pattern const &pattern) -> MusicElement
+auto compress(MusicElement &element, Pattern const &pattern) -> void
 {
-    return std::visit(utility::overload{
-                          [&](Note const &note) -> MusicElement { return note; },
-                          [&](Sequence const &seq) -> MusicElement {
-                              auto new_seq = Sequence{};
-                              auto view = ConstPatternView{seq.cells, pattern};
-                              for (auto const &c : view)
-                              {
-                                  new_seq.cells.push_back(c);
-                              }
-                              return new_seq;
-                          },
-                      },
-                      element);
+    std::visit(utility::overload{
+                   [](Note &) {},
+                   [&](Sequence &seq) {
+                       // Selected indices only ever increase, so each kept cell is
+                       // moved down over cells that have already been dropped.
+                       auto kept = std::size_t{0};
+                       auto view = PatternView{seq.cells, pattern};
+                       for (auto &c : view)
+                       {
+                           auto const index =
+                               static_cast<std::size_t>(&c - seq.cells.data());
+                           if (index != kept)
+                           {
+                               seq.cells[kept] = std::move(c);
+                           }
+                           ++kept;
+                       }
+                       seq.cells.erase(seq.cells.begin() +
+                                           static_cast<std::ptrdiff_t>(kept),
+                                       seq.cells.end());
+                   },
+               },
+               element);
 }
 
-auto compress(Cell cell, Pattern const &pattern) -> Cell
+auto compress(Cell &cell, Pattern const &pattern) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = compress(elem, pattern);
+        compress(elem, pattern);
     }
-    return cell;
 }
 
-auto shuffle(MusicElement element) -> MusicElement
+auto shuffle(MusicElement &element) -> void
 {
-    return visit_recursive(
-        element, {0, {1}}, [](Note n) { return n; },
-        [](Sequence seq) {
+    visit_notes(
+        element, {0, {1}}, [](Note &) {},
+        [](Sequence &seq) {
             std::ranges::shuffle(seq.cells, sequence::random::engine());
-            return seq;
         });
 }
 
-auto shuffle(Cell cell) -> Cell
+auto shuffle(Cell &cell) -> void
 {
     for (auto &elem : cell.elements)
     {
-        elem = shuffle(elem);
+        shuffle(elem);
     }
-    return cell;
 }
 
-auto note(int pitch, float velocity, float delay, float gate) -> MusicElement
+auto apply(Pipeline const &pipeline, MusicElement &element) -> void
 {
-    if (velocity < 0.f || velocity > 1.f)
+    for (auto const &stage : pipeline.stages())
     {
-        throw std::invalid_argument("velocity must be in the range [0.0, 1.0]");
+        apply_edit(element, stage.pattern, StageEdits{stage.edits});
     }
-    else if (delay < 0.f || delay > 1.f)
+}
+
+auto apply(Pipeline const &pipeline, Cell &cell) -> void
+{
+    for (auto const &stage : pipeline.stages())
+    {
+        apply_edit(cell, stage.pattern, StageEdits{stage.edits});
+    }
+}
+
+} // namespace sequence::modify::inplace
+
+namespace sequence::modify
+{
+
+auto randomize_pitch(MusicElement element, Pattern const &pattern, int min, int max)
+    -> MusicElement
+{
+    inplace::randomize_pitch(element, pattern, min, max);
+    return element;
+}
+
+auto randomize_pitch(Cell cell, Pattern const &pattern, int min, int max) -> Cell
+{
+    inplace::randomize_pitch(cell, pattern, min, max);
+    return cell;
+}
+
+auto randomize_pitch(FlatSequence flat, Pattern const &pattern, int min, int max)
+    -> FlatSequence
+{
+    auto const edit = randomize_pitch_edit(min, max);
+    auto dis = std::uniform_int_distribution{edit.min, edit.max};
+    randomize_selected(flat.notes.pitch, select_notes(flat, pattern), dis);
+    return flat;
+}
+
+auto randomize_pitch(PersistentCell cell, Pattern const &pattern, int min, int max)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, randomize_pitch_edit(min, max));
+}
+
+auto randomize_velocity(MusicElement element,
+                        Pattern const &pattern,
+                        float min,
+                        float max) -> MusicElement
+{
+    inplace::randomize_velocity(element, pattern, min, max);
+    return element;
+}
+
+auto randomize_velocity(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+{
+    inplace::randomize_velocity(cell, pattern, min, max);
+    return cell;
+}
+
+auto randomize_velocity(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence
+{
+    auto const edit = randomize_unit_edit<&Note::velocity>(min, max);
+    auto dis = std::uniform_real_distribution{edit.min, edit.max};
+    randomize_selected(flat.notes.velocity, select_notes(flat, pattern), dis);
+    return flat;
+}
+
+auto randomize_velocity(PersistentCell cell,
+                        Pattern const &pattern,
+                        float min,
+                        float max) -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern,
+                      randomize_unit_edit<&Note::velocity>(min, max));
+}
+
+auto randomize_delay(MusicElement element, Pattern const &pattern, float min, float max)
+    -> MusicElement
+{
+    inplace::randomize_delay(element, pattern, min, max);
+    return element;
+}
+
+auto randomize_delay(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+{
+    inplace::randomize_delay(cell, pattern, min, max);
+    return cell;
+}
+
+auto randomize_delay(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence
+{
+    auto const edit = randomize_unit_edit<&Note::delay>(min, max);
+    auto dis = std::uniform_real_distribution{edit.min, edit.max};
+    randomize_selected(flat.notes.delay, select_notes(flat, pattern), dis);
+    return flat;
+}
+
+auto randomize_delay(PersistentCell cell, Pattern const &pattern, float min, float max)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern,
+                      randomize_unit_edit<&Note::delay>(min, max));
+}
+
+auto randomize_gate(MusicElement element, Pattern const &pattern, float min, float max)
+    -> MusicElement
+{
+    inplace::randomize_gate(element, pattern, min, max);
+    return element;
+}
+
+auto randomize_gate(Cell cell, Pattern const &pattern, float min, float max) -> Cell
+{
+    inplace::randomize_gate(cell, pattern, min, max);
+    return cell;
+}
+
+auto randomize_gate(FlatSequence flat, Pattern const &pattern, float min, float max)
+    -> FlatSequence
+{
+    auto const edit = randomize_unit_edit<&Note::gate>(min, max);
+    auto dis = std::uniform_real_distribution{edit.min, edit.max};
+    randomize_selected(flat.notes.gate, select_notes(flat, pattern), dis);
+    return flat;
+}
+
+auto randomize_gate(PersistentCell cell, Pattern const &pattern, float min, float max)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern,
+                      randomize_unit_edit<&Note::gate>(min, max));
+}
+
+auto shift_pitch(MusicElement element, Pattern const &pattern, int amount)
+    -> MusicElement
+{
+    inplace::shift_pitch(element, pattern, amount);
+    return element;
+}
+
+auto shift_pitch(Cell cell, Pattern const &pattern, int amount) -> Cell
+{
+    inplace::shift_pitch(cell, pattern, amount);
+    return cell;
+}
+
+auto shift_pitch(FlatSequence flat, Pattern const &pattern, int amount) -> FlatSequence
+{
+    transform_selected(flat.notes.pitch, select_notes(flat, pattern),
+                       [&](int pitch) { return pitch + amount; });
+    return flat;
+}
+
+auto shift_pitch(PersistentCell cell, Pattern const &pattern, int amount)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::ShiftPitch{amount});
+}
+
+auto shift_velocity(MusicElement element, Pattern const &pattern, float amount)
+    -> MusicElement
+{
+    inplace::shift_velocity(element, pattern, amount);
+    return element;
+}
+
+auto shift_velocity(Cell cell, Pattern const &pattern, float amount) -> Cell
+{
+    inplace::shift_velocity(cell, pattern, amount);
+    return cell;
+}
+
+auto shift_velocity(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence
+{
+    transform_selected(flat.notes.velocity, select_notes(flat, pattern),
+                       [&](float value) {
+                           return std::clamp(value + amount, 0.f, 1.f);
+                       });
+    return flat;
+}
+
+auto shift_velocity(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::ShiftVelocity{amount});
+}
+
+auto shift_delay(MusicElement element, Pattern const &pattern, float amount)
+    -> MusicElement
+{
+    inplace::shift_delay(element, pattern, amount);
+    return element;
+}
+
+auto shift_delay(Cell cell, Pattern const &pattern, float amount) -> Cell
+{
+    inplace::shift_delay(cell, pattern, amount);
+    return cell;
+}
+
+auto shift_delay(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence
+{
+    transform_selected(flat.notes.delay, select_notes(flat, pattern),
+                       [&](float value) {
+                           return std::clamp(value + amount, 0.f, 1.f);
+                       });
+    return flat;
+}
+
+auto shift_delay(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::ShiftDelay{amount});
+}
+
+auto shift_gate(MusicElement element, Pattern const &pattern, float amount)
+    -> MusicElement
+{
+    inplace::shift_gate(element, pattern, amount);
+    return element;
+}
+
+auto shift_gate(Cell cell, Pattern const &pattern, float amount) -> Cell
+{
+    inplace::shift_gate(cell, pattern, amount);
+    return cell;
+}
+
+auto shift_gate(FlatSequence flat, Pattern const &pattern, float amount)
+    -> FlatSequence
+{
+    transform_selected(flat.notes.gate, select_notes(flat, pattern),
+                       [&](float value) {
+                           return std::clamp(value + amount, 0.f, 1.f);
+                       });
+    return flat;
+}
+
+auto shift_gate(PersistentCell cell, Pattern const &pattern, float amount)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::ShiftGate{amount});
+}
+
+auto set_pitch(MusicElement element, Pattern const &pattern, int pitch) -> MusicElement
+{
+    inplace::set_pitch(element, pattern, pitch);
+    return element;
+}
+
+auto set_pitch(Cell cell, Pattern const &pattern, int pitch) -> Cell
+{
+    inplace::set_pitch(cell, pattern, pitch);
+    return cell;
+}
+
+auto set_pitch(FlatSequence flat, Pattern const &pattern, int pitch) -> FlatSequence
+{
+    transform_selected(flat.notes.pitch, select_notes(flat, pattern),
+                       [&](int) { return pitch; });
+    return flat;
+}
+
+auto set_pitch(PersistentCell cell, Pattern const &pattern, int pitch)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::SetPitch{pitch});
+}
+
+auto set_octave(MusicElement element,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> MusicElement
+{
+    inplace::set_octave(element, pattern, octave, tuning_length);
+    return element;
+}
+
+auto set_octave(Cell cell,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> Cell
+{
+    inplace::set_octave(cell, pattern, octave, tuning_length);
+    return cell;
+}
+
+auto set_octave(FlatSequence flat,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> FlatSequence
+{
+    auto const edit = set_octave_edit(octave, tuning_length);
+    transform_selected(flat.notes.pitch, select_notes(flat, pattern), [&](int pitch) {
+        auto const degree_in_current_octave =
+            (pitch % edit.tuning_length + edit.tuning_length) % edit.tuning_length;
+        return degree_in_current_octave + (edit.octave * edit.tuning_length);
+    });
+    return flat;
+}
+
+auto set_octave(PersistentCell cell,
+                Pattern const &pattern,
+                int octave,
+                std::size_t tuning_length) -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, set_octave_edit(octave, tuning_length));
+}
+
+auto set_velocity(MusicElement element, Pattern const &pattern, float velocity)
+    -> MusicElement
+{
+    inplace::set_velocity(element, pattern, velocity);
+    return element;
+}
+
+auto set_velocity(Cell cell, Pattern const &pattern, float velocity) -> Cell
+{
+    inplace::set_velocity(cell, pattern, velocity);
+    return cell;
+}
+
+auto set_velocity(FlatSequence flat, Pattern const &pattern, float velocity)
+    -> FlatSequence
+{
+    auto const edit = set_unit_edit<&Note::velocity>(velocity);
+    transform_selected(flat.notes.velocity, select_notes(flat, pattern),
+                       [&](float) { return edit.value; });
+    return flat;
+}
+
+auto set_velocity(PersistentCell cell, Pattern const &pattern, float velocity)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern,
+                      set_unit_edit<&Note::velocity>(velocity));
+}
+
+auto set_delay(MusicElement element, Pattern const &pattern, float delay)
+    -> MusicElement
+{
+    inplace::set_delay(element, pattern, delay);
+    return element;
+}
+
+auto set_delay(Cell cell, Pattern const &pattern, float delay) -> Cell
+{
+    inplace::set_delay(cell, pattern, delay);
+    return cell;
+}
+
+auto set_delay(FlatSequence flat, Pattern const &pattern, float delay) -> FlatSequence
+{
+    auto const edit = set_unit_edit<&Note::delay>(delay);
+    transform_selected(flat.notes.delay, select_notes(flat, pattern),
+                       [&](float) { return edit.value; });
+    return flat;
+}
+
+auto set_delay(PersistentCell cell, Pattern const &pattern, float delay)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, set_unit_edit<&Note::delay>(delay));
+}
+
+auto set_gate(MusicElement element, Pattern const &pattern, float gate) -> MusicElement
+{
+    inplace::set_gate(element, pattern, gate);
+    return element;
+}
+
+auto set_gate(Cell cell, Pattern const &pattern, float gate) -> Cell
+{
+    inplace::set_gate(cell, pattern, gate);
+    return cell;
+}
+
+auto set_gate(FlatSequence flat, Pattern const &pattern, float gate) -> FlatSequence
+{
+    auto const edit = set_unit_edit<&Note::gate>(gate);
+    transform_selected(flat.notes.gate, select_notes(flat, pattern),
+                       [&](float) { return edit.value; });
+    return flat;
+}
+
+auto set_gate(PersistentCell cell, Pattern const &pattern, float gate)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, set_unit_edit<&Note::gate>(gate));
+}
+
+auto rotate(MusicElement element, int amount) -> MusicElement
+{
+    inplace::rotate(element, amount);
+    return element;
+}
+
+auto rotate(Cell cell, int amount) -> Cell
+{
+    inplace::rotate(cell, amount);
+    return cell;
+}
+
+auto mirror(MusicElement element, Pattern const &pattern, int center_note)
+    -> MusicElement
+{
+    inplace::mirror(element, pattern, center_note);
+    return element;
+}
+
+auto mirror(Cell cell, Pattern const &pattern, int center_note) -> Cell
+{
+    inplace::mirror(cell, pattern, center_note);
+    return cell;
+}
+
+auto mirror(FlatSequence flat, Pattern const &pattern, int center_note) -> FlatSequence
+{
+    transform_selected(flat.notes.pitch, select_notes(flat, pattern),
+                       [&](int pitch) { return center_note + (center_note - pitch); });
+    return flat;
+}
+
+auto mirror(PersistentCell cell, Pattern const &pattern, int center_note)
+    -> PersistentCell
+{
+    return apply_edit(std::move(cell), pattern, edit::Mirror{center_note});
+}
+
+auto reverse(MusicElement element) -> MusicElement
+{
+    inplace::reverse(element);
+    return element;
+}
+
+auto reverse(Cell cell) -> Cell
+{
+    inplace::reverse(cell);
+    return cell;
+}
+
+auto repeat(MusicElement element, std::size_t count) -> MusicElement
+{
+    inplace::repeat(element, count);
+    return element;
+}
+
+auto repeat(Cell cell, std::size_t count) -> Cell
+{
+    inplace::repeat(cell, count);
+    return cell;
+}
+
+auto stretch(MusicElement element, Pattern const &pattern, std::size_t amount)
+    -> MusicElement
+{
+    inplace::stretch(element, pattern, amount);
+    return element;
+}
+
+auto stretch(Cell cell, Pattern const &pattern, std::size_t amount) -> Cell
+{
+    inplace::stretch(cell, pattern, amount);
+    return cell;
+}
+
+auto compress(MusicElement element, Pattern const &pattern) -> MusicElement
+{
+    inplace::compress(element, pattern);
+    return element;
+}
+
+auto compress(Cell cell, Pattern const &pattern) -> Cell
+{
+    inplace::compress(cell, pattern);
+    return cell;
+}
+
+auto shuffle(MusicElement element) -> MusicElement
+{
+    inplace::shuffle(element);
+    return element;
+}
+
+auto shuffle(Cell cell) -> Cell
+{
+    inplace::shuffle(cell);
+    return cell;
+}
+
+auto note(int pitch, float velocity, float delay, float gate) -> MusicElement
+{
+    if (velocity < 0.f || velocity > 1.f)
+    {
+        throw std::invalid_argument("velocity must be in the range [0.0, 1.0]");
+    }
+    else if (delay < 0.f || delay > 1.f)
     {
         throw std::invalid_argument("delay must be in the range [0.0, 1.0]");
     }
@@ -553,4 +1101,117 @@ auto note(int pitch, float velocity, float delay, float gate) -> MusicElement
     return Note{pitch, velocity, delay, gate};
 }
 
+auto Pipeline::randomize_pitch(Pattern const &pattern, int min, int max) -> Pipeline &
+{
+    return add(pattern, randomize_pitch_edit(min, max));
+}
+
+auto Pipeline::randomize_velocity(Pattern const &pattern, float min, float max)
+    -> Pipeline &
+{
+    return add(pattern, randomize_unit_edit<&Note::velocity>(min, max));
+}
+
+auto Pipeline::randomize_delay(Pattern const &pattern, float min, float max)
+    -> Pipeline &
+{
+    return add(pattern, randomize_unit_edit<&Note::delay>(min, max));
+}
+
+auto Pipeline::randomize_gate(Pattern const &pattern, float min, float max)
+    -> Pipeline &
+{
+    return add(pattern, randomize_unit_edit<&Note::gate>(min, max));
+}
+
+auto Pipeline::shift_pitch(Pattern const &pattern, int amount) -> Pipeline &
+{
+    return add(pattern, edit::ShiftPitch{amount});
+}
+
+auto Pipeline::shift_velocity(Pattern const &pattern, float amount) -> Pipeline &
+{
+    return add(pattern, edit::ShiftVelocity{amount});
+}
+
+auto Pipeline::shift_delay(Pattern const &pattern, float amount) -> Pipeline &
+{
+    return add(pattern, edit::ShiftDelay{amount});
+}
+
+auto Pipeline::shift_gate(Pattern const &pattern, float amount) -> Pipeline &
+{
+    return add(pattern, edit::ShiftGate{amount});
+}
+
+auto Pipeline::set_pitch(Pattern const &pattern, int pitch) -> Pipeline &
+{
+    return add(pattern, edit::SetPitch{pitch});
+}
+
+auto Pipeline::set_octave(Pattern const &pattern, int octave, std::size_t tuning_length)
+    -> Pipeline &
+{
+    return add(pattern, set_octave_edit(octave, tuning_length));
+}
+
+auto Pipeline::set_velocity(Pattern const &pattern, float velocity) -> Pipeline &
+{
+    return add(pattern, set_unit_edit<&Note::velocity>(velocity));
+}
+
+auto Pipeline::set_delay(Pattern const &pattern, float delay) -> Pipeline &
+{
+    return add(pattern, set_unit_edit<&Note::delay>(delay));
+}
+
+auto Pipeline::set_gate(Pattern const &pattern, float gate) -> Pipeline &
+{
+    return add(pattern, set_unit_edit<&Note::gate>(gate));
+}
+
+auto Pipeline::mirror(Pattern const &pattern, int center_note) -> Pipeline &
+{
+    return add(pattern, edit::Mirror{center_note});
+}
+
+auto Pipeline::stages() const -> std::vector<Stage> const &
+{
+    return stages_;
+}
+
+auto Pipeline::add(Pattern const &pattern, Edit edit) -> Pipeline &
+{
+    if (!stages_.empty() && stages_.back().pattern == pattern)
+    {
+        stages_.back().edits.push_back(std::move(edit));
+    }
+    else
+    {
+        stages_.push_back({.pattern = pattern, .edits = {std::move(edit)}});
+    }
+    return *this;
+}
+
+auto apply(Pipeline const &pipeline, MusicElement element) -> MusicElement
+{
+    inplace::apply(pipeline, element);
+    return element;
+}
+
+auto apply(Pipeline const &pipeline, Cell cell) -> Cell
+{
+    inplace::apply(pipeline, cell);
+    return cell;
+}
+
+auto apply(Pipeline const &pipeline, PersistentCell cell) -> PersistentCell
+{
+    for (auto const &stage : pipeline.stages())
+    {
+        cell = apply_edit(std::move(cell), stage.pattern, StageEdits{stage.edits});
+    }
+    return cell;
+}
+
 } // namespace sequence::modify
@@ -0,0 +1,162 @@
+#include <sequence/packed.hpp>
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sequence/flat.hpp>
+#include <sequence/sequence.hpp>
+
+namespace
+{
+
+constexpr auto fixed_point_scale = float{std::numeric_limits<std::uint16_t>::max()};
+
+[[nodiscard]]
+auto to_fixed_point(float value, char const *field) -> std::uint16_t
+{
+    if (!(value >= 0.f && value <= 1.f))
+    {
+        throw std::out_of_range{std::string{"pack: "} + field +
+                                " must be in the range [0, 1]."};
+    }
+    return static_cast<std::uint16_t>(std::lround(value * fixed_point_scale));
+}
+
+[[nodiscard]]
+auto from_fixed_point(std::uint16_t value) -> float
+{
+    return static_cast<float>(value) / fixed_point_scale;
+}
+
+[[nodiscard]]
+auto to_element_index(std::size_t index) -> std::uint32_t
+{
+    if (index >= sequence::PackedSequence::ElementNode::sequence_bit)
+    {
+        throw std::out_of_range{"to_packed: too many notes or sequences."};
+    }
+    return static_cast<std::uint32_t>(index);
+}
+
+} // namespace
+
+namespace sequence
+{
+
+auto pack(Note const &note) -> PackedNote
+{
+    if (note.pitch < std::numeric_limits<std::int16_t>::min() ||
+        note.pitch > std::numeric_limits<std::int16_t>::max())
+    {
+        throw std::out_of_range{"pack: pitch must fit in 16 bits."};
+    }
+
+    return PackedNote{
+        .pitch = static_cast<std::int16_t>(note.pitch),
+        .velocity = to_fixed_point(note.velocity, "velocity"),
+        .delay = to_fixed_point(note.delay, "delay"),
+        .gate = to_fixed_point(note.gate, "gate"),
+    };
+}
+
+auto unpack(PackedNote const &note) -> Note
+{
+    return Note{
+        .pitch = note.pitch,
+        .velocity = from_fixed_point(note.velocity),
+        .delay = from_fixed_point(note.delay),
+        .gate = from_fixed_point(note.gate),
+    };
+}
+
+auto to_packed(FlatSequence const &flat) -> PackedSequence
+{
+    auto packed = PackedSequence{
+        .cells = flat.cells,
+        .elements = {},
+        .notes = {},
+        .sequences = flat.sequences,
+    };
+
+    packed.elements.reserve(flat.elements.size());
+    for (auto const &element : flat.elements)
+    {
+        auto const index = to_element_index(element.index);
+        packed.elements.push_back({
+            .value = element.kind == FlatSequence::ElementNode::Kind::Sequence
+                         ? index | PackedSequence::ElementNode::sequence_bit
+                         : index,
+        });
+    }
+
+    packed.notes.reserve(flat.notes.size());
+    for (auto i = std::size_t{0}; i < flat.notes.size(); ++i)
+    {
+        packed.notes.push_back(pack(flat.notes.note(i)));
+    }
+
+    return packed;
+}
+
+auto to_packed(Cell const &cell) -> PackedSequence
+{
+    return to_packed(to_flat(cell));
+}
+
+auto to_flat(PackedSequence const &packed) -> FlatSequence
+{
+    auto flat = FlatSequence{
+        .cells = packed.cells,
+        .elements = {},
+        .notes = {},
+        .sequences = packed.sequences,
+    };
+
+    auto const note_count = packed.notes.size();
+    flat.notes.pitch.resize(note_count);
+    flat.notes.velocity.resize(note_count);
+    flat.notes.delay.resize(note_count);
+    flat.notes.gate.resize(note_count);
+    flat.notes.cell.resize(note_count);
+
+    flat.elements.resize(packed.elements.size());
+    for (auto i = std::size_t{0}; i < packed.cells.size(); ++i)
+    {
+        auto const &cell = packed.cells[i];
+        for (auto e = cell.elements_begin;
+             e < cell.elements_begin + cell.elements_count; ++e)
+        {
+            auto const &element = packed.elements[e];
+            auto const index = element.index();
+            if (element.is_sequence())
+            {
+                flat.elements[e] = {.kind = FlatSequence::ElementNode::Kind::Sequence,
+                                    .index = index};
+                continue;
+            }
+
+            flat.elements[e] = {.kind = FlatSequence::ElementNode::Kind::Note,
+                                .index = index};
+            auto const note = unpack(packed.notes[index]);
+            flat.notes.pitch[index] = note.pitch;
+            flat.notes.velocity[index] = note.velocity;
+            flat.notes.delay[index] = note.delay;
+            flat.notes.gate[index] = note.gate;
+            flat.notes.cell[index] = static_cast<std::uint32_t>(i);
+        }
+    }
+
+    return flat;
+}
+
+auto from_packed(PackedSequence const &packed) -> Cell
+{
+    return from_flat(to_flat(packed));
+}
+
+} // namespace sequence
@@ -0,0 +1,189 @@
+#include <sequence/persistent.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sequence/hash.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/traverse.hpp>
+#include <sequence/utility.hpp>
+
+namespace
+{
+
+/**
+ * @brief Builds a Cell from a PersistentCell tree in one traverse() pass, the inverse
+ * of detail::PersistentBuilder.
+ */
+class CellBuilder
+{
+  public:
+    explicit CellBuilder(float root_weight)
+    {
+        cells_.push_back(sequence::Cell{.elements = {}, .weight = root_weight});
+    }
+
+    [[nodiscard]]
+    auto result() && -> sequence::Cell
+    {
+        return std::move(cells_.front());
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        cells_.back().elements.emplace_back(note);
+    }
+
+    auto enter_sequence(sequence::PersistentSequencePtr const &seq) -> void
+    {
+        sequences_.emplace_back().cells.reserve(seq->cells.size());
+    }
+
+    auto exit_sequence(sequence::PersistentSequencePtr const &) -> void
+    {
+        auto seq = std::move(sequences_.back());
+        sequences_.pop_back();
+        cells_.back().elements.emplace_back(std::move(seq));
+    }
+
+    auto enter_cell(sequence::PersistentCell const &cell) -> void
+    {
+        cells_.push_back(sequence::Cell{.elements = {}, .weight = cell.weight});
+        cells_.back().elements.reserve(cell.elements.size());
+    }
+
+    auto exit_cell(sequence::PersistentCell const &) -> void
+    {
+        sequences_.back().cells.push_back(std::move(cells_.back()));
+        cells_.pop_back();
+    }
+
+  private:
+    sequence::SmallVector<sequence::Cell, 16> cells_;
+    sequence::SmallVector<sequence::Sequence, 16> sequences_;
+};
+
+} // namespace
+
+namespace sequence
+{
+
+PersistentSequence::PersistentSequence(std::vector<PersistentCell> cells)
+    : cells{std::move(cells)}, structural_hash_{0}
+{
+    structural_hash_ = hash(*this);
+}
+
+auto make_persistent_sequence(std::vector<PersistentCell> cells)
+    -> PersistentSequencePtr
+{
+    return std::make_shared<PersistentSequence const>(std::move(cells));
+}
+
+auto operator==(PersistentCell const &lhs, PersistentCell const &rhs) -> bool
+{
+    if (&lhs == &rhs)
+    {
+        return true;
+    }
+    if (std::fabs(lhs.weight - rhs.weight) >= 0.0001f)
+    {
+        return false;
+    }
+    return std::ranges::equal(
+        lhs.elements, rhs.elements,
+        [](PersistentElement const &a, PersistentElement const &b) {
+            return std::visit(
+                utility::overload{
+                    [](Note const &x, Note const &y) { return x == y; },
+                    [](PersistentSequencePtr const &x, PersistentSequencePtr const &y) {
+                        return x == y || *x == *y;
+                    },
+                    [](auto const &, auto const &) { return false; },
+                },
+                a, b);
+        });
+}
+
+auto operator==(PersistentSequence const &lhs, PersistentSequence const &rhs) -> bool
+{
+    if (&lhs == &rhs)
+    {
+        return true;
+    }
+    if (lhs.structural_hash() != rhs.structural_hash())
+    {
+        return false;
+    }
+    return lhs.cells == rhs.cells;
+}
+
+auto to_persistent(Cell const &cell) -> PersistentCell
+{
+    auto builder = detail::PersistentBuilder{
+        cell.weight, [](std::vector<PersistentCell> cells) {
+            return make_persistent_sequence(std::move(cells));
+        }};
+    traverse(cell, builder);
+    return std::move(builder).result();
+}
+
+auto to_cell(PersistentCell const &cell) -> Cell
+{
+    auto builder = CellBuilder{cell.weight};
+    traverse(cell, builder);
+    return std::move(builder).result();
+}
+
+auto replace_cell(PersistentCell const &root,
+                  std::span<PathStep const> path,
+                  PersistentCell replacement) -> PersistentCell
+{
+    // Walk down first so an invalid path throws before anything is allocated.
+    auto parents = std::vector<PersistentCell const *>{};
+    parents.reserve(path.size());
+
+    auto const *current = &root;
+    for (auto const &step : path)
+    {
+        if (step.element >= current->elements.size())
+        {
+            throw std::out_of_range{"replace_cell: element index out of range"};
+        }
+        auto const *seq =
+            std::get_if<PersistentSequencePtr>(&current->elements[step.element]);
+        if (seq == nullptr)
+        {
+            throw std::out_of_range{"replace_cell: path step does not name a Sequence"};
+        }
+        if (step.cell >= (*seq)->cells.size())
+        {
+            throw std::out_of_range{"replace_cell: cell index out of range"};
+        }
+        parents.push_back(current);
+        current = &(*seq)->cells[step.cell];
+    }
+
+    // Rebuild the path bottom-up, each new node sharing its untouched siblings.
+    for (auto i = path.size(); i-- > 0;)
+    {
+        auto parent = *parents[i];
+        auto &element = parent.elements[path[i].element];
+        auto cells = std::get<PersistentSequencePtr>(element)->cells;
+        cells[path[i].cell] = std::move(replacement);
+        element = make_persistent_sequence(std::move(cells));
+        replacement = std::move(parent);
+    }
+
+    return replacement;
+}
+
+} // namespace sequence
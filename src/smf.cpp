@@ -0,0 +1,346 @@
+#include <sequence/smf.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+
+#include <sequence/midi.hpp>
+#include <sequence/timing.hpp>
+
+namespace
+{
+
+constexpr auto buffer_size = std::size_t{64 * 1'024};
+
+constexpr auto note_on = std::uint8_t{0x90};
+constexpr auto pitch_bend = std::uint8_t{0xE0};
+constexpr auto meta = std::uint8_t{0xFF};
+constexpr auto pitch_bend_center = std::uint16_t{8'192};
+
+// Delta time, FF 51 03 and a 24-bit tempo, then FF 58 04 and four bytes.
+constexpr auto tempo_and_time_signature_length = std::uint32_t{7 + 8};
+// Delta time and FF 2F 00.
+constexpr auto end_of_track_length = std::uint32_t{4};
+
+/**
+ * @brief Returns the tempo meta event's microseconds per quarter note for \p bpm.
+ */
+[[nodiscard]]
+auto microseconds_per_quarter(float bpm) -> std::uint32_t
+{
+    auto const microseconds = std::llround(60'000'000.0 / static_cast<double>(bpm));
+    if (microseconds < 1 || microseconds > 0xFF'FFFF)
+    {
+        throw std::invalid_argument("bpm is out of the range of a MIDI tempo");
+    }
+    return static_cast<std::uint32_t>(microseconds);
+}
+
+auto validate(sequence::midi::SmfSettings const &settings) -> void
+{
+    // Validates sample_rate, bpm and ticks_per_quarter.
+    (void)sequence::samples_to_ticks(0, settings.sample_rate, settings.bpm,
+                                     settings.ticks_per_quarter);
+    (void)microseconds_per_quarter(settings.bpm);
+
+    if (settings.ticks_per_quarter > 0x7FFF)
+    {
+        throw std::invalid_argument("ticks_per_quarter must be at most 32767");
+    }
+
+    auto const &time_signature = settings.time_signature;
+    if (time_signature.numerator == 0 || time_signature.numerator > 0xFF ||
+        !std::has_single_bit(time_signature.denominator))
+    {
+        throw std::invalid_argument(
+            "time_signature must have a numerator in [1, 255] and a power of two "
+            "denominator");
+    }
+}
+
+} // namespace
+
+namespace sequence::midi
+{
+
+SmfWriter::SmfWriter(std::ostream &out, SmfSettings const &settings)
+    : out_{&out}, settings_{settings}
+{
+    validate(settings_);
+
+    buffer_.reserve(buffer_size);
+    pitch_bends_.fill(pitch_bend_center);
+
+    position_ = static_cast<std::streamoff>(out_->tellp());
+    if (position_ < 0)
+    {
+        throw std::runtime_error("SMF output stream must be seekable");
+    }
+
+    auto const put_u16 = [this](std::uint16_t value) {
+        this->put(static_cast<std::uint8_t>(value >> 8));
+        this->put(static_cast<std::uint8_t>(value));
+    };
+    auto const put_u32 = [&](std::uint32_t value) {
+        put_u16(static_cast<std::uint16_t>(value >> 16));
+        put_u16(static_cast<std::uint16_t>(value));
+    };
+    auto const put_chunk_type = [this](char const(&type)[5]) {
+        for (auto i = 0; i < 4; ++i)
+        {
+            this->put(static_cast<std::uint8_t>(type[i]));
+        }
+    };
+
+    auto const multi_track = settings_.format == SmfFormat::multi_track;
+
+    put_chunk_type("MThd");
+    put_u32(6);
+    put_u16(static_cast<std::uint16_t>(settings_.format));
+    put_u16(multi_track ? 2 : 1);
+    put_u16(settings_.ticks_per_quarter);
+
+    if (multi_track)
+    {
+        put_chunk_type("MTrk");
+        put_u32(tempo_and_time_signature_length + end_of_track_length);
+        this->write_tempo_and_time_signature();
+        for (auto const byte : {0x00, 0xFF, 0x2F, 0x00})
+        {
+            this->put(static_cast<std::uint8_t>(byte));
+        }
+    }
+
+    // The note track, its length is patched by finish().
+    put_chunk_type("MTrk");
+    length_position_ = position_;
+    put_u32(0);
+    track_length_ = 0;
+
+    if (!multi_track)
+    {
+        this->write_tempo_and_time_signature();
+    }
+}
+
+SmfWriter::~SmfWriter()
+{
+    try
+    {
+        this->finish();
+    }
+    catch (...)
+    {
+    }
+}
+
+auto SmfWriter::write(TimedMidiNote const &note) -> void
+{
+    if (finished_)
+    {
+        throw std::logic_error("SmfWriter::write called after finish");
+    }
+    if (note.begin < previous_begin_)
+    {
+        throw std::invalid_argument("notes must be sorted by begin");
+    }
+    previous_begin_ = note.begin;
+
+    if (note.end <= note.begin)
+    {
+        return;
+    }
+
+    auto const begin = this->to_ticks(note.begin);
+    this->write_note_offs(begin);
+
+    auto const channel = static_cast<std::uint8_t>(note.channel & 0x0F);
+    auto const key = std::min<std::uint8_t>(note.note, 127);
+    auto const bend = std::min<std::uint16_t>(note.pitch_bend, 16'383);
+
+    if (pitch_bends_[channel] != bend)
+    {
+        this->write_channel_event(begin, pitch_bend | channel, bend & 0x7F, bend >> 7);
+        pitch_bends_[channel] = bend;
+    }
+    this->write_channel_event(begin, note_on | channel, key,
+                              std::min<std::uint8_t>(note.velocity, 127));
+
+    note_offs_.push(NoteOff{
+        .tick = this->to_ticks(note.end),
+        .channel = channel,
+        .note = key,
+    });
+}
+
+auto SmfWriter::write(std::span<TimedMidiNote const> notes) -> void
+{
+    for (auto const &note : notes)
+    {
+        this->write(note);
+    }
+}
+
+auto SmfWriter::finish() -> void
+{
+    if (finished_)
+    {
+        return;
+    }
+    finished_ = true;
+
+    this->write_note_offs(std::numeric_limits<std::uint64_t>::max());
+
+    this->write_delta(tick_);
+    this->put(meta);
+    this->put(0x2F);
+    this->put(0x00);
+    this->flush();
+
+    // Patch the note track's length, then return to the end of the file.
+    auto const length = track_length_;
+    char const bytes[] = {
+        static_cast<char>(length >> 24),
+        static_cast<char>(length >> 16),
+        static_cast<char>(length >> 8),
+        static_cast<char>(length),
+    };
+    out_->seekp(length_position_);
+    out_->write(bytes, sizeof(bytes));
+    out_->seekp(position_);
+    out_->flush();
+
+    if (!*out_)
+    {
+        throw std::runtime_error("Could not write MIDI file");
+    }
+}
+
+auto SmfWriter::to_ticks(SampleTime sample) const -> std::uint64_t
+{
+    return samples_to_ticks(sample, settings_.sample_rate, settings_.bpm,
+                            settings_.ticks_per_quarter);
+}
+
+auto SmfWriter::write_tempo_and_time_signature() -> void
+{
+    auto const tempo = microseconds_per_quarter(settings_.bpm);
+    auto const &time_signature = settings_.time_signature;
+
+    for (auto const byte : {
+             std::uint32_t{0x00}, std::uint32_t{0xFF}, std::uint32_t{0x51},
+             std::uint32_t{0x03}, tempo >> 16, tempo >> 8, tempo,
+             // Numerator, log2 of the denominator, 24 MIDI clocks per metronome
+             // click and 8 thirty-second notes per quarter note.
+             std::uint32_t{0x00}, std::uint32_t{0xFF}, std::uint32_t{0x58},
+             std::uint32_t{0x04}, std::uint32_t{time_signature.numerator},
+             static_cast<std::uint32_t>(std::countr_zero(time_signature.denominator)),
+             std::uint32_t{24}, std::uint32_t{8},
+         })
+    {
+        this->put(static_cast<std::uint8_t>(byte));
+    }
+
+    // Meta events cancel running status.
+    running_status_ = 0;
+}
+
+auto SmfWriter::write_note_offs(std::uint64_t until) -> void
+{
+    while (!note_offs_.empty() && note_offs_.top().tick <= until)
+    {
+        auto const off = note_offs_.top();
+        note_offs_.pop();
+        // A note on with a velocity of 0 keeps the running status of note ons.
+        this->write_channel_event(off.tick, note_on | off.channel, off.note, 0);
+    }
+}
+
+auto SmfWriter::write_channel_event(std::uint64_t tick,
+                                    std::uint8_t status,
+                                    std::uint8_t data1,
+                                    std::uint8_t data2) -> void
+{
+    this->write_delta(tick);
+    if (status != running_status_)
+    {
+        this->put(status);
+        running_status_ = status;
+    }
+    this->put(data1);
+    this->put(data2);
+    ++event_count_;
+}
+
+auto SmfWriter::write_delta(std::uint64_t tick) -> void
+{
+    auto delta = tick - tick_;
+    tick_ = tick;
+
+    // Variable length quantity, seven bits per byte, most significant first.
+    auto bytes = std::array<std::uint8_t, 10>{};
+    auto count = std::size_t{0};
+    do
+    {
+        bytes[count++] = static_cast<std::uint8_t>(delta & 0x7F);
+        delta >>= 7;
+    } while (delta != 0);
+
+    while (count > 1)
+    {
+        this->put(static_cast<std::uint8_t>(bytes[--count] | 0x80));
+    }
+    this->put(bytes[0]);
+}
+
+auto SmfWriter::put(std::uint8_t byte) -> void
+{
+    buffer_.push_back(static_cast<char>(byte));
+    ++track_length_;
+    ++position_;
+    if (buffer_.size() == buffer_size)
+    {
+        this->flush();
+    }
+}
+
+auto SmfWriter::flush() -> void
+{
+    out_->write(buffer_.data(), static_cast<std::streamsize>(buffer_.size()));
+    buffer_.clear();
+    if (!*out_)
+    {
+        throw std::runtime_error("Could not write MIDI file");
+    }
+}
+
+auto write_smf(std::ostream &out,
+               std::span<TimedMidiNote const> notes,
+               SmfSettings const &settings) -> void
+{
+    auto writer = SmfWriter{out, settings};
+    writer.write(notes);
+    writer.finish();
+}
+
+auto write_smf(std::filesystem::path const &file,
+               std::span<TimedMidiNote const> notes,
+               SmfSettings const &settings) -> void
+{
+    auto out = std::ofstream{file, std::ios::binary};
+    if (!out)
+    {
+        throw std::runtime_error("Could not open file: " + file.string());
+    }
+    write_smf(out, notes, settings);
+}
+
+} // namespace sequence::midi
@@ -0,0 +1,163 @@
+#include <sequence/timeline.hpp>
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/tuning.hpp>
+
+namespace
+{
+
+auto begins_before(sequence::midi::TimedMidiNote const &note,
+                   sequence::SampleTime sample) -> bool
+{
+    return note.begin < sample;
+}
+
+} // namespace
+
+namespace sequence::midi
+{
+
+Timeline::Timeline(std::vector<TimedMidiNote> notes) : notes_{std::move(notes)}
+{
+    std::ranges::stable_sort(notes_, {}, &TimedMidiNote::begin);
+
+    if (notes_.empty())
+    {
+        return;
+    }
+
+    leaves_ = std::bit_ceil(notes_.size());
+    max_end_.assign(2 * leaves_, 0);
+    for (auto i = std::size_t{0}; i < notes_.size(); ++i)
+    {
+        max_end_[leaves_ + i] = notes_[i].end;
+    }
+    for (auto i = leaves_ - 1; i > 0; --i)
+    {
+        max_end_[i] = std::max(max_end_[2 * i], max_end_[2 * i + 1]);
+    }
+}
+
+auto Timeline::starting_in(SampleTime begin, SampleTime end) const
+    -> std::span<TimedMidiNote const>
+{
+    if (end <= begin)
+    {
+        return {};
+    }
+    auto const first = std::lower_bound(notes_.begin(), notes_.end(), begin,
+                                        begins_before);
+    auto const last = std::lower_bound(first, notes_.end(), end, begins_before);
+    return {first, last};
+}
+
+auto Timeline::overlapping(SampleTime begin,
+                           SampleTime end,
+                           std::vector<TimedMidiNote> &out) const -> void
+{
+    if (end <= begin)
+    {
+        return;
+    }
+
+    // Notes that begin before the window intersect it if they end inside or after it,
+    // and every note that begins inside the window intersects it.
+    auto const starting = this->starting_in(begin, end);
+    this->ending_after(static_cast<std::size_t>(starting.data() - notes_.data()), begin,
+                       out);
+    out.insert(out.end(), starting.begin(), starting.end());
+}
+
+auto Timeline::overlapping(SampleTime begin, SampleTime end) const
+    -> std::vector<TimedMidiNote>
+{
+    auto results = std::vector<TimedMidiNote>{};
+    this->overlapping(begin, end, results);
+    return results;
+}
+
+auto Timeline::active_at(SampleTime sample) const -> std::vector<TimedMidiNote>
+{
+    auto const last =
+        std::upper_bound(notes_.begin(), notes_.end(), sample,
+                         [](SampleTime s, TimedMidiNote const &note) {
+                             return s < note.begin;
+                         });
+
+    auto results = std::vector<TimedMidiNote>{};
+    this->ending_after(static_cast<std::size_t>(last - notes_.begin()), sample,
+                       results);
+    return results;
+}
+
+auto Timeline::ending_after(std::size_t count,
+                            SampleTime sample,
+                            std::vector<TimedMidiNote> &out) const -> void
+{
+    if (count == 0)
+    {
+        return;
+    }
+
+    struct Node
+    {
+        std::size_t index;
+        std::size_t first; // Index of the first note below this node.
+        std::size_t size;  // Number of leaves below this node.
+    };
+
+    // Children are pushed right first, so notes are reported in order.
+    auto stack = SmallVector<Node, 64>{{.index = 1, .first = 0, .size = leaves_}};
+    while (!stack.empty())
+    {
+        auto const node = stack.back();
+        stack.pop_back();
+
+        if (node.first >= count || max_end_[node.index] <= sample)
+        {
+            continue;
+        }
+        if (node.size == 1)
+        {
+            out.push_back(notes_[node.first]);
+            continue;
+        }
+
+        auto const half = node.size / 2;
+        stack.push_back({2 * node.index + 1, node.first + half, half});
+        stack.push_back({2 * node.index, node.first, half});
+    }
+}
+
+auto to_timeline(Cell const &cell,
+                 SampleTime sample_offset,
+                 SampleTime sample_count,
+                 PitchMap const &pitch_map) -> Timeline
+{
+    return Timeline{flatten_to_midi(cell.elements, sample_offset, sample_count,
+                                    pitch_map)};
+}
+
+auto to_timeline(Cell const &cell,
+                 SampleTime sample_offset,
+                 SampleTime sample_count,
+                 Tuning const &tuning,
+                 float base_frequency,
+                 float pb_range) -> Timeline
+{
+    return Timeline{flatten_to_midi(cell.elements, sample_offset, sample_count, tuning,
+                                    base_frequency, pb_range)};
+}
+
+} // namespace sequence::midi
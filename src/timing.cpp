@@ -1,22 +1,17 @@
 #include <sequence/timing.hpp>
 
+#include <cmath>
 #include <cstdint>
 #include <stdexcept>
 
 #include <sequence/time_signature.hpp>
 
-namespace sequence
+namespace
 {
 
-auto samples_count(TimeSignature const &time_signature,
-                   std::uint32_t sample_rate,
-                   float bpm) -> std::uint32_t
+[[nodiscard]]
+auto samples_per_beat(std::uint32_t sample_rate, float bpm) -> float
 {
-    if (time_signature.denominator == 0)
-    {
-        throw std::invalid_argument(
-            "time_signature denominator must be greater than 0");
-    }
     if (sample_rate == 0)
     {
         throw std::invalid_argument("sample_rate must be greater than 0");
@@ -25,12 +20,44 @@ auto samples_count(TimeSignature const &time_signature,
     {
         throw std::invalid_argument("bpm must be greater than 0");
     }
+    return static_cast<float>(sample_rate) * 60.f / bpm;
+}
+
+} // namespace
+
+namespace sequence
+{
+
+auto samples_count(TimeSignature const &time_signature,
+                   std::uint32_t sample_rate,
+                   float bpm) -> SampleTime
+{
+    if (time_signature.denominator == 0)
+    {
+        throw std::invalid_argument(
+            "time_signature denominator must be greater than 0");
+    }
 
-    auto const samples_per_beat = static_cast<float>(sample_rate) * 60.f / bpm;
     auto const beats_per_bar = (static_cast<float>(time_signature.numerator) /
                                 static_cast<float>(time_signature.denominator)) *
                                4.f;
-    return static_cast<std::uint32_t>(samples_per_beat * beats_per_bar);
+    return static_cast<SampleTime>(samples_per_beat(sample_rate, bpm) *
+                                   beats_per_bar);
+}
+
+auto samples_to_ticks(SampleTime sample,
+                      std::uint32_t sample_rate,
+                      float bpm,
+                      std::uint16_t ticks_per_quarter) -> std::uint64_t
+{
+    if (ticks_per_quarter == 0)
+    {
+        throw std::invalid_argument("ticks_per_quarter must be greater than 0");
+    }
+
+    auto const beats = static_cast<double>(sample) /
+                       static_cast<double>(samples_per_beat(sample_rate, bpm));
+    return static_cast<std::uint64_t>(std::llround(beats * ticks_per_quarter));
 }
 
 } // namespace sequence
@@ -0,0 +1,292 @@
+#include <sequence/ump.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <span>
+#include <stdexcept>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/traverse.hpp>
+
+namespace
+{
+
+constexpr auto unsent = std::numeric_limits<std::uint64_t>::max();
+constexpr auto max_delta_clockstamp = std::uint64_t{0xF'FFFF};
+
+// Utility messages, message type 0x0.
+constexpr auto delta_clockstamp_tpq = std::uint32_t{0x3};
+constexpr auto delta_clockstamp = std::uint32_t{0x4};
+
+// MIDI 2.0 channel voice messages, message type 0x4.
+constexpr auto channel_voice = std::uint32_t{0x4};
+constexpr auto per_note_pitch_bend = std::uint32_t{0x6};
+constexpr auto note_off = std::uint32_t{0x8};
+constexpr auto note_on = std::uint32_t{0x9};
+
+/**
+ * @brief Collects the notes of a Cell tree at full pitch and velocity resolution, for
+ * traverse().
+ *
+ * Computes spans the same way as the flatten_to_midi renderers, so notes begin and end
+ * on the same samples as their TimedMidiNotes.
+ */
+template <typename Voice>
+class VoiceVisitor
+{
+  public:
+    VoiceVisitor(std::vector<Voice> &voices,
+                 sequence::SampleSpan root,
+                 sequence::midi::PitchMap const &pitch_map,
+                 float pitch_bend_range)
+        : voices_{voices}, pitch_map_{pitch_map}, pitch_bend_range_{pitch_bend_range}
+    {
+        spans_.push_back(root);
+    }
+
+    auto note(sequence::Note const &note) -> void
+    {
+        auto const timed =
+            sequence::midi::create_timed_midi_note(note, spans_.back(), {});
+        if (timed.end <= timed.begin)
+        {
+            return;
+        }
+
+        auto const fractional_note = pitch_map_.fractional_note(note.pitch);
+        auto const key = std::floor(fractional_note);
+        auto const semitones = static_cast<double>(fractional_note - key);
+        auto const bend = 2'147'483'648. *
+                          (1. + semitones / static_cast<double>(pitch_bend_range_));
+        auto const velocity = std::clamp(note.velocity, 0.f, 1.f) * 65'535.f;
+
+        voices_.push_back(Voice{
+            .begin = timed.begin,
+            .end = timed.end,
+            .pitch_bend = static_cast<std::uint32_t>(std::min(bend, 4'294'967'295.)),
+            .velocity = static_cast<std::uint16_t>(std::lround(velocity)),
+            .note = static_cast<std::uint8_t>(key),
+        });
+    }
+
+    [[nodiscard]]
+    auto status() const -> sequence::midi::RenderStatus
+    {
+        return status_;
+    }
+
+    auto enter_sequence(sequence::Sequence const &seq) -> bool
+    {
+        auto total_weight = 0.;
+        for (auto const &cell : seq.cells)
+        {
+            total_weight += static_cast<double>(cell.weight);
+        }
+        if (!(total_weight > 0.))
+        {
+            status_ = sequence::midi::RenderStatus::invalid_weight;
+            return false;
+        }
+        subdivisions_.emplace_back(spans_.back(), total_weight, seq.cells.size());
+        return true;
+    }
+
+    auto exit_sequence(sequence::Sequence const &) -> void
+    {
+        subdivisions_.pop_back();
+    }
+
+    auto enter_cell(sequence::Cell const &cell) -> bool
+    {
+        spans_.push_back(subdivisions_.back().next(cell.weight));
+        return true;
+    }
+
+    auto exit_cell(sequence::Cell const &) -> void
+    {
+        spans_.pop_back();
+    }
+
+  private:
+    std::vector<Voice> &voices_;
+    sequence::midi::PitchMap const &pitch_map_;
+    float pitch_bend_range_;
+    sequence::midi::RenderStatus status_ = sequence::midi::RenderStatus::ok;
+    sequence::SmallVector<sequence::Subdivision, 32> subdivisions_;
+    sequence::SmallVector<sequence::SampleSpan, 32> spans_;
+};
+
+} // namespace
+
+namespace sequence::midi
+{
+
+/**
+ * @brief Encodes messages into the output buffer, counting the words that do not fit.
+ */
+class UmpRenderer::Writer
+{
+  public:
+    Writer(UmpSettings const &settings,
+           std::span<std::uint32_t> out,
+           SampleTime start)
+        : settings_{settings}, out_{out},
+          tick_{samples_to_ticks(start, settings.sample_rate, settings.bpm,
+                                 settings.ticks_per_quarter)}
+    {
+        this->put(delta_clockstamp_tpq << 20 | settings_.ticks_per_quarter);
+    }
+
+    /**
+     * @brief Advances the stream to \p sample with Delta Clockstamps.
+     */
+    auto advance(SampleTime sample) -> void
+    {
+        auto const tick = samples_to_ticks(sample, settings_.sample_rate, settings_.bpm,
+                                           settings_.ticks_per_quarter);
+        auto delta = tick - tick_;
+        tick_ = tick;
+        while (delta > 0)
+        {
+            auto const step = std::min(delta, max_delta_clockstamp);
+            this->put(delta_clockstamp << 20 | static_cast<std::uint32_t>(step));
+            delta -= step;
+        }
+    }
+
+    auto channel_voice_message(std::uint32_t status,
+                               std::uint8_t channel,
+                               std::uint8_t note,
+                               std::uint32_t data) -> void
+    {
+        this->put(channel_voice << 28 | std::uint32_t{settings_.group} << 24 |
+                  status << 20 | std::uint32_t{channel} << 16 |
+                  std::uint32_t{note} << 8);
+        this->put(data);
+    }
+
+    [[nodiscard]]
+    auto word_count() const -> std::size_t
+    {
+        return count_;
+    }
+
+  private:
+    auto put(std::uint32_t word) -> void
+    {
+        if (count_ < out_.size())
+        {
+            out_[count_] = word;
+        }
+        ++count_;
+    }
+
+  private:
+    UmpSettings const &settings_;
+    std::span<std::uint32_t> out_;
+    std::size_t count_ = 0;
+    std::uint64_t tick_;
+};
+
+UmpRenderer::UmpRenderer(PitchMap pitch_map, UmpSettings const &settings)
+    : pitch_map_{std::move(pitch_map)}, settings_{settings}
+{
+    // Validates sample_rate, bpm and ticks_per_quarter.
+    (void)samples_to_ticks(0, settings_.sample_rate, settings_.bpm,
+                           settings_.ticks_per_quarter);
+
+    if (!(settings_.pitch_bend_range > 0.f))
+    {
+        throw std::invalid_argument("pitch_bend_range must be greater than 0");
+    }
+    if (settings_.group > 15 || settings_.channel > 15)
+    {
+        throw std::invalid_argument("UMP group and channel must be in [0, 15]");
+    }
+}
+
+auto UmpRenderer::render(std::span<MusicElement const> elements,
+                         SampleTime sample_offset,
+                         SampleTime sample_count,
+                         std::span<std::uint32_t> out) -> UmpResult
+{
+    voices_.clear();
+    note_offs_.clear();
+    pitch_bends_.fill(unsent);
+    sounding_.fill(0);
+
+    auto visitor = VoiceVisitor{voices_, SampleSpan{sample_offset, sample_count},
+                                pitch_map_, settings_.pitch_bend_range};
+    traverse(elements, visitor);
+
+    // Sorting on every field orders equal begins deterministically without the
+    // buffer a stable sort would allocate.
+    std::sort(voices_.begin(), voices_.end(), [](Voice const &a, Voice const &b) {
+        return std::tie(a.begin, a.end, a.note, a.pitch_bend, a.velocity) <
+               std::tie(b.begin, b.end, b.note, b.pitch_bend, b.velocity);
+    });
+
+    auto writer = Writer{settings_, out, sample_offset};
+    auto const write_note_offs = [&](SampleTime until) {
+        while (!note_offs_.empty() && note_offs_.front().end <= until)
+        {
+            std::pop_heap(note_offs_.begin(), note_offs_.end(), std::greater<>{});
+            auto const off = note_offs_.back();
+            note_offs_.pop_back();
+            --sounding_[key_index(off.channel, off.note)];
+            writer.advance(off.end);
+            writer.channel_voice_message(note_off, off.channel, off.note, 0);
+        }
+    };
+
+    for (auto const &voice : voices_)
+    {
+        write_note_offs(voice.begin);
+        writer.advance(voice.begin);
+
+        auto const channel = this->pick_channel(voice);
+        auto const key = key_index(channel, voice.note);
+        if (pitch_bends_[key] != voice.pitch_bend)
+        {
+            writer.channel_voice_message(per_note_pitch_bend, channel, voice.note,
+                                         voice.pitch_bend);
+            pitch_bends_[key] = voice.pitch_bend;
+        }
+        writer.channel_voice_message(note_on, channel, voice.note,
+                                     std::uint32_t{voice.velocity} << 16);
+        ++sounding_[key];
+
+        note_offs_.push_back(
+            NoteOff{.end = voice.end, .note = voice.note, .channel = channel});
+        std::push_heap(note_offs_.begin(), note_offs_.end(), std::greater<>{});
+    }
+    write_note_offs(std::numeric_limits<SampleTime>::max());
+
+    return {.word_count = writer.word_count(), .status = visitor.status()};
+}
+
+auto UmpRenderer::pick_channel(Voice const &voice) const -> std::uint8_t
+{
+    for (auto i = 0; i < 16; ++i)
+    {
+        auto const channel = static_cast<std::uint8_t>((settings_.channel + i) % 16);
+        auto const key = key_index(channel, voice.note);
+        if (sounding_[key] == 0 || pitch_bends_[key] == voice.pitch_bend)
+        {
+            return channel;
+        }
+    }
+    return settings_.channel;
+}
+
+} // namespace sequence::midi
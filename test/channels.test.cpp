@@ -0,0 +1,139 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include <sequence/channels.hpp>
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/tuning.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto note(std::uint32_t begin, std::uint32_t end) -> midi::TimedMidiNote
+{
+    return {.begin = begin, .end = end, .note = 60, .velocity = 100,
+            .pitch_bend = 8'192};
+}
+
+auto channels(std::vector<midi::TimedMidiNote> const &notes) -> std::vector<int>
+{
+    auto results = std::vector<int>{};
+    for (auto const &n : notes)
+    {
+        results.push_back(n.channel);
+    }
+    return results;
+}
+
+} // namespace
+
+TEST_CASE("allocate_channels assigns free channels by policy", "[channels]")
+{
+    auto notes = std::vector{note(0, 30), note(0, 100), note(0, 20), note(40, 50)};
+
+    SECTION("round robin")
+    {
+        auto const allocation = midi::ChannelAllocation{
+            .first_channel = 2,
+            .channel_count = 3,
+            .policy = midi::ChannelPolicy::round_robin,
+        };
+
+        REQUIRE(midi::allocate_channels(notes, allocation) == 0);
+        REQUIRE(channels(notes) == std::vector{2, 3, 4, 2});
+    }
+
+    SECTION("least recently used")
+    {
+        auto const allocation = midi::ChannelAllocation{
+            .first_channel = 2,
+            .channel_count = 3,
+            .policy = midi::ChannelPolicy::least_recently_used,
+        };
+
+        REQUIRE(midi::allocate_channels(notes, allocation) == 0);
+        // At 40, channel 2 has been silent since 30 and channel 4 since 20.
+        REQUIRE(channels(notes) == std::vector{2, 3, 4, 4});
+    }
+
+    SECTION("sounding notes never share a channel")
+    {
+        midi::allocate_channels(notes, {});
+
+        for (auto i = std::size_t{0}; i < notes.size(); ++i)
+        {
+            for (auto j = i + 1; j < notes.size(); ++j)
+            {
+                if (notes[j].begin < notes[i].end)
+                {
+                    REQUIRE(notes[i].channel != notes[j].channel);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("allocate_channels steals the oldest voice", "[channels]")
+{
+    auto notes = std::vector{note(0, 100), note(10, 100), note(20, 100), note(30, 40)};
+
+    auto const allocation = midi::ChannelAllocation{
+        .first_channel = 0,
+        .channel_count = 2,
+    };
+
+    REQUIRE(midi::allocate_channels(notes, allocation) == 2);
+    REQUIRE(channels(notes) == std::vector{0, 1, 0, 1});
+    REQUIRE(notes[0].end == 20);
+    REQUIRE(notes[1].end == 30);
+    REQUIRE(notes[2].end == 100);
+}
+
+TEST_CASE("allocate_channels validates its input", "[channels]")
+{
+    auto notes = std::vector{note(10, 20), note(0, 20)};
+
+    REQUIRE_THROWS_AS(midi::allocate_channels(notes, {}), std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        midi::allocate_channels({}, {.first_channel = 0, .channel_count = 0}),
+        std::invalid_argument);
+    REQUIRE_THROWS_AS(
+        midi::allocate_channels({}, {.first_channel = 10, .channel_count = 7}),
+        std::invalid_argument);
+}
+
+TEST_CASE("MPE zones exclude their manager channel", "[channels]")
+{
+    REQUIRE(midi::mpe_lower_zone(15) ==
+            midi::ChannelAllocation{
+                .first_channel = 1,
+                .channel_count = 15,
+                .policy = midi::ChannelPolicy::least_recently_used,
+            });
+    REQUIRE(midi::mpe_upper_zone(4, midi::ChannelPolicy::round_robin) ==
+            midi::ChannelAllocation{
+                .first_channel = 11,
+                .channel_count = 4,
+                .policy = midi::ChannelPolicy::round_robin,
+            });
+    REQUIRE_THROWS_AS(midi::mpe_lower_zone(0), std::invalid_argument);
+    REQUIRE_THROWS_AS(midi::mpe_upper_zone(16), std::invalid_argument);
+}
+
+TEST_CASE("allocate_channels separates rendered microtonal chords", "[channels]")
+{
+    auto const tuning = Tuning{{0.f, 150.f, 350.f, 500.f, 700.f, 850.f, 1050.f},
+                               1200.f, "neutral"};
+    auto const cell = Cell{{Note{.pitch = 0}, Note{.pitch = 1}, Note{.pitch = 2}}, 1.f};
+    auto notes = midi::flatten_to_midi(cell.elements, 0, 100, tuning, 440.f, 2.f);
+
+    midi::allocate_channels(notes, midi::mpe_lower_zone(15));
+
+    REQUIRE(channels(notes) == std::vector{1, 2, 3});
+    REQUIRE(notes[0].pitch_bend != notes[1].pitch_bend);
+}
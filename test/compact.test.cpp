@@ -0,0 +1,104 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <vector>
+
+#include <sequence/compact.hpp>
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/tuning.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto note(SampleTime begin, SampleTime end, std::uint8_t key = 60)
+    -> midi::TimedMidiNote
+{
+    return {.begin = begin, .end = end, .note = key, .velocity = 100,
+            .pitch_bend = 8'192};
+}
+
+} // namespace
+
+TEST_CASE("compact_notes drops and merges redundant notes", "[compact]")
+{
+    SECTION("zero length notes are dropped")
+    {
+        auto notes = std::vector{note(0, 10), note(5, 5), note(8, 2)};
+
+        REQUIRE(midi::compact_notes(notes) == 2);
+        REQUIRE(notes == std::vector{note(0, 10)});
+    }
+
+    SECTION("overlapping identical notes are merged")
+    {
+        auto notes = std::vector{note(20, 30), note(0, 10), note(5, 25), note(40, 50)};
+
+        REQUIRE(midi::compact_notes(notes) == 2);
+        REQUIRE(notes == std::vector{note(0, 30), note(40, 50)});
+    }
+
+    SECTION("touching and differing notes are kept")
+    {
+        auto bent = note(5, 15);
+        bent.pitch_bend = 9'000;
+        auto other_channel = note(5, 15);
+        other_channel.channel = 1;
+        auto softer = note(5, 15);
+        softer.velocity = 50;
+
+        auto notes = std::vector{note(0, 10), note(10, 20), note(5, 15, 62), bent,
+                                 other_channel, softer};
+        auto const expected = notes;
+
+        REQUIRE(midi::compact_notes(notes) == 0);
+        REQUIRE(notes == std::vector{expected[0], expected[2], expected[3], expected[4],
+                                     expected[5], expected[1]});
+    }
+}
+
+TEST_CASE("remove_redundant_pitch_bends keeps only bend changes", "[compact]")
+{
+    using Kind = midi::MidiEvent::Kind;
+
+    auto const bend = [](SampleTime time, std::uint16_t value, std::uint8_t channel) {
+        return midi::MidiEvent{.time = time, .kind = Kind::pitch_bend, .note = 60,
+                               .velocity = 100, .pitch_bend = value,
+                               .channel = channel};
+    };
+    auto const on = [](SampleTime time) {
+        return midi::MidiEvent{.time = time, .kind = Kind::note_on, .note = 60,
+                               .velocity = 100, .pitch_bend = 8'192};
+    };
+
+    auto events = std::vector{bend(0, 8'192, 0), on(0), bend(10, 8'192, 0), on(10),
+                              bend(10, 8'192, 1), bend(20, 9'000, 0), on(20),
+                              bend(30, 9'000, 0), bend(30, 8'192, 1)};
+
+    REQUIRE(midi::remove_redundant_pitch_bends(events) == 3);
+    REQUIRE(events == std::vector{bend(0, 8'192, 0), on(0), on(10), bend(10, 8'192, 1),
+                                  bend(20, 9'000, 0), on(20)});
+}
+
+TEST_CASE("compaction shrinks rendered repeated material", "[compact]")
+{
+    auto const pitch_map =
+        midi::PitchMap{Tuning{{0.f, 150.f, 350.f}, 1200.f, ""}, 440.f, 2.f};
+    auto bar = Sequence{};
+    for (auto i = 0; i < 16; ++i)
+    {
+        auto const gate = i % 4 == 3 ? 0.f : 1.f;
+        bar.cells.push_back(Cell{{Note{.pitch = 1, .gate = gate}}, 1.f});
+    }
+    auto const elements = std::vector<MusicElement>{bar, Note{.pitch = 1}};
+
+    auto notes = midi::flatten_to_midi(elements, 0, 16'000, pitch_map);
+    REQUIRE(midi::compact_notes(notes) == 4 + 12);
+    REQUIRE(notes.size() == 1);
+    REQUIRE(notes[0].end == 16'000);
+
+    auto events = midi::flatten_to_midi_events(elements, 0, 16'000, pitch_map);
+    REQUIRE(midi::remove_redundant_pitch_bends(events) == 12);
+}
@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#include <sequence/flat.hpp>
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto nested_cell() -> Cell
+{
+    return Cell{
+        .elements =
+            {
+                Note{.pitch = 9, .velocity = 0.4f},
+                Sequence{{
+                    Cell{{Note{.pitch = 0}}, 1.f},
+                    Cell{{}, 2.f},
+                    Cell{{Sequence{{Cell{{Note{.pitch = 1}, Note{.pitch = 5}}, 1.f},
+                                    Cell{{Note{.pitch = 2, .gate = 0.5f}}, 1.f}}}},
+                         1.f},
+                }},
+            },
+        .weight = 3.f,
+    };
+}
+
+auto twelve_edo() -> Tuning
+{
+    return Tuning{
+        {0.f, 100.f, 200.f, 300.f, 400.f, 500.f, 600.f, 700.f, 800.f, 900.f, 1000.f,
+         1100.f},
+        1200.f,
+        "12edo",
+    };
+}
+
+} // namespace
+
+TEST_CASE("to_flat stores the tree in contiguous arrays", "[flat]")
+{
+    auto const flat = to_flat(nested_cell());
+
+    REQUIRE(flat.cells.size() == 6);
+    REQUIRE(flat.elements.size() == 7);
+    REQUIRE(flat.notes.size() == 5);
+    REQUIRE(flat.sequences.size() == 2);
+
+    REQUIRE(flat.cells[0].weight == 3.f);
+    REQUIRE(flat.cells[0].elements_begin == 0);
+    REQUIRE(flat.cells[0].elements_count == 2);
+
+    SECTION("children are stored after their parent")
+    {
+        for (auto i = std::size_t{0}; i < flat.cells.size(); ++i)
+        {
+            auto const &cell = flat.cells[i];
+            for (auto e = cell.elements_begin;
+                 e < cell.elements_begin + cell.elements_count; ++e)
+            {
+                auto const &element = flat.elements[e];
+                if (element.kind == FlatSequence::ElementNode::Kind::Sequence)
+                {
+                    REQUIRE(flat.sequences[element.index].cells_begin > i);
+                }
+            }
+        }
+    }
+}
+
+TEST_CASE("from_flat round trips through to_flat", "[flat]")
+{
+    SECTION("nested cell")
+    {
+        auto const cell = nested_cell();
+
+        REQUIRE(from_flat(to_flat(cell)) == cell);
+    }
+
+    SECTION("silent cell")
+    {
+        auto const cell = Cell{.elements = {}, .weight = 0.5f};
+
+        REQUIRE(from_flat(to_flat(cell)) == cell);
+    }
+
+    SECTION("empty flat sequence")
+    {
+        REQUIRE(from_flat(FlatSequence{}) == Cell{});
+    }
+}
+
+TEST_CASE("flatten_to_midi renders a FlatSequence", "[flat][midi]")
+{
+    auto const cell = nested_cell();
+    auto const tuning = twelve_edo();
+
+    auto expected = midi::flatten_to_midi(cell.elements, 10, 1'000, tuning, 440.f, 1.f);
+    auto actual = midi::flatten_to_midi(to_flat(cell), 10, 1'000, tuning, 440.f, 1.f);
+
+    auto const by_time = [](midi::TimedMidiNote const &a,
+                            midi::TimedMidiNote const &b) {
+        return a.begin != b.begin ? a.begin < b.begin : a.note < b.note;
+    };
+    std::ranges::sort(expected, by_time);
+    std::ranges::sort(actual, by_time);
+
+    REQUIRE(actual == expected);
+
+    SECTION("throws on zero total weight")
+    {
+        auto const invalid = Cell{.elements = {Sequence{{Cell{{Note{}}, 0.f}}}}};
+
+        REQUIRE_THROWS_AS(
+            midi::flatten_to_midi(to_flat(invalid), 0, 100, tuning, 440.f, 1.f),
+            std::invalid_argument);
+    }
+}
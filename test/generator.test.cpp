@@ -0,0 +1,110 @@
+#include "catch.hpp"
+
+#include <iterator>
+#include <ranges>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sequence/generator.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto count(int n, int *resumed = nullptr) -> Generator<int>
+{
+    for (auto i = 0; i < n; ++i)
+    {
+        if (resumed != nullptr)
+        {
+            ++*resumed;
+        }
+        co_yield i;
+    }
+}
+
+auto fail_after(int n) -> Generator<std::string>
+{
+    for (auto i = 0; i < n; ++i)
+    {
+        co_yield std::to_string(i);
+    }
+    throw std::runtime_error{"failed"};
+}
+
+} // namespace
+
+static_assert(std::ranges::input_range<Generator<int>>);
+
+TEST_CASE("Generator yields values lazily", "[generator]")
+{
+    SECTION("iterates every value")
+    {
+        auto values = std::vector<int>{};
+        for (auto const value : count(5))
+        {
+            values.push_back(value);
+        }
+
+        REQUIRE(values == std::vector{0, 1, 2, 3, 4});
+    }
+
+    SECTION("empty generators")
+    {
+        auto generator = count(0);
+
+        REQUIRE(generator.begin() == generator.end());
+    }
+
+    SECTION("runs only as far as it is advanced")
+    {
+        auto resumed = 0;
+        auto generator = count(1'000, &resumed);
+
+        REQUIRE(resumed == 0);
+
+        auto it = generator.begin();
+        ++it;
+        ++it;
+
+        REQUIRE(*it == 2);
+        REQUIRE(resumed == 3);
+    }
+
+    SECTION("works with range adaptors")
+    {
+        auto values = std::vector<int>{};
+        for (auto const value : count(10) | std::views::filter([](int i) {
+                                    return i % 3 == 0;
+                                }))
+        {
+            values.push_back(value);
+        }
+
+        REQUIRE(values == std::vector{0, 3, 6, 9});
+    }
+
+    SECTION("moves transfer the coroutine")
+    {
+        auto a = count(3);
+        auto b = std::move(a);
+        auto it = b.begin();
+
+        REQUIRE(*it == 0);
+    }
+}
+
+TEST_CASE("Generator rethrows exceptions from the coroutine", "[generator]")
+{
+    auto generator = fail_after(2);
+    auto it = generator.begin();
+
+    REQUIRE(*it == "0");
+    REQUIRE(it->size() == 1);
+    ++it;
+    REQUIRE(*it == "1");
+    REQUIRE_THROWS_AS(++it, std::runtime_error);
+    REQUIRE(it == generator.end());
+}
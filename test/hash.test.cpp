@@ -0,0 +1,133 @@
+#include "catch.hpp"
+
+#include <cstddef>
+#include <variant>
+#include <vector>
+
+#include <sequence/hash.hpp>
+#include <sequence/modify.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+
+#include "helper.hpp"
+
+using namespace sequence;
+
+namespace
+{
+
+auto phrase() -> Sequence
+{
+    return Sequence{{
+        Cell{{Note{.pitch = 0}}, 1.f},
+        Cell{{Note{.pitch = 4}, Note{.pitch = 7}}, 1.f},
+        Cell{{Sequence{{Cell{{Note{.pitch = 2}}, 1.f}, Cell{{}, 1.f}}}}, 2.f},
+    }};
+}
+
+auto sequence_at(PersistentCell const &cell, std::size_t element)
+    -> PersistentSequencePtr const &
+{
+    return std::get<PersistentSequencePtr>(cell.elements[element]);
+}
+
+} // namespace
+
+TEST_CASE("hash is consistent with operator==", "[hash]")
+{
+    auto const a = Cell{{phrase()}, 1.f};
+
+    SECTION("values within tolerance hash equal")
+    {
+        auto b = a;
+        b = modify::shift_velocity(b, {0, {1}}, 0.00001f);
+        b.weight += 0.00001f;
+
+        REQUIRE(b == a);
+        REQUIRE(hash(b) == hash(a));
+    }
+
+    SECTION("structure and pitch change the hash")
+    {
+        REQUIRE(hash(modify::shift_pitch(a, {0, {1}}, 1)) != hash(a));
+        REQUIRE(hash(Cell{{Note{}, phrase()}, 1.f}) != hash(a));
+        REQUIRE(hash(Cell{{Note{.pitch = 1}}, 1.f}) !=
+                hash(Cell{{Sequence{{Cell{{Note{.pitch = 1}}, 1.f}}}}, 1.f}));
+    }
+
+    SECTION("persistent trees hash like the Cell tree")
+    {
+        REQUIRE(hash(to_persistent(a)) == hash(a));
+        REQUIRE(hash(phrase()) == hash(*sequence_at(to_persistent(a), 0)));
+    }
+}
+
+TEST_CASE("Interner shares equal subtrees", "[hash]")
+{
+    auto interner = Interner{};
+
+    SECTION("repeated material is stored once")
+    {
+        auto const cell = Cell{{phrase(), phrase(), Note{}}, 1.f};
+        auto const interned = interner.intern(cell);
+
+        REQUIRE(sequence_at(interned, 0) == sequence_at(interned, 1));
+        REQUIRE(to_cell(interned) == cell);
+        // phrase() and its one nested sequence.
+        REQUIRE(interner.size() == 2);
+    }
+
+    SECTION("interning across trees and representations")
+    {
+        auto const first = interner.intern(Cell{{phrase()}, 1.f});
+        auto const second = interner.intern(to_persistent(Cell{{phrase()}, 2.f}));
+
+        REQUIRE(sequence_at(first, 0) == sequence_at(second, 0));
+        REQUIRE(second.weight == 2.f);
+    }
+
+    SECTION("different subtrees stay distinct")
+    {
+        auto const cell =
+            Cell{{phrase(), modify::set_gate(Cell{{phrase()}, 1.f}, {0, {1}}, 0.5f)
+                                .elements.front()},
+                 1.f};
+        auto const interned = interner.intern(cell);
+
+        REQUIRE(sequence_at(interned, 0) != sequence_at(interned, 1));
+        REQUIRE(to_cell(interned) == cell);
+    }
+
+    SECTION("clear releases the table")
+    {
+        auto const interned = interner.intern(Cell{{phrase()}, 1.f});
+        interner.clear();
+
+        REQUIRE(interner.size() == 0);
+        REQUIRE(sequence_at(interned, 0).use_count() == 1);
+    }
+}
+
+TEST_CASE("Interner handles deeply nested persistent trees", "[hash]")
+{
+    auto constexpr depth = std::size_t{5'000};
+    auto const original = to_persistent(test::helper::deep_tree(depth));
+
+    auto interner = Interner{};
+    auto const interned = interner.intern(original);
+
+    // Every level holds a chain of a different length, so no two nodes are equal.
+    REQUIRE(interner.size() == depth);
+    REQUIRE(hash(interned) == hash(original));
+
+    auto census = test::helper::TreeCensus{};
+    traverse(interned, census);
+
+    REQUIRE(census.sequences == depth);
+    REQUIRE(census.pitches == std::vector<int>{0});
+
+    auto const again = interner.intern(interned);
+
+    REQUIRE(sequence_at(again, 0) == sequence_at(interned, 0));
+    REQUIRE(interner.size() == depth);
+}
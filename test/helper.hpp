@@ -1,14 +1,16 @@
 #pragma once
 
 #include <concepts>
+#include <cstddef>
 #include <iostream>
 #include <string>
-#include <type_traits>
+#include <utility>
 #include <variant>
+#include <vector>
 
 #include <sequence/midi.hpp>
 #include <sequence/sequence.hpp>
-#include <sequence/utility.hpp>
+#include <sequence/traverse.hpp>
 
 namespace sequence::test::helper
 {
@@ -60,95 +62,134 @@ concept NoteChecker = requires(Fn fn, Note const &note) {
     { fn(note) } -> std::same_as<void>;
 };
 
+template <typename Fn>
+struct NoteVisitor
+{
+    Fn &fn;
+
+    template <typename NoteT>
+    auto note(NoteT &note) -> void
+    {
+        fn(note);
+    }
+};
+
 template <NoteChecker Fn>
 auto check_sequence(MusicElement const &element, Fn &&checker) -> void
 {
-    using namespace sequence::utility;
-
-    std::visit(overload{
-                   [&checker](Note const &note) { checker(note); },
-                   [&checker](Sequence const &seq) {
-                       for (auto const &cell : seq.cells)
-                       {
-                           for (auto const &nested : cell.elements)
-                           {
-                               check_sequence(nested, checker);
-                           }
-                       }
-                   },
-               },
-               element);
+    traverse(element, NoteVisitor<Fn>{checker});
 }
 
 template <NoteChecker Fn>
 auto check_sequence(Cell const &cell, Fn &&checker) -> void
 {
-    for (auto const &element : cell.elements)
-    {
-        check_sequence(element, checker);
-    }
+    traverse(cell, NoteVisitor<Fn>{checker});
 }
 
 template <typename Fn>
 auto modify_notes(MusicElement &element, Fn &&modifier) -> void
 {
-    using namespace sequence::utility;
-
-    std::visit(overload{
-                   [&modifier](Note &note) { modifier(note); },
-                   [&modifier](Sequence &seq) {
-                       for (auto &cell : seq.cells)
-                       {
-                           modify_notes(cell, modifier);
-                       }
-                   },
-               },
-               element);
+    traverse(element, NoteVisitor<Fn>{modifier});
 }
 
 template <typename Fn>
 auto modify_notes(Cell &cell, Fn &&modifier) -> void
 {
-    for (auto &element : cell.elements)
+    traverse(cell, NoteVisitor<Fn>{modifier});
+}
+
+class PrintVisitor
+{
+  public:
+    explicit PrintVisitor(int indent) : indent_{indent}
     {
-        modify_notes(element, modifier);
     }
-}
+
+    auto note(Note const &note) -> void
+    {
+        std::cout << std::string(indent_ * 2, ' ');
+        std::cout << "Note(pitch=" << note.pitch << ", velocity=" << note.velocity
+                  << ", delay=" << note.delay << ", gate=" << note.gate << ")\n";
+    }
+
+    auto enter_sequence(Sequence const &) -> void
+    {
+        std::cout << std::string(indent_ * 2, ' ') << "Sequence(\n";
+        ++indent_;
+    }
+
+    auto exit_sequence(Sequence const &) -> void
+    {
+        --indent_;
+        std::cout << std::string(indent_ * 2, ' ') << ")\n";
+    }
+
+    auto enter_cell(Cell const &cell) -> void
+    {
+        std::cout << std::string(indent_ * 2, ' ') << "Cell(weight=" << cell.weight
+                  << ", elements=" << cell.elements.size() << ")\n";
+        ++indent_;
+    }
+
+    auto exit_cell(Cell const &) -> void
+    {
+        --indent_;
+    }
+
+  private:
+    int indent_;
+};
 
 inline auto print_sequence(MusicElement const &element, int indent = 0) -> void
 {
-    using namespace sequence::utility;
-
-    std::visit(overload{
-                   [&](Note const &note) {
-                       std::cout << std::string(indent * 2, ' ');
-                       std::cout << "Note(pitch=" << note.pitch
-                                 << ", velocity=" << note.velocity
-                                 << ", delay=" << note.delay << ", gate=" << note.gate
-                                 << ")\n";
-                   },
-                   [&](Sequence const &seq) {
-                       std::cout << std::string(indent * 2, ' ') << "Sequence(\n";
-                       for (auto const &cell : seq.cells)
-                       {
-                           print_sequence(cell, indent + 1);
-                       }
-                       std::cout << std::string(indent * 2, ' ') << ")\n";
-                   },
-               },
-               element);
+    traverse(element, PrintVisitor{indent});
 }
 
 inline auto print_sequence(Cell const &cell, int indent = 0) -> void
 {
-    std::cout << std::string(indent * 2, ' ') << "Cell(weight=" << cell.weight
-              << ", elements=" << cell.elements.size() << ")\n";
-    for (auto const &element : cell.elements)
+    auto visitor = PrintVisitor{indent};
+    visitor.enter_cell(cell);
+    traverse(cell, visitor);
+}
+
+/**
+ * @brief Builds a chain of \p depth nested single-cell sequences around one note.
+ *
+ * Built with moves only, as copying a tree this deep is itself recursive.
+ */
+inline auto deep_tree(std::size_t depth) -> Cell
+{
+    auto cell = Cell{{Note{.pitch = 0}}, 1.f};
+    for (auto i = std::size_t{0}; i < depth; ++i)
     {
-        print_sequence(element, indent + 1);
+        auto seq = Sequence{};
+        seq.cells.push_back(std::move(cell));
+        cell = Cell{};
+        cell.elements.push_back(std::move(seq));
     }
+    return cell;
 }
 
+/**
+ * @brief Counts the sequences and collects the note pitches of a Cell or PersistentCell
+ * tree, for checking trees too deep to compare with operator==.
+ */
+struct TreeCensus
+{
+    std::size_t sequences = 0;
+    std::vector<int> pitches;
+
+    auto note(Note const &note) -> void
+    {
+        pitches.push_back(note.pitch);
+    }
+
+    auto enter_sequence(auto const &) -> void
+    {
+        ++sequences;
+    }
+};
+
 inline auto print_midi_timeline(std::vector<midi::TimedMidiNote> const &timeline)
     -> void
 {
@@ -0,0 +1,186 @@
+#include "catch.hpp"
+
+#include <array>
+#include <variant>
+#include <stdexcept>
+#include <vector>
+
+#include <sequence/incremental.hpp>
+#include <sequence/midi.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/tuning.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto pitch_map() -> midi::PitchMap
+{
+    return midi::PitchMap{
+        Tuning{{0.f, 200.f, 400.f, 500.f, 700.f, 900.f, 1100.f}, 1200.f, "major"},
+        440.f, 2.f};
+}
+
+/**
+ * @brief Eight bars, each a Sequence of three cells with one nested Sequence.
+ */
+auto song() -> Cell
+{
+    auto bars = Sequence{};
+    for (auto i = 0; i < 8; ++i)
+    {
+        bars.cells.push_back(Cell{
+            {Sequence{{
+                Cell{{Note{.pitch = i}}, 1.f},
+                Cell{{Note{.pitch = i + 2, .gate = 0.5f}, Note{.pitch = i + 4}}, 1.f},
+                Cell{{Sequence{{Cell{{Note{.pitch = -i}}, 1.f}, Cell{{}, 2.f}}}}, 2.f},
+            }}},
+            1.f,
+        });
+    }
+    return Cell{{Note{.pitch = 0, .gate = 0.1f}, bars}, 1.f};
+}
+
+auto expected(PersistentCell const &cell) -> std::vector<midi::TimedMidiNote>
+{
+    return midi::flatten_to_midi(to_cell(cell).elements, 100, 48'000, pitch_map());
+}
+
+auto expected_at(PersistentCell const &cell, SampleTime count)
+    -> std::vector<midi::TimedMidiNote>
+{
+    return midi::flatten_to_midi(to_cell(cell).elements, 0, count, pitch_map());
+}
+
+} // namespace
+
+TEST_CASE("IncrementalRenderer re-renders only changed subtrees", "[incremental]")
+{
+    auto renderer = midi::IncrementalRenderer{pitch_map()};
+    auto const original = to_persistent(song());
+
+    // 1 root, 8 bars and 8 nested sequences.
+    REQUIRE(renderer.render(original, 100, 48'000) == expected(original));
+    REQUIRE(renderer.nodes_rendered() == 17);
+
+    SECTION("rendering again reuses every node")
+    {
+        REQUIRE(renderer.render(original, 100, 48'000) == expected(original));
+        REQUIRE(renderer.nodes_rendered() == 0);
+    }
+
+    SECTION("an edit renders the nodes along its path")
+    {
+        auto const path = std::array{PathStep{1, 3}, PathStep{0, 1}};
+        auto const replacement = PersistentCell{.elements = {Note{.pitch = 9}}};
+        auto const edited = replace_cell(original, path, replacement);
+
+        REQUIRE(renderer.render(edited, 100, 48'000) == expected(edited));
+        REQUIRE(renderer.nodes_rendered() == 2);
+
+        // Undo.
+        REQUIRE(renderer.render(original, 100, 48'000) == expected(original));
+        REQUIRE(renderer.nodes_rendered() == 0);
+    }
+
+    SECTION("a new offset reuses every node")
+    {
+        REQUIRE(renderer.render(original, 5'000, 48'000) ==
+                midi::flatten_to_midi(to_cell(original).elements, 5'000, 48'000,
+                                      pitch_map()));
+        REQUIRE(renderer.nodes_rendered() == 0);
+    }
+
+    SECTION("a new length renders every node")
+    {
+        REQUIRE(renderer.render(original, 0, 1'000) ==
+                midi::flatten_to_midi(to_cell(original).elements, 0, 1'000,
+                                      pitch_map()));
+        REQUIRE(renderer.nodes_rendered() == 17);
+    }
+
+    SECTION("clear releases the cache")
+    {
+        renderer.clear();
+
+        REQUIRE(renderer.cache_size() == 0);
+        REQUIRE(renderer.render(original, 100, 48'000) == expected(original));
+        REQUIRE(renderer.nodes_rendered() == 17);
+    }
+}
+
+TEST_CASE("IncrementalRenderer releases nodes no tree holds", "[incremental]")
+{
+    auto renderer = midi::IncrementalRenderer{pitch_map()};
+    auto tree = to_persistent(song());
+
+    for (auto i = 0; i < 50; ++i)
+    {
+        auto const path = std::array{PathStep{1, 0}};
+        tree = replace_cell(tree, path, to_persistent(song()));
+        REQUIRE(renderer.render(tree, 100, 48'000) == expected(tree));
+    }
+
+    // Every edit replaces 18 of the 32 nodes of the tree, without pruning the cache
+    // would hold over 900.
+    REQUIRE(renderer.cache_size() < 100);
+}
+
+TEST_CASE("IncrementalRenderer keeps only the spans it still renders at",
+          "[incremental]")
+{
+    auto renderer = midi::IncrementalRenderer{pitch_map()};
+    auto const tree = to_persistent(song());
+
+    SECTION("a changing length replaces the cached spans")
+    {
+        for (auto count = SampleTime{48'000}; count < 49'000; count += 20)
+        {
+            REQUIRE(renderer.render(tree, 100, count) ==
+                    midi::flatten_to_midi(to_cell(tree).elements, 100, count,
+                                          pitch_map()));
+        }
+
+        REQUIRE(renderer.cache_size() == 17);
+        REQUIRE(renderer.render_count() == 17);
+    }
+
+    SECTION("a node repeated at one length is rendered once")
+    {
+        auto const bar = std::get<PersistentSequencePtr>(tree.elements[1])->cells[0];
+        auto const repeated =
+            PersistentCell{{make_persistent_sequence({bar, bar, bar})}, 1.f};
+
+        // The root, the bar and its nested sequence.
+        REQUIRE(renderer.render(repeated, 0, 3'000) == expected_at(repeated, 3'000));
+        REQUIRE(renderer.nodes_rendered() == 3);
+        REQUIRE(renderer.render_count() == 3);
+    }
+
+    SECTION("a node shared at several lengths keeps each of them")
+    {
+        auto const bar = std::get<PersistentSequencePtr>(tree.elements[1])->cells[0];
+        auto wide = bar;
+        wide.weight = 2.f;
+        auto const repeated =
+            PersistentCell{{make_persistent_sequence({bar, bar, wide})}, 1.f};
+
+        // The root, and the bar and its nested sequence at 750 and 1'500 samples.
+        REQUIRE(renderer.render(repeated, 0, 3'000) == expected_at(repeated, 3'000));
+        REQUIRE(renderer.nodes_rendered() == 5);
+        REQUIRE(renderer.render_count() == 5);
+
+        REQUIRE(renderer.render(repeated, 0, 3'000) == expected_at(repeated, 3'000));
+        REQUIRE(renderer.nodes_rendered() == 0);
+    }
+}
+
+TEST_CASE("IncrementalRenderer validates sequence weights", "[incremental]")
+{
+    auto renderer = midi::IncrementalRenderer{pitch_map()};
+    auto const invalid = to_persistent(Cell{{Sequence{{Cell{{Note{}}, 0.f}}}}, 1.f});
+
+    REQUIRE_THROWS_AS(renderer.render(invalid, 0, 100), std::invalid_argument);
+}
@@ -1,5 +1,7 @@
 #include "catch.hpp"
 
+#include <stdexcept>
+
 #include <sequence/timing.hpp>
 
 TEST_CASE("samples_count", "[timing]")
@@ -36,3 +38,70 @@ TEST_CASE("samples_count", "[timing]")
                           std::invalid_argument);
     }
 }
+
+TEST_CASE("samples_to_ticks", "[timing]")
+{
+    using namespace sequence;
+
+    SECTION("a measure of samples is a measure of quarter notes")
+    {
+        auto const bar = samples_count(TimeSignature{4, 4}, 44'100, 120.f);
+
+        REQUIRE(samples_to_ticks(bar, 44'100, 120.f, 480) == 4 * 480);
+        REQUIRE(samples_to_ticks(0, 44'100, 120.f, 480) == 0);
+    }
+
+    SECTION("rounds to the nearest tick")
+    {
+        // A tick is 22'050 / 96 = 229.6875 samples.
+        REQUIRE(samples_to_ticks(114, 44'100, 120.f, 96) == 0);
+        REQUIRE(samples_to_ticks(115, 44'100, 120.f, 96) == 1);
+        REQUIRE(samples_to_ticks(48'000 * 60, 48'000, 90.f, 960) == 90 * 960);
+    }
+
+    SECTION("throws on invalid arguments")
+    {
+        REQUIRE_THROWS_AS(samples_to_ticks(0, 0, 120.f, 480), std::invalid_argument);
+        REQUIRE_THROWS_AS(samples_to_ticks(0, 44'100, 0.f, 480), std::invalid_argument);
+        REQUIRE_THROWS_AS(samples_to_ticks(0, 44'100, 120.f, 0), std::invalid_argument);
+    }
+}
+
+TEST_CASE("Subdivision", "[timing]")
+{
+    using namespace sequence;
+
+    SECTION("rounds boundaries to the nearest sample")
+    {
+        auto subdivision = Subdivision{{.offset = 5, .count = 10}, 3., 3};
+
+        REQUIRE(subdivision.next(1.f) == SampleSpan{5, 3});
+        REQUIRE(subdivision.next(1.f) == SampleSpan{8, 4});
+        REQUIRE(subdivision.next(1.f) == SampleSpan{12, 3});
+    }
+
+    SECTION("boundaries do not drift across many siblings")
+    {
+        // Past the range of 32-bit sample positions.
+        auto const span = SampleSpan{.offset = SampleTime{1} << 40,
+                                     .count = 1'000'000'007};
+        auto subdivision = Subdivision{span, 10'000., 10'000};
+
+        auto begin = span.offset;
+        for (auto i = 1; i <= 10'000; ++i)
+        {
+            auto const child = subdivision.next(1.f);
+            REQUIRE(child.offset == begin);
+
+            // The exact rational boundary, rounded half up.
+            begin = span.offset + (span.count * SampleTime(i) * 2 + 10'000) / 20'000;
+            REQUIRE(child.offset + child.count == begin);
+        }
+        REQUIRE(begin == span.offset + span.count);
+    }
+
+    SECTION("throws if the total weight is not positive")
+    {
+        REQUIRE_THROWS_AS((Subdivision{{0, 10}, 0., 1}), std::invalid_argument);
+    }
+}
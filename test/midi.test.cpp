@@ -1,7 +1,15 @@
 #include "catch.hpp"
 
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <utility>
 #include <vector>
 
+#include <sequence/flat.hpp>
+#include <sequence/lazy_midi.hpp>
 #include <sequence/midi.hpp>
 #include <sequence/sequence.hpp>
 
@@ -426,6 +434,26 @@ TEST_CASE("flatten_to_midi subdivides sequences by weight", "[midi]")
     }
 }
 
+TEST_CASE("flatten_to_midi renders 64-bit sample positions", "[midi]")
+{
+    auto const tuning = twelve_edo();
+    // A week of samples at 192 kHz, past the range of 32-bit positions.
+    auto const offset = SampleTime{192'000} * 60 * 60 * 24 * 7;
+    auto const elements = std::vector<MusicElement>{Sequence{{
+        Cell{{Note{.pitch = 0}}, 1.f},
+        Cell{{Note{.pitch = 0, .delay = 0.5f}}, 1.f},
+    }}};
+
+    auto const actual = midi::flatten_to_midi(elements, offset, 400'000, tuning,
+                                              base_frequency, pb_range);
+
+    REQUIRE(actual.size() == 2);
+    REQUIRE(actual[0].begin == offset);
+    REQUIRE(actual[0].end == offset + 200'000);
+    REQUIRE(actual[1].begin == offset + 300'000);
+    REQUIRE(actual[1].end == offset + 400'000);
+}
+
 TEST_CASE("flatten_to_midi handles nested simultaneous and sequential structure",
           "[midi]")
 {
@@ -442,3 +470,461 @@ TEST_CASE("flatten_to_midi handles nested simultaneous and sequential structure"
             {.begin = 30, .end = 50, .note = 73, .velocity = 88, .pitch_bend = 8'192},
         });
 }
+
+TEST_CASE("flatten_to_midi renders into caller-supplied buffers", "[midi]")
+{
+    auto const tuning = twelve_edo();
+    auto const elements = std::vector<MusicElement>{
+        Note{.pitch = 0},
+        Sequence{{
+            Cell{{Note{.pitch = 1}}, 1.f},
+            Cell{{Note{.pitch = 2}, Note{.pitch = 3}}, 1.f},
+        }},
+    };
+    auto const expected =
+        midi::flatten_to_midi(elements, 0, 1'000, tuning, base_frequency, pb_range);
+
+    SECTION("appends to a vector")
+    {
+        auto out = std::vector<midi::TimedMidiNote>{expected.front()};
+        out.reserve(16);
+        auto const *const data = out.data();
+
+        midi::flatten_to_midi(elements, 0, 1'000, tuning, base_frequency, pb_range,
+                              out);
+
+        REQUIRE(out.data() == data);
+        REQUIRE(out.size() == expected.size() + 1);
+        REQUIRE(std::equal(expected.begin(), expected.end(), out.begin() + 1));
+    }
+
+    SECTION("fills a span and reports the capacity needed")
+    {
+        auto buffer = std::vector<midi::TimedMidiNote>(expected.size());
+
+        REQUIRE(midi::flatten_to_midi(elements, 0, 1'000, tuning, base_frequency,
+                                      pb_range, std::span{buffer}) == expected.size());
+        REQUIRE(buffer == expected);
+
+        auto small = std::vector<midi::TimedMidiNote>(2);
+
+        REQUIRE(midi::flatten_to_midi(elements, 0, 1'000, tuning, base_frequency,
+                                      pb_range, std::span{small}) == expected.size());
+        REQUIRE(small[0] == expected[0]);
+        REQUIRE(small[1] == expected[1]);
+    }
+}
+
+TEST_CASE("PitchMap renders the same notes as the Tuning overloads", "[midi]")
+{
+    auto const tuning = GENERATE(twelve_edo(), grail_tuning());
+    auto const pitch_map = midi::PitchMap{tuning, base_frequency, pb_range};
+
+    SECTION("every pitch maps like create_midi_note, inside and outside the table")
+    {
+        auto elements = std::vector<MusicElement>{};
+        for (auto pitch = -1'000; pitch <= 1'000; ++pitch)
+        {
+            elements.push_back(Note{.pitch = pitch});
+        }
+        elements.push_back(Note{.pitch = -1'000'000});
+        elements.push_back(Note{.pitch = 1'000'000});
+
+        REQUIRE(midi::flatten_to_midi(elements, 0, 100, pitch_map) ==
+                midi::flatten_to_midi(elements, 0, 100, tuning, base_frequency,
+                                      pb_range));
+    }
+
+    SECTION("every overload accepts a PitchMap")
+    {
+        auto const cell = Cell{
+            {
+                Note{.pitch = 3},
+                Sequence{{
+                    Cell{{Note{.pitch = -13}}, 1.f},
+                    Cell{{Note{.pitch = 25}, Note{.pitch = 7}}, 2.f},
+                }},
+            },
+            1.f,
+        };
+        auto const expected = midi::flatten_to_midi(cell.elements, 10, 1'000, tuning,
+                                                    base_frequency, pb_range);
+
+        REQUIRE(midi::flatten_to_midi(cell.elements, 10, 1'000, pitch_map) ==
+                expected);
+
+        auto out = std::vector<midi::TimedMidiNote>{};
+        midi::flatten_to_midi(cell.elements, 10, 1'000, pitch_map, out);
+        REQUIRE(out == expected);
+
+        auto buffer = std::vector<midi::TimedMidiNote>(expected.size());
+        REQUIRE(midi::flatten_to_midi(cell.elements, 10, 1'000, pitch_map,
+                                      std::span{buffer}) == expected.size());
+        REQUIRE(buffer == expected);
+
+        REQUIRE(midi::flatten_to_midi(to_flat(cell), 10, 1'000, pitch_map) ==
+                midi::flatten_to_midi(to_flat(cell), 10, 1'000, tuning,
+                                      base_frequency, pb_range));
+        REQUIRE(midi::flatten_to_midi({}, 0, 100, pitch_map).empty());
+    }
+}
+
+TEST_CASE("PitchMap validates its arguments", "[midi]")
+{
+    REQUIRE_THROWS_AS((midi::PitchMap{Tuning{}, base_frequency, pb_range}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS((midi::PitchMap{twelve_edo(), 0.f, pb_range}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS((midi::PitchMap{twelve_edo(), base_frequency, 0.f}),
+                      std::invalid_argument);
+}
+
+TEST_CASE("try_flatten_to_midi reports invalid sequences without throwing", "[midi]")
+{
+    auto const pitch_map = midi::PitchMap{twelve_edo(), base_frequency, pb_range};
+    auto buffer = std::vector<midi::TimedMidiNote>(4);
+
+    static_assert(noexcept(midi::try_flatten_to_midi({}, 0, 0, pitch_map, {})));
+
+    SECTION("valid elements render like flatten_to_midi")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{.pitch = 0},
+            Sequence{{Cell{{Note{.pitch = 1}}, 1.f}, Cell{{Note{.pitch = 2}}, 1.f}}},
+        };
+        auto const expected = midi::flatten_to_midi(elements, 0, 100, pitch_map);
+
+        REQUIRE(midi::try_flatten_to_midi(elements, 0, 100, pitch_map,
+                                          std::span{buffer}) ==
+                midi::RenderResult{.note_count = 3, .status = midi::RenderStatus::ok});
+        REQUIRE(std::equal(expected.begin(), expected.end(), buffer.begin()));
+    }
+
+    SECTION("invalid sequences are skipped and reported")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{.pitch = 0},
+            Sequence{{Cell{{Note{.pitch = 1}}, 0.f}}},
+            Note{.pitch = 2},
+        };
+
+        auto const result =
+            midi::try_flatten_to_midi(elements, 0, 100, pitch_map, std::span{buffer});
+
+        REQUIRE(result.status == midi::RenderStatus::invalid_weight);
+        REQUIRE(result.note_count == 2);
+        REQUIRE(buffer[0].note == 69);
+        REQUIRE(buffer[1].note == 71);
+
+        REQUIRE_THROWS_AS(midi::flatten_to_midi(elements, 0, 100, pitch_map),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("flatten_to_midi_window renders only the notes in the window", "[midi]")
+{
+    auto const pitch_map = midi::PitchMap{twelve_edo(), base_frequency, pb_range};
+    auto const elements = std::vector<MusicElement>{
+        Sequence{{
+            // A delay of 1 gives a zero length note on the end of its cell.
+            Cell{{Note{.pitch = 0, .gate = 0.5f}, Note{.pitch = 5, .delay = 1.f}}, 1.f},
+            Cell{{
+                     Sequence{{
+                         Cell{{Note{.pitch = 1}, Note{.pitch = 6, .delay = 1.f}}, 1.f},
+                         Cell{{Note{.pitch = 2}}, 3.f},
+                     }},
+                     Note{.pitch = 3, .delay = 0.25f, .gate = 0.f},
+                 },
+                 2.f},
+            Cell{{}, 0.f},
+            Cell{{Note{.pitch = 4}}, 1.f},
+        }},
+    };
+    auto const all = midi::flatten_to_midi(elements, 100, 1'000, pitch_map);
+
+    SECTION("matches filtering the full render")
+    {
+        // Steps of 25 start windows on every cell boundary: 100, 350, 475 and 850.
+        for (auto begin = std::uint32_t{0}; begin < 1'200; begin += 25)
+        {
+            for (auto const length : {0u, 1u, 64u, 256u, 2'000u})
+            {
+                auto const end = begin + length;
+                auto expected = std::vector<midi::TimedMidiNote>{};
+                std::copy_if(all.begin(), all.end(), std::back_inserter(expected),
+                             [&](auto const &note) {
+                                 auto const empty = note.begin == note.end;
+                                 return begin < end && note.begin < end &&
+                                        (begin < note.end ||
+                                         (empty && begin <= note.begin));
+                             });
+
+                REQUIRE(midi::flatten_to_midi_window(elements, 100, 1'000, begin, end,
+                                                     pitch_map) == expected);
+            }
+        }
+    }
+
+    SECTION("zero length notes are reported where they begin")
+    {
+        auto const notes =
+            midi::flatten_to_midi_window(elements, 100, 1'000, 475, 476, pitch_map);
+
+        REQUIRE(std::ranges::any_of(notes, [](auto const &note) {
+            return note.note == 72 && note.begin == 475 && note.end == 475;
+        }));
+        REQUIRE(midi::flatten_to_midi_window(elements, 100, 1'000, 476, 500, pitch_map)
+                    .size() == 1);
+    }
+
+    SECTION("zero length notes on the end of a cell")
+    {
+        auto const touching = std::vector<MusicElement>{
+            Sequence{{
+                Cell{{Note{.pitch = 0, .delay = 1.f}}, 1.f},
+                Cell{{Note{.pitch = 1}}, 1.f},
+            }},
+        };
+        auto const notes =
+            midi::flatten_to_midi_window(touching, 0, 100, 50, 60, pitch_map);
+
+        REQUIRE(notes.size() == 2);
+        REQUIRE(notes[0].begin == 50);
+        REQUIRE(notes[0].end == 50);
+        REQUIRE(notes[1].begin == 50);
+        REQUIRE(notes[1].end == 100);
+    }
+
+    SECTION("cells outside the window are not visited")
+    {
+        auto const invalid = std::vector<MusicElement>{
+            Sequence{{
+                Cell{{Note{.pitch = 0}}, 1.f},
+                Cell{{Sequence{{Cell{{Note{}}, 0.f}}}}, 1.f},
+            }},
+        };
+        auto buffer = std::vector<midi::TimedMidiNote>(1);
+
+        REQUIRE(midi::try_flatten_to_midi_window(invalid, 0, 100, 0, 50, pitch_map,
+                                                 std::span{buffer}) ==
+                midi::RenderResult{.note_count = 1, .status = midi::RenderStatus::ok});
+        REQUIRE_THROWS_AS(
+            midi::flatten_to_midi_window(invalid, 0, 100, 50, 51, pitch_map),
+            std::invalid_argument);
+    }
+}
+
+TEST_CASE("flatten_to_midi_events produces a time-sorted event stream", "[midi]")
+{
+    using Kind = midi::MidiEvent::Kind;
+
+    auto const pitch_map = midi::PitchMap{grail_tuning(), base_frequency, pb_range};
+
+    // Splits the notes of flatten_to_midi into events and stable sorts them.
+    auto const split_and_sort = [&](std::vector<MusicElement> const &elements) {
+        auto expected = std::vector<midi::MidiEvent>{};
+        for (auto const &note : midi::flatten_to_midi(elements, 0, 9'973, pitch_map))
+        {
+            if (note.begin == note.end)
+            {
+                continue;
+            }
+            expected.push_back({note.begin, Kind::pitch_bend, note.note, note.velocity,
+                                note.pitch_bend});
+            expected.push_back({note.begin, Kind::note_on, note.note, note.velocity,
+                                note.pitch_bend});
+            expected.push_back(
+                {note.end, Kind::note_off, note.note, 0, note.pitch_bend});
+        }
+        std::ranges::stable_sort(expected, {}, [](midi::MidiEvent const &event) {
+            return std::pair{event.time, event.kind != Kind::note_off};
+        });
+        return expected;
+    };
+
+    SECTION("events of a single note")
+    {
+        auto const events = midi::flatten_to_midi_events(
+            std::vector<MusicElement>{Note{.pitch = 1, .velocity = 1.f, .gate = 0.5f}},
+            10, 100, pitch_map);
+        auto const note = midi::flatten_to_midi({Note{.pitch = 1, .velocity = 1.f}}, 0,
+                                                100, pitch_map)
+                              .front();
+
+        REQUIRE(events ==
+                std::vector<midi::MidiEvent>{
+                    {10, Kind::pitch_bend, note.note, 127, note.pitch_bend},
+                    {10, Kind::note_on, note.note, 127, note.pitch_bend},
+                    {60, Kind::note_off, note.note, 0, note.pitch_bend},
+                });
+    }
+
+    SECTION("matches sorting the split notes")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{.pitch = 0, .gate = 0.3f},
+            Sequence{{
+                Cell{{Note{.pitch = 1}, Note{.pitch = 2, .delay = 0.5f}}, 1.f},
+                Cell{{Sequence{{Cell{{Note{.pitch = 3, .gate = 0.1f}}, 1.f},
+                                Cell{{Note{.pitch = 4}}, 2.f}}},
+                      Note{.pitch = 5, .gate = 0.f},
+                      Note{.pitch = 6, .delay = 0.2f, .gate = 0.4f}},
+                     3.f},
+                Cell{{}, 1.f},
+            }},
+            Sequence{{Cell{{Note{.pitch = 7}}, 1.f}, Cell{{Note{.pitch = 8}}, 1.f}}},
+        };
+        auto const expected = split_and_sort(elements);
+
+        REQUIRE(midi::flatten_to_midi_events(elements, 0, 9'973, pitch_map) ==
+                expected);
+        REQUIRE(midi::flatten_to_midi_events(elements, 0, 9'973, grail_tuning(),
+                                             base_frequency, pb_range) == expected);
+    }
+
+    SECTION("several notes of one cell, out of time order")
+    {
+        auto const chord = Cell{
+            {
+                Note{.pitch = 0},
+                Note{.pitch = 1, .gate = 0.5f},
+                Note{.pitch = 2, .delay = 0.5f, .gate = 0.25f},
+                Sequence{{Cell{{Note{.pitch = 3}, Note{.pitch = 4}}, 1.f},
+                          Cell{{Note{.pitch = 5, .gate = 0.5f}}, 1.f}}},
+                Note{.pitch = 6, .delay = 0.25f},
+                Note{.pitch = 7, .gate = 0.5f},
+                Note{.pitch = 8, .delay = 1.f},
+            },
+            1.f,
+        };
+        auto const elements = std::vector<MusicElement>{
+            Sequence{{chord, chord, Cell{{Note{.pitch = 9}}, 2.f}}},
+        };
+
+        REQUIRE(midi::flatten_to_midi_events(elements, 0, 9'973, pitch_map) ==
+                split_and_sort(elements));
+    }
+
+    SECTION("a cell whose notes arrive in reverse time order")
+    {
+        auto cell = Cell{};
+        for (auto i = 0; i < 200; ++i)
+        {
+            auto const delay = static_cast<float>(199 - i) / 200.f;
+            cell.elements.push_back(
+                Note{.pitch = i % 12, .delay = delay, .gate = 0.5f});
+        }
+        auto const elements = std::vector<MusicElement>{Sequence{{cell, cell}}};
+
+        REQUIRE(midi::flatten_to_midi_events(elements, 0, 9'973, pitch_map) ==
+                split_and_sort(elements));
+    }
+
+    SECTION("invalid sequences throw")
+    {
+        auto const invalid = std::vector<MusicElement>{Sequence{}};
+
+        REQUIRE_THROWS_AS(midi::flatten_to_midi_events(invalid, 0, 100, pitch_map),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("lazy_flatten_to_midi yields notes in order of begin", "[midi]")
+{
+    auto const pitch_map = midi::PitchMap{twelve_edo(), base_frequency, pb_range};
+
+    auto song = Sequence{};
+    for (auto i = 0; i < 20; ++i)
+    {
+        song.cells.push_back(Cell{
+            {
+                Note{.pitch = i, .delay = 0.5f},
+                Sequence{{
+                    Cell{{Note{.pitch = -i}, Note{.pitch = i, .delay = 0.9f}}, 1.f},
+                    Cell{{Sequence{{Cell{{Note{.pitch = 1}}, 1.f}, Cell{{}, 1.f}}}},
+                         2.f},
+                }},
+            },
+            static_cast<float>(1 + i % 3),
+        });
+    }
+    auto const elements = std::vector<MusicElement>{
+        Note{.pitch = 0, .delay = 0.75f},
+        song,
+        Sequence{{Cell{{Note{.pitch = 9}}, 1.f}, Cell{{Note{.pitch = 8}}, 1.f}}},
+    };
+
+    auto lazy = std::vector<midi::TimedMidiNote>{};
+    for (auto const &note : midi::lazy_flatten_to_midi(elements, 7, 44'100, pitch_map))
+    {
+        lazy.push_back(note);
+    }
+
+    auto const by_begin = [](auto const &a, auto const &b) {
+        return a.begin < b.begin;
+    };
+    auto const expected = midi::flatten_to_midi(elements, 7, 44'100, pitch_map);
+
+    REQUIRE(std::ranges::is_sorted(lazy, by_begin));
+    REQUIRE(lazy.size() == expected.size());
+    REQUIRE(std::ranges::is_permutation(lazy, expected));
+
+    SECTION("invalid sequences throw when reached")
+    {
+        auto const invalid = std::vector<MusicElement>{
+            Sequence{{Cell{{Note{.pitch = 0}}, 1.f}, Cell{{Sequence{}}, 1.f}}},
+        };
+        auto generator = midi::lazy_flatten_to_midi(invalid, 0, 100, pitch_map);
+        auto it = generator.begin();
+
+        REQUIRE(it->note == 69);
+        REQUIRE_THROWS_AS(++it, std::invalid_argument);
+    }
+}
+
+TEST_CASE("flatten_to_midi_parallel matches the serial render", "[midi]")
+{
+    auto const pitch_map = midi::PitchMap{grail_tuning(), base_frequency, pb_range};
+
+    auto bars = Sequence{};
+    for (auto i = 0; i < 37; ++i)
+    {
+        bars.cells.push_back(Cell{
+            {
+                Note{.pitch = i, .gate = 0.5f},
+                Sequence{{
+                    Cell{{Note{.pitch = -i}}, 1.f},
+                    Cell{{Note{.pitch = i % 5}, Note{.pitch = 7}}, 2.f},
+                }},
+            },
+            static_cast<float>(1 + i % 4),
+        });
+    }
+    auto const elements = std::vector<MusicElement>{
+        Note{.pitch = 3},
+        bars,
+        Sequence{{Cell{{Note{.pitch = 1}}, 1.f}}},
+    };
+    auto const expected = midi::flatten_to_midi(elements, 11, 480'000, pitch_map);
+
+    for (auto const threads : {0u, 1u, 2u, 3u, 8u, 100u})
+    {
+        REQUIRE(midi::flatten_to_midi_parallel(elements, 11, 480'000, pitch_map,
+                                               threads) == expected);
+    }
+
+    REQUIRE(midi::flatten_to_midi_parallel({}, 0, 100, pitch_map).empty());
+
+    SECTION("invalid sequences throw")
+    {
+        auto invalid = elements;
+        std::get<Sequence>(invalid[1]).cells[20].elements.push_back(Sequence{});
+
+        REQUIRE_THROWS_AS(midi::flatten_to_midi_parallel(invalid, 0, 100, pitch_map, 4),
+                          std::invalid_argument);
+        auto const empty = std::vector<MusicElement>{Sequence{}};
+
+        REQUIRE_THROWS_AS(midi::flatten_to_midi_parallel(empty, 0, 100, pitch_map, 4),
+                          std::invalid_argument);
+    }
+}
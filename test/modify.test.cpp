@@ -1,9 +1,12 @@
 #include "catch.hpp"
 
 #include <algorithm>
+#include <variant>
 #include <vector>
 
+#include <sequence/flat.hpp>
 #include <sequence/modify.hpp>
+#include <sequence/persistent.hpp>
 #include <sequence/sequence.hpp>
 
 using namespace sequence;
@@ -437,3 +440,196 @@ TEST_CASE("cell and element overloads support common plugin-style selection", "[
     REQUIRE(collect_pitches(set_cell) == std::vector<int>{4, 4});
     REQUIRE(set_cell.weight == selected_cell.weight);
 }
+
+TEST_CASE("FlatSequence overloads match the Cell overloads", "[modify][flat]")
+{
+    auto const target = Cell{
+        .elements =
+            {
+                Note{9, 0.4f, 0.1f, 0.7f},
+                Sequence{{note_cell(0, 0.2f, 0.3f, 0.4f), silent_cell(),
+                          sequence_cell({note_cell(1), note_cell(2), note_cell(3)}),
+                          note_cell(-4, 0.9f, 0.8f, 0.9f)}},
+            },
+        .weight = 2.f,
+    };
+    auto const flat = to_flat(target);
+    auto const pattern = Pattern{0, {2}};
+
+    REQUIRE(from_flat(modify::shift_pitch(flat, pattern, 3)) ==
+            modify::shift_pitch(target, pattern, 3));
+    REQUIRE(from_flat(modify::shift_velocity(flat, pattern, 0.3f)) ==
+            modify::shift_velocity(target, pattern, 0.3f));
+    REQUIRE(from_flat(modify::shift_delay(flat, pattern, -0.2f)) ==
+            modify::shift_delay(target, pattern, -0.2f));
+    REQUIRE(from_flat(modify::shift_gate(flat, pattern, 0.5f)) ==
+            modify::shift_gate(target, pattern, 0.5f));
+    REQUIRE(from_flat(modify::set_pitch(flat, pattern, 5)) ==
+            modify::set_pitch(target, pattern, 5));
+    REQUIRE(from_flat(modify::set_octave(flat, pattern, 2, 12)) ==
+            modify::set_octave(target, pattern, 2, 12));
+    REQUIRE(from_flat(modify::set_velocity(flat, pattern, 2.f)) ==
+            modify::set_velocity(target, pattern, 2.f));
+    REQUIRE(from_flat(modify::set_delay(flat, pattern, 0.25f)) ==
+            modify::set_delay(target, pattern, 0.25f));
+    REQUIRE(from_flat(modify::set_gate(flat, pattern, -1.f)) ==
+            modify::set_gate(target, pattern, -1.f));
+    REQUIRE(from_flat(modify::mirror(flat, pattern, 2)) ==
+            modify::mirror(target, pattern, 2));
+
+    SECTION("randomize only touches selected notes")
+    {
+        auto const marked = modify::set_pitch(flat, pattern, 1'000);
+        auto const randomized = modify::randomize_pitch(flat, pattern, 100, 110);
+
+        for (auto i = std::size_t{0}; i < randomized.notes.size(); ++i)
+        {
+            if (marked.notes.pitch[i] == 1'000)
+            {
+                REQUIRE(randomized.notes.pitch[i] >= 100);
+                REQUIRE(randomized.notes.pitch[i] <= 110);
+            }
+            else
+            {
+                REQUIRE(randomized.notes.pitch[i] == flat.notes.pitch[i]);
+            }
+        }
+        REQUIRE_THROWS_AS(modify::randomize_gate(flat, pattern, 0.5f, 1.5f),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("inplace overloads match the value-returning overloads", "[modify][inplace]")
+{
+    auto const target = Cell{
+        .elements =
+            {
+                Note{9, 0.4f, 0.1f, 0.7f},
+                Sequence{{note_cell(0), silent_cell(),
+                          sequence_cell({note_cell(1), note_cell(2)}), note_cell(3)}},
+            },
+        .weight = 2.f,
+    };
+    auto const pattern = Pattern{0, {2}};
+
+    SECTION("attribute edits reuse the existing storage")
+    {
+        auto cell = target;
+        auto const *const elements = cell.elements.data();
+        auto const *const cells = std::get<Sequence>(cell.elements[1]).cells.data();
+
+        modify::inplace::shift_pitch(cell, pattern, 4);
+        modify::inplace::set_velocity(cell, pattern, 0.2f);
+        modify::inplace::mirror(cell, pattern, 1);
+
+        REQUIRE(cell == modify::mirror(modify::set_velocity(
+                                           modify::shift_pitch(target, pattern, 4),
+                                           pattern, 0.2f),
+                                       pattern, 1));
+        REQUIRE(cell.elements.data() == elements);
+        REQUIRE(std::get<Sequence>(cell.elements[1]).cells.data() == cells);
+    }
+
+    SECTION("structural edits")
+    {
+        auto rotated = target;
+        modify::inplace::rotate(rotated, -1);
+        REQUIRE(rotated == modify::rotate(target, -1));
+
+        auto reversed = target;
+        modify::inplace::reverse(reversed);
+        REQUIRE(reversed == modify::reverse(target));
+
+        auto repeated = target;
+        modify::inplace::repeat(repeated, 3);
+        REQUIRE(repeated == modify::repeat(target, 3));
+
+        auto repeated_element = target.elements[0];
+        modify::inplace::repeat(repeated_element, 2);
+        REQUIRE(repeated_element == modify::repeat(target.elements[0], 2));
+
+        auto stretched = target;
+        modify::inplace::stretch(stretched, pattern, 2);
+        REQUIRE(stretched == modify::stretch(target, pattern, 2));
+
+        auto compressed = target;
+        modify::inplace::compress(compressed, pattern);
+        REQUIRE(compressed == modify::compress(target, pattern));
+    }
+
+    SECTION("invalid arguments leave the target untouched")
+    {
+        auto cell = target;
+
+        REQUIRE_THROWS_AS(modify::inplace::randomize_velocity(cell, pattern, 0.5f, 2.f),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(modify::inplace::repeat(cell, 0), std::invalid_argument);
+        REQUIRE(cell == target);
+    }
+}
+
+TEST_CASE("Pipeline fuses edits that share a pattern", "[modify][pipeline]")
+{
+    auto const target = Cell{
+        .elements =
+            {
+                Note{9, 0.4f, 0.1f, 0.7f},
+                Sequence{{note_cell(0), silent_cell(),
+                          sequence_cell({note_cell(1), note_cell(2)}), note_cell(3)}},
+            },
+        .weight = 2.f,
+    };
+    auto const every = Pattern{0, {1}};
+    auto const even = Pattern{0, {2}};
+
+    auto pipeline = modify::Pipeline{};
+    pipeline.shift_pitch(every, 7)
+        .set_velocity(every, 0.5f)
+        .shift_gate(every, -0.2f)
+        .mirror(even, 4)
+        .set_delay(even, 0.25f);
+
+    REQUIRE(pipeline.stages().size() == 2);
+    REQUIRE(pipeline.stages()[0].edits.size() == 3);
+    REQUIRE(pipeline.stages()[1].edits.size() == 2);
+    REQUIRE(std::get<modify::edit::ShiftPitch>(pipeline.stages()[0].edits[0]).amount ==
+            7);
+    REQUIRE(std::holds_alternative<modify::edit::Mirror>(pipeline.stages()[1].edits[0]));
+
+    auto const chained = modify::set_delay(
+        modify::mirror(modify::shift_gate(modify::set_velocity(
+                                              modify::shift_pitch(target, every, 7),
+                                              every, 0.5f),
+                                          every, -0.2f),
+                       even, 4),
+        even, 0.25f);
+
+    REQUIRE(modify::apply(pipeline, target) == chained);
+    REQUIRE(modify::apply(pipeline, target.elements[1]) == chained.elements[1]);
+    REQUIRE(to_cell(modify::apply(pipeline, to_persistent(target))) == chained);
+
+    auto in_place = target;
+    modify::inplace::apply(pipeline, in_place);
+    REQUIRE(in_place == chained);
+
+    SECTION("randomized edits stay within bounds")
+    {
+        auto const randomized = modify::apply(
+            modify::Pipeline{}.randomize_velocity(every, 0.1f, 0.2f).set_pitch(every, 1),
+            target);
+
+        for_each_note(randomized, [](Note const &note) {
+            REQUIRE(note.pitch == 1);
+            REQUIRE(note.velocity >= 0.1f);
+            REQUIRE(note.velocity <= 0.2f);
+        });
+    }
+
+    SECTION("invalid arguments throw when the edit is added")
+    {
+        REQUIRE_THROWS_AS(modify::Pipeline{}.randomize_gate(every, 0.9f, 0.1f),
+                          std::invalid_argument);
+        REQUIRE_THROWS_AS(modify::Pipeline{}.set_octave(every, 1, 0),
+                          std::invalid_argument);
+    }
+}
@@ -0,0 +1,76 @@
+#include "catch.hpp"
+
+#include <stdexcept>
+
+#include <sequence/flat.hpp>
+#include <sequence/packed.hpp>
+#include <sequence/sequence.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto nested_cell() -> Cell
+{
+    return Cell{
+        .elements =
+            {
+                Note{.pitch = -9, .velocity = 0.4f, .delay = 0.123f},
+                Sequence{{
+                    Cell{{Note{.pitch = 300, .velocity = 1.f, .gate = 0.f}}, 1.f},
+                    Cell{{}, 2.f},
+                    Cell{{Sequence{{Cell{{Note{.pitch = 1}, Note{.pitch = 5}}, 1.f},
+                                    Cell{{Note{.pitch = 2, .gate = 0.3333f}}, 1.f}}}},
+                         1.f},
+                }},
+            },
+        .weight = 3.f,
+    };
+}
+
+} // namespace
+
+TEST_CASE("pack and unpack", "[packed]")
+{
+    SECTION("round trips within Note tolerance")
+    {
+        for (auto i = 0; i <= 1'000; ++i)
+        {
+            auto const value = static_cast<float>(i) / 1'000.f;
+            auto const note = Note{.pitch = i - 500, .velocity = value,
+                                   .delay = 1.f - value, .gate = value};
+
+            REQUIRE(unpack(pack(note)) == note);
+        }
+    }
+
+    SECTION("out of range notes throw")
+    {
+        REQUIRE_THROWS_AS(pack(Note{.pitch = 40'000}), std::out_of_range);
+        REQUIRE_THROWS_AS(pack(Note{.velocity = 1.5f}), std::out_of_range);
+        REQUIRE_THROWS_AS(pack(Note{.delay = -0.1f}), std::out_of_range);
+    }
+}
+
+TEST_CASE("PackedSequence round trips", "[packed]")
+{
+    auto const cell = nested_cell();
+    auto const packed = to_packed(cell);
+
+    REQUIRE(packed.cells.size() == 6);
+    REQUIRE(packed.notes.size() == 5);
+    REQUIRE(packed.sequences.size() == 2);
+
+    REQUIRE(from_packed(packed) == cell);
+    REQUIRE(from_flat(to_flat(packed)) == cell);
+    REQUIRE(from_packed(to_packed(Cell{})) == Cell{});
+
+    SECTION("to_flat restores the owning cell of each note")
+    {
+        auto const expected = to_flat(cell);
+        auto const actual = to_flat(packed);
+
+        REQUIRE(actual.notes.cell == expected.notes.cell);
+    }
+}
@@ -0,0 +1,189 @@
+#include "catch.hpp"
+
+#include <array>
+#include <cstddef>
+#include <variant>
+#include <vector>
+
+#include <sequence/modify.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+
+#include "helper.hpp"
+
+using namespace sequence;
+
+namespace
+{
+
+auto song() -> Cell
+{
+    auto const verse = Sequence{{
+        Cell{{Note{.pitch = 0}}, 1.f},
+        Cell{{Note{.pitch = 2}}, 1.f},
+        Cell{{}, 1.f},
+    }};
+    auto const chorus = Sequence{{
+        Cell{{Note{.pitch = 7}, Note{.pitch = 11}}, 1.f},
+        Cell{{Sequence{{Cell{{Note{.pitch = 4}}, 1.f}, Cell{{Note{.pitch = 5}}, 1.f}}}},
+             2.f},
+    }};
+
+    return Cell{
+        .elements = {Sequence{{Cell{{verse}, 1.f}, Cell{{chorus}, 1.f}}}},
+        .weight = 1.f,
+    };
+}
+
+auto root_sequence(PersistentCell const &cell) -> PersistentSequencePtr const &
+{
+    return std::get<PersistentSequencePtr>(cell.elements.front());
+}
+
+auto child_sequence(PersistentCell const &cell, std::size_t index)
+    -> PersistentSequencePtr const &
+{
+    return std::get<PersistentSequencePtr>(
+        root_sequence(cell)->cells[index].elements.front());
+}
+
+} // namespace
+
+TEST_CASE("to_cell round trips through to_persistent", "[persistent]")
+{
+    auto const cell = song();
+
+    REQUIRE(to_cell(to_persistent(cell)) == cell);
+    REQUIRE(to_cell(to_persistent(Cell{})) == Cell{});
+}
+
+TEST_CASE("transform_notes shares untouched subtrees", "[persistent]")
+{
+    auto const original = to_persistent(song());
+
+    SECTION("a pattern that skips a subtree leaves it shared")
+    {
+        // Only the verse, child 0 of the root sequence, is selected.
+        auto const edited = modify::shift_pitch(original, {0, {2}}, 12);
+
+        REQUIRE(child_sequence(edited, 0) != child_sequence(original, 0));
+        REQUIRE(child_sequence(edited, 1) == child_sequence(original, 1));
+        REQUIRE(to_cell(edited) == modify::shift_pitch(song(), {0, {2}}, 12));
+    }
+
+    SECTION("an edit that changes nothing returns the same nodes")
+    {
+        auto const edited = modify::set_velocity(original, {0, {1}}, 0.7f);
+
+        REQUIRE(root_sequence(edited) == root_sequence(original));
+    }
+
+    SECTION("the original tree is never modified")
+    {
+        auto const before = to_cell(original);
+        auto const edited = modify::mirror(original, {0, {1}}, 3);
+
+        REQUIRE(to_cell(original) == before);
+        REQUIRE(to_cell(edited) == modify::mirror(song(), {0, {1}}, 3));
+    }
+}
+
+TEST_CASE("persistent modify overloads match the Cell overloads", "[persistent]")
+{
+    auto const cell = song();
+    auto const tree = to_persistent(cell);
+    auto const pattern = Pattern{1, {1}};
+
+    REQUIRE(to_cell(modify::shift_velocity(tree, pattern, -0.3f)) ==
+            modify::shift_velocity(cell, pattern, -0.3f));
+    REQUIRE(to_cell(modify::set_octave(tree, pattern, 1, 12)) ==
+            modify::set_octave(cell, pattern, 1, 12));
+    REQUIRE(to_cell(modify::set_gate(tree, pattern, 0.5f)) ==
+            modify::set_gate(cell, pattern, 0.5f));
+    REQUIRE_THROWS_AS(modify::randomize_delay(tree, pattern, 0.9f, 0.1f),
+                      std::invalid_argument);
+}
+
+TEST_CASE("replace_cell rebuilds only the edited path", "[persistent]")
+{
+    auto const original = to_persistent(song());
+    auto const path = std::array{PathStep{0, 1}, PathStep{0, 0}};
+    auto const replacement = PersistentCell{.elements = {Note{.pitch = 60}}};
+
+    auto const edited = replace_cell(original, path, replacement);
+
+    REQUIRE(child_sequence(edited, 0) == child_sequence(original, 0));
+    REQUIRE(child_sequence(edited, 1) != child_sequence(original, 1));
+    REQUIRE(child_sequence(edited, 1)->cells[1].elements ==
+            child_sequence(original, 1)->cells[1].elements);
+    REQUIRE(std::get<Note>(child_sequence(edited, 1)->cells[0].elements.front()).pitch ==
+            60);
+    REQUIRE(to_cell(original) == song());
+
+    SECTION("invalid paths throw")
+    {
+        auto const bad_cell = std::array{PathStep{0, 5}};
+        auto const bad_element = std::array{PathStep{1, 0}};
+
+        REQUIRE_THROWS_AS(replace_cell(original, bad_cell, replacement),
+                          std::out_of_range);
+        REQUIRE_THROWS_AS(replace_cell(original, bad_element, replacement),
+                          std::out_of_range);
+    }
+}
+
+TEST_CASE("PersistentCell equality short-circuits on shared nodes", "[persistent]")
+{
+    auto const original = to_persistent(song());
+
+    REQUIRE(root_sequence(original)->structural_hash() != 0);
+    REQUIRE(original == original);
+    REQUIRE(to_persistent(song()) == original);
+
+    SECTION("an edit changes the cached hash of every node on its path")
+    {
+        auto const edited = modify::shift_pitch(original, {0, {2}}, 12);
+
+        REQUIRE(root_sequence(edited)->structural_hash() !=
+                root_sequence(original)->structural_hash());
+        REQUIRE_FALSE(edited == original);
+    }
+
+    SECTION("directly constructed nodes cache their hash")
+    {
+        auto const &root = *root_sequence(original);
+        auto const copy = PersistentSequence{root.cells};
+
+        REQUIRE(copy.structural_hash() == root.structural_hash());
+        REQUIRE(copy == root);
+    }
+
+    SECTION("float edits within tolerance compare equal")
+    {
+        auto const edited = modify::shift_velocity(original, {0, {1}}, 0.00001f);
+
+        REQUIRE(root_sequence(edited) != root_sequence(original));
+        REQUIRE(edited == original);
+    }
+}
+
+TEST_CASE("deeply nested persistent trees do not recurse", "[persistent]")
+{
+    auto constexpr depth = std::size_t{5'000};
+    auto const original = to_persistent(test::helper::deep_tree(depth));
+
+    auto const shifted = modify::shift_pitch(original, {0, {1}}, 7);
+    auto const cell = to_cell(shifted);
+
+    auto census = test::helper::TreeCensus{};
+    traverse(cell, census);
+
+    REQUIRE(census.sequences == depth);
+    REQUIRE(census.pitches == std::vector<int>{7});
+
+    auto persistent_census = test::helper::TreeCensus{};
+    traverse(original, persistent_census);
+
+    REQUIRE(persistent_census.sequences == depth);
+    REQUIRE(persistent_census.pitches == std::vector<int>{0});
+}
@@ -0,0 +1,262 @@
+#include "catch.hpp"
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sequence/sequence.hpp>
+#include <sequence/small_vector.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+template <typename T, std::size_t N>
+auto points_inside(SmallVector<T, N> const &v) -> bool
+{
+    auto const *const first = reinterpret_cast<std::byte const *>(&v);
+    auto const *const data = reinterpret_cast<std::byte const *>(v.data());
+    return data >= first && data < first + sizeof(v);
+}
+
+/// Counts live instances, and throws from the copy that exhausts copies_left.
+struct Fragile
+{
+    static inline int live = 0;
+    static inline int copies_left = 0;
+
+    int value = 0;
+
+    explicit Fragile(int v) : value{v}
+    {
+        ++live;
+    }
+
+    Fragile(Fragile const &other) : value{other.value}
+    {
+        if (copies_left-- == 0)
+        {
+            throw std::runtime_error{"Fragile: copy failed"};
+        }
+        ++live;
+    }
+
+    auto operator=(Fragile const &) -> Fragile & = default;
+
+    ~Fragile()
+    {
+        --live;
+    }
+};
+
+} // namespace
+
+TEST_CASE("SmallVector stores up to N elements inline", "[small_vector]")
+{
+    auto v = SmallVector<std::string, 2>{};
+
+    REQUIRE(v.empty());
+    REQUIRE(v.capacity() == 2);
+
+    v.push_back("a");
+    v.emplace_back("b");
+
+    REQUIRE(v.is_inline());
+    REQUIRE(points_inside(v));
+    REQUIRE(v.size() == 2);
+
+    SECTION("growing past N moves to the heap")
+    {
+        v.push_back("c");
+
+        REQUIRE_FALSE(v.is_inline());
+        REQUIRE_FALSE(points_inside(v));
+        REQUIRE(v == SmallVector<std::string, 2>{"a", "b", "c"});
+    }
+
+    SECTION("push_back of its own element survives reallocation")
+    {
+        v.push_back(v.front());
+
+        REQUIRE(v == SmallVector<std::string, 2>{"a", "b", "a"});
+    }
+
+    SECTION("erase and pop_back")
+    {
+        v.push_back("c");
+        v.erase(v.begin());
+
+        REQUIRE(v == SmallVector<std::string, 2>{"b", "c"});
+
+        v.pop_back();
+
+        REQUIRE(v == SmallVector<std::string, 2>{"b"});
+        REQUIRE_THROWS_AS(v.at(1), std::out_of_range);
+    }
+}
+
+TEST_CASE("SmallVector copy and move", "[small_vector]")
+{
+    SECTION("inline")
+    {
+        auto a = SmallVector<std::unique_ptr<int>, 1>{};
+        a.push_back(std::make_unique<int>(4));
+
+        auto b = std::move(a);
+
+        REQUIRE(a.empty());
+        REQUIRE(b.is_inline());
+        REQUIRE(*b.front() == 4);
+    }
+
+    SECTION("heap buffers are stolen")
+    {
+        auto a = SmallVector<int, 1>{1, 2, 3};
+        auto const *const data = a.data();
+
+        auto b = SmallVector<int, 1>{9};
+        b = std::move(a);
+
+        REQUIRE(b.data() == data);
+        REQUIRE(a.empty());
+        REQUIRE(a.is_inline());
+    }
+
+    SECTION("copies are deep")
+    {
+        auto const a = SmallVector<std::string, 1>{"x", "y"};
+        auto b = a;
+        b[0] = "z";
+
+        REQUIRE(a == SmallVector<std::string, 1>{"x", "y"});
+        REQUIRE(b != a);
+    }
+}
+
+TEST_CASE("SmallVector sequence container interface", "[small_vector]")
+{
+    using V = SmallVector<std::string, 2>;
+
+    SECTION("count constructors and assign")
+    {
+        REQUIRE(V(3) == V{"", "", ""});
+        REQUIRE(V(2, "a") == V{"a", "a"});
+
+        auto v = V{"x"};
+        v.assign(3, "b");
+        REQUIRE(v == V{"b", "b", "b"});
+
+        auto const source = std::vector<std::string>{"c", "d"};
+        v.assign(source.begin(), source.end());
+        REQUIRE(v == V{"c", "d"});
+
+        v = {"e"};
+        REQUIRE(v == V{"e"});
+    }
+
+    SECTION("insert and emplace")
+    {
+        auto v = V{"a", "d"};
+
+        REQUIRE(*v.insert(v.begin() + 1, "b") == "b");
+        REQUIRE(v == V{"a", "b", "d"});
+
+        v.emplace(v.end() - 1, "c");
+        REQUIRE(v == V{"a", "b", "c", "d"});
+
+        v.insert(v.begin(), 2, v.back());
+        REQUIRE(v == V{"d", "d", "a", "b", "c", "d"});
+
+        v.insert(v.end(), {"e", "f"});
+        REQUIRE(v == V{"d", "d", "a", "b", "c", "d", "e", "f"});
+    }
+
+    SECTION("resize")
+    {
+        auto v = V{"a", "b", "c"};
+
+        v.resize(1);
+        REQUIRE(v == V{"a"});
+
+        v.resize(3, "z");
+        REQUIRE(v == V{"a", "z", "z"});
+
+        v.resize(4);
+        REQUIRE(v.back().empty());
+    }
+
+    SECTION("swap and shrink_to_fit")
+    {
+        auto a = V{"a"};
+        auto b = V{"b", "c", "d"};
+
+        swap(a, b);
+
+        REQUIRE(a == V{"b", "c", "d"});
+        REQUIRE(b == V{"a"});
+        REQUIRE(b.is_inline());
+
+        a.pop_back();
+        a.shrink_to_fit();
+
+        REQUIRE(a.is_inline());
+        REQUIRE(a == V{"b", "c"});
+        REQUIRE(std::vector<std::string>(a.rbegin(), a.rend()) ==
+                std::vector<std::string>{"c", "b"});
+    }
+}
+
+TEST_CASE("SmallVector is unchanged when a copy throws", "[small_vector]")
+{
+    Fragile::live = 0;
+    Fragile::copies_left = 100;
+
+    SECTION("growing past the inline buffer")
+    {
+        auto v = SmallVector<Fragile, 2>{};
+        v.emplace_back(1);
+        v.emplace_back(2);
+
+        // Fragile has no move constructor, so reallocating copies, and the second
+        // copy throws after the new element and one old element were built.
+        Fragile::copies_left = 1;
+
+        REQUIRE_THROWS_AS(v.emplace_back(3), std::runtime_error);
+        REQUIRE(Fragile::live == 2);
+        REQUIRE(v.is_inline());
+        REQUIRE(v.size() == 2);
+        REQUIRE(v[0].value == 1);
+        REQUIRE(v[1].value == 2);
+    }
+
+    SECTION("inserting a range")
+    {
+        auto v = SmallVector<Fragile, 4>{};
+        v.emplace_back(1);
+        auto const source = std::vector<Fragile>(2, Fragile{7});
+        auto const before = Fragile::live;
+
+        Fragile::copies_left = 1;
+
+        REQUIRE_THROWS_AS(v.insert(v.begin(), source.begin(), source.end()),
+                          std::runtime_error);
+        REQUIRE(Fragile::live == before);
+        REQUIRE(v.size() == 1);
+        REQUIRE(v[0].value == 1);
+    }
+}
+
+TEST_CASE("single element Cells do not allocate", "[small_vector]")
+{
+    auto const note = Cell{{Note{.pitch = 3}}, 1.f};
+    auto const nested = Cell{{Sequence{{note, note}}}, 1.f};
+    auto const chord = Cell{{Note{.pitch = 0}, Note{.pitch = 4}}, 1.f};
+
+    REQUIRE(note.elements.is_inline());
+    REQUIRE(nested.elements.is_inline());
+    REQUIRE_FALSE(chord.elements.is_inline());
+    REQUIRE(Cell{}.elements.is_inline());
+}
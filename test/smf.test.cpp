@@ -0,0 +1,279 @@
+#include "catch.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/smf.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto bytes(std::stringstream const &ss) -> std::vector<std::uint8_t>
+{
+    auto const str = ss.str();
+    return {str.begin(), str.end()};
+}
+
+struct Event
+{
+    std::uint32_t tick;
+    std::uint8_t status;
+    std::uint8_t data1;
+    std::uint8_t data2;
+
+    auto operator==(Event const &) const -> bool = default;
+};
+
+/**
+ * @brief Reads the channel events of every track, checking the chunk lengths.
+ */
+auto read_tracks(std::vector<std::uint8_t> const &data)
+    -> std::vector<std::vector<Event>>
+{
+    auto at = std::size_t{0};
+    auto const u32 = [&] {
+        auto value = std::uint32_t{0};
+        for (auto i = 0; i < 4; ++i)
+        {
+            value = (value << 8) | data.at(at++);
+        }
+        return value;
+    };
+
+    REQUIRE(std::string(data.begin(), data.begin() + 4) == "MThd");
+    at = 4;
+    REQUIRE(u32() == 6);
+    auto const track_count = (data.at(10) << 8) | data.at(11);
+    at = 14;
+
+    auto tracks = std::vector<std::vector<Event>>{};
+    for (auto t = 0; t < track_count; ++t)
+    {
+        REQUIRE(std::string(data.begin() + at, data.begin() + at + 4) == "MTrk");
+        at += 4;
+        auto const length = u32();
+        auto const end = at + length;
+        REQUIRE(end <= data.size());
+
+        auto events = std::vector<Event>{};
+        auto tick = std::uint32_t{0};
+        auto status = std::uint8_t{0};
+        auto ended = false;
+        while (at < end)
+        {
+            auto delta = std::uint32_t{0};
+            auto byte = std::uint8_t{0x80};
+            while (byte & 0x80)
+            {
+                byte = data.at(at++);
+                delta = (delta << 7) | (byte & 0x7F);
+            }
+            tick += delta;
+
+            if (data.at(at) == 0xFF)
+            {
+                auto const type = data.at(at + 1);
+                at += 3 + data.at(at + 2);
+                status = 0;
+                ended = type == 0x2F;
+                continue;
+            }
+            if (data.at(at) & 0x80)
+            {
+                status = data.at(at++);
+            }
+            REQUIRE(status != 0);
+            events.push_back({tick, status, data.at(at), data.at(at + 1)});
+            at += 2;
+        }
+        REQUIRE(at == end);
+        REQUIRE(ended);
+        tracks.push_back(std::move(events));
+    }
+    REQUIRE(at == data.size());
+    return tracks;
+}
+
+// 48'000 samples per second at 120 bpm and 480 ticks per quarter is 50 samples a
+// tick.
+auto const settings = midi::SmfSettings{.sample_rate = 48'000, .bpm = 120.f};
+
+} // namespace
+
+TEST_CASE("write_smf writes a type 0 file", "[smf]")
+{
+    auto const notes = std::vector<midi::TimedMidiNote>{
+        {.begin = 0, .end = 24'000, .note = 60, .velocity = 100, .pitch_bend = 8'192},
+        {.begin = 24'000, .end = 48'000, .note = 62, .velocity = 90,
+         .pitch_bend = 8'192},
+    };
+    auto ss = std::stringstream{};
+
+    midi::write_smf(ss, notes, settings);
+
+    REQUIRE(bytes(ss) == std::vector<std::uint8_t>{
+        'M', 'T', 'h', 'd', 0, 0, 0, 6, 0, 0, 0, 1, 0x01, 0xE0,
+        'M', 'T', 'r', 'k', 0, 0, 0, 34,
+        0x00, 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20,
+        0x00, 0xFF, 0x58, 0x04, 4, 2, 24, 8,
+        0x00, 0x90, 60, 100,
+        // Running status, the note off is a note on with a velocity of 0.
+        0x83, 0x60, 60, 0,
+        0x00, 62, 90,
+        0x83, 0x60, 62, 0,
+        0x00, 0xFF, 0x2F, 0x00,
+    });
+}
+
+TEST_CASE("write_smf writes a type 1 file", "[smf]")
+{
+    auto const notes = std::vector<midi::TimedMidiNote>{
+        {.begin = 0, .end = 100, .note = 60, .velocity = 100, .pitch_bend = 8'192},
+    };
+    auto ss = std::stringstream{};
+    auto multi_track = settings;
+    multi_track.format = midi::SmfFormat::multi_track;
+    multi_track.time_signature = {6, 8};
+
+    midi::write_smf(ss, notes, multi_track);
+
+    auto const data = bytes(ss);
+    REQUIRE(data[9] == 1);
+    REQUIRE(data[11] == 2);
+    // The conductor track holds the time signature.
+    REQUIRE(data[22 + 19 - 8] == 6);
+    REQUIRE(data[22 + 19 - 7] == 3);
+
+    auto const tracks = read_tracks(data);
+    REQUIRE(tracks[0].empty());
+    REQUIRE(tracks[1] == std::vector<Event>{{0, 0x90, 60, 100}, {2, 0x90, 60, 0}});
+}
+
+TEST_CASE("SmfWriter orders note offs and pitch bends", "[smf]")
+{
+    auto ss = std::stringstream{};
+    {
+        auto writer = midi::SmfWriter{ss, settings};
+        writer.write(std::vector<midi::TimedMidiNote>{
+            {.begin = 0, .end = 1'000, .note = 60, .velocity = 100,
+             .pitch_bend = 8'192},
+            {.begin = 100, .end = 500, .note = 64, .velocity = 100,
+             .pitch_bend = 9'000, .channel = 1},
+            {.begin = 500, .end = 600, .note = 67, .velocity = 100,
+             .pitch_bend = 9'000, .channel = 1},
+            {.begin = 600, .end = 600, .note = 1, .velocity = 100,
+             .pitch_bend = 8'192},
+            {.begin = 700, .end = 800, .note = 69, .velocity = 100,
+             .pitch_bend = 8'192, .channel = 1},
+        });
+
+        REQUIRE(writer.event_count() == 8);
+        // The destructor finishes the file.
+    }
+
+    auto const tracks = read_tracks(bytes(ss));
+
+    REQUIRE(tracks[0] == std::vector<Event>{
+                             {0, 0x90, 60, 100},
+                             {2, 0xE1, 9'000 & 0x7F, 9'000 >> 7},
+                             {2, 0x91, 64, 100},
+                             {10, 0x91, 64, 0},
+                             {10, 0x91, 67, 100},
+                             {12, 0x91, 67, 0},
+                             {14, 0xE1, 0x00, 0x40},
+                             {14, 0x91, 69, 100},
+                             {16, 0x91, 69, 0},
+                             {20, 0x90, 60, 0},
+                         });
+}
+
+TEST_CASE("SmfWriter streams long files", "[smf]")
+{
+    auto ss = std::stringstream{};
+    auto writer = midi::SmfWriter{ss, settings};
+    auto const count = std::uint32_t{100'000};
+
+    for (auto i = std::uint32_t{0}; i < count; ++i)
+    {
+        auto const begin = i * 50;
+        writer.write(midi::TimedMidiNote{
+            .begin = begin,
+            .end = begin + 200,
+            .note = static_cast<std::uint8_t>(i % 128),
+            .velocity = 100,
+            .pitch_bend = 8'192,
+            .channel = static_cast<std::uint8_t>(i % 4),
+        });
+    }
+    writer.finish();
+
+    REQUIRE(writer.event_count() == 2 * count);
+    auto const tracks = read_tracks(bytes(ss));
+    REQUIRE(tracks[0].size() == 2 * count);
+    REQUIRE(tracks[0].back().tick == (count - 1) + 4);
+}
+
+TEST_CASE("SmfWriter validates its input", "[smf]")
+{
+    auto ss = std::stringstream{};
+
+    SECTION("settings")
+    {
+        auto invalid = settings;
+        invalid.ticks_per_quarter = 0x8000;
+        REQUIRE_THROWS_AS(midi::SmfWriter(ss, invalid), std::invalid_argument);
+
+        invalid = settings;
+        invalid.time_signature = {4, 3};
+        REQUIRE_THROWS_AS(midi::SmfWriter(ss, invalid), std::invalid_argument);
+
+        invalid = settings;
+        invalid.bpm = 0.f;
+        REQUIRE_THROWS_AS(midi::SmfWriter(ss, invalid), std::invalid_argument);
+    }
+
+    SECTION("note order")
+    {
+        auto writer = midi::SmfWriter{ss, settings};
+        writer.write(midi::TimedMidiNote{.begin = 10, .end = 20, .note = 60,
+                                         .velocity = 100, .pitch_bend = 8'192});
+
+        REQUIRE_THROWS_AS(writer.write(midi::TimedMidiNote{.begin = 5, .end = 20,
+                                                            .note = 60,
+                                                            .velocity = 100,
+                                                            .pitch_bend = 8'192}),
+                          std::invalid_argument);
+
+        writer.finish();
+        REQUIRE_THROWS_AS(writer.write(std::vector<midi::TimedMidiNote>{{}}),
+                          std::logic_error);
+    }
+}
+
+TEST_CASE("write_smf writes files", "[smf]")
+{
+    auto const path = std::filesystem::temp_directory_path() / "sequence_smf_test.mid";
+    auto const notes = std::vector<midi::TimedMidiNote>{
+        {.begin = 0, .end = 100, .note = 60, .velocity = 100, .pitch_bend = 8'192},
+    };
+
+    midi::write_smf(path, notes, settings);
+
+    auto file = std::ifstream{path, std::ios::binary};
+    auto const data = std::vector<std::uint8_t>(std::istreambuf_iterator<char>{file},
+                                                std::istreambuf_iterator<char>{});
+    file.close();
+    std::filesystem::remove(path);
+
+    REQUIRE(read_tracks(data)[0].size() == 2);
+}
@@ -0,0 +1,138 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/timeline.hpp>
+#include <sequence/tuning.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto note(std::uint32_t begin, std::uint32_t end, std::uint8_t pitch = 60)
+    -> midi::TimedMidiNote
+{
+    return {.begin = begin, .end = end, .note = pitch, .velocity = 100,
+            .pitch_bend = 8'192};
+}
+
+/**
+ * @brief The notes of \p notes for which \p predicate holds, in order.
+ */
+template <typename Predicate>
+auto filter(std::span<midi::TimedMidiNote const> notes, Predicate predicate)
+    -> std::vector<midi::TimedMidiNote>
+{
+    auto results = std::vector<midi::TimedMidiNote>{};
+    std::copy_if(notes.begin(), notes.end(), std::back_inserter(results), predicate);
+    return results;
+}
+
+} // namespace
+
+TEST_CASE("Timeline sorts notes by begin", "[timeline]")
+{
+    auto const timeline = midi::Timeline{{
+        note(50, 60, 1),
+        note(0, 100, 2),
+        note(50, 55, 3),
+        note(10, 10, 4),
+    }};
+
+    REQUIRE(std::ranges::equal(timeline.notes(), std::vector{
+                                                     note(0, 100, 2),
+                                                     note(10, 10, 4),
+                                                     note(50, 60, 1),
+                                                     note(50, 55, 3),
+                                                 }));
+    REQUIRE(midi::Timeline{}.empty());
+    REQUIRE(midi::Timeline{}.overlapping(0, 100).empty());
+    REQUIRE(midi::Timeline{}.active_at(0).empty());
+}
+
+TEST_CASE("Timeline queries match a linear scan", "[timeline]")
+{
+    // Long and short notes, with shared begins, zero lengths and gaps.
+    auto notes = std::vector<midi::TimedMidiNote>{};
+    for (auto i = std::uint32_t{0}; i < 97; ++i)
+    {
+        auto const begin = (i * 37) % 1'000;
+        auto const length = (i % 7 == 0) ? 400 : (i % 5 == 0) ? 0 : (i * 13) % 50;
+        notes.push_back(note(begin, begin + length, static_cast<std::uint8_t>(i)));
+    }
+    auto const timeline = midi::Timeline{notes};
+    auto const sorted = timeline.notes();
+
+    SECTION("overlapping")
+    {
+        for (auto begin = std::uint32_t{0}; begin < 1'500; begin += 29)
+        {
+            for (auto const length : {0u, 1u, 64u, 256u})
+            {
+                auto const end = begin + length;
+                auto const expected = filter(sorted, [&](auto const &n) {
+                    auto const empty = n.begin == n.end;
+                    return begin < end && n.begin < end &&
+                           (begin < n.end || (empty && begin <= n.begin));
+                });
+
+                REQUIRE(timeline.overlapping(begin, end) == expected);
+            }
+        }
+    }
+
+    SECTION("starting_in")
+    {
+        for (auto begin = std::uint32_t{0}; begin < 1'000; begin += 41)
+        {
+            auto const expected = filter(sorted, [&](auto const &n) {
+                return n.begin >= begin && n.begin < begin + 100;
+            });
+
+            REQUIRE(std::ranges::equal(timeline.starting_in(begin, begin + 100),
+                                       expected));
+        }
+    }
+
+    SECTION("active_at")
+    {
+        for (auto sample = std::uint32_t{0}; sample < 1'500; sample += 11)
+        {
+            auto const expected = filter(sorted, [&](auto const &n) {
+                return n.begin <= sample && sample < n.end;
+            });
+
+            REQUIRE(timeline.active_at(sample) == expected);
+        }
+    }
+}
+
+TEST_CASE("to_timeline compiles a rendered Cell", "[timeline]")
+{
+    auto const tuning = Tuning{{0.f, 200.f, 400.f, 500.f, 700.f, 900.f, 1100.f},
+                               1200.f, "major"};
+    auto const cell = Cell{
+        {
+            Note{.pitch = 0},
+            Sequence{{Cell{{Note{.pitch = 1}}, 1.f}, Cell{{Note{.pitch = 2}}, 1.f}}},
+        },
+        1.f,
+    };
+
+    auto const timeline = midi::to_timeline(cell, 0, 1'000, tuning, 440.f, 2.f);
+
+    REQUIRE(timeline.size() == 3);
+    REQUIRE(timeline.active_at(600).size() == 2);
+    REQUIRE(midi::to_timeline(cell, 0, 1'000, midi::PitchMap{tuning, 440.f, 2.f})
+                .overlapping(0, 1'000) == timeline.overlapping(0, 1'000));
+    REQUIRE_THROWS_AS(midi::to_timeline(cell, 0, 1'000, Tuning{}, 440.f, 2.f),
+                      std::invalid_argument);
+}
@@ -0,0 +1,197 @@
+#include "catch.hpp"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/modify.hpp>
+#include <sequence/persistent.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/traverse.hpp>
+
+#include "helper.hpp"
+
+using namespace sequence;
+
+namespace
+{
+
+/**
+ * @brief Records every callback as a short string, for Cell and PersistentCell trees.
+ */
+struct Recorder
+{
+    std::vector<std::string> events;
+    bool prune_sequences = false;
+    bool prune_cells = false;
+
+    auto note(Note const &note) -> void
+    {
+        events.push_back("n" + std::to_string(note.pitch));
+    }
+
+    auto enter_sequence(auto const &) -> bool
+    {
+        events.push_back("S(");
+        return !prune_sequences;
+    }
+
+    auto exit_sequence(auto const &) -> void
+    {
+        events.push_back(")S");
+    }
+
+    auto enter_cell(auto const &cell) -> bool
+    {
+        events.push_back("c" + std::to_string(static_cast<int>(cell.weight)) + "(");
+        return !prune_cells;
+    }
+
+    auto exit_cell(auto const &) -> void
+    {
+        events.push_back(")c");
+    }
+};
+
+struct SequenceCounter
+{
+    std::size_t count = 0;
+
+    auto enter_sequence(Sequence const &) -> void
+    {
+        ++count;
+    }
+};
+
+auto tree() -> Cell
+{
+    return Cell{
+        {
+            Note{.pitch = 0},
+            Sequence{{
+                Cell{{Note{.pitch = 1}}, 1.f},
+                Cell{{Sequence{{Cell{{Note{.pitch = 2}}, 3.f}}}}, 2.f},
+                Cell{{Note{.pitch = 3}, Note{.pitch = 4}}, 3.f},
+            }},
+        },
+        1.f,
+    };
+}
+
+} // namespace
+
+TEST_CASE("traverse visits depth-first, in pre- and post-order", "[traverse]")
+{
+    auto const cell = tree();
+    auto recorder = Recorder{};
+
+    SECTION("every cell")
+    {
+        traverse(cell, recorder);
+
+        REQUIRE(recorder.events ==
+                std::vector<std::string>{"n0", "S(", "c1(", "n1", ")c", "c2(", "S(",
+                                         "c3(", "n2", ")c", ")S", ")c", "c3(", "n3",
+                                         "n4", ")c", ")S"});
+    }
+
+    SECTION("pattern selected cells")
+    {
+        traverse(cell, Pattern{1, {1}}, recorder);
+
+        REQUIRE(recorder.events == std::vector<std::string>{"n0", "S(", "c2(", "S(",
+                                                            ")S", ")c", "c3(", "n3",
+                                                            "n4", ")c", ")S"});
+    }
+
+    SECTION("pruning")
+    {
+        recorder.prune_cells = true;
+        traverse(cell, recorder);
+
+        REQUIRE(recorder.events ==
+                std::vector<std::string>{"n0", "S(", "c1(", "c2(", "c3(", ")S"});
+
+        recorder.events.clear();
+        recorder.prune_sequences = true;
+        traverse(cell, recorder);
+
+        REQUIRE(recorder.events == std::vector<std::string>{"n0", "S("});
+    }
+
+    SECTION("an empty pattern throws when a Sequence is reached")
+    {
+        REQUIRE_THROWS_AS(traverse(cell, Pattern{0, {}}, recorder),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("traverse walks PersistentCell trees like Cell trees", "[traverse]")
+{
+    auto const cell = tree();
+    auto const persistent = to_persistent(cell);
+
+    auto expected = Recorder{};
+    traverse(cell, expected);
+    auto recorder = Recorder{};
+    traverse(persistent, recorder);
+
+    REQUIRE(recorder.events == expected.events);
+
+    SECTION("sequences are passed as their shared handles")
+    {
+        struct Handles
+        {
+            std::vector<PersistentSequence const *> nodes;
+
+            auto enter_sequence(PersistentSequencePtr const &seq) -> void
+            {
+                nodes.push_back(seq.get());
+            }
+        };
+        auto handles = Handles{};
+        traverse(persistent, handles);
+
+        auto const &outer = std::get<PersistentSequencePtr>(persistent.elements[1]);
+        auto const &inner =
+            std::get<PersistentSequencePtr>(outer->cells[1].elements[0]);
+        REQUIRE(handles.nodes ==
+                std::vector<PersistentSequence const *>{outer.get(), inner.get()});
+    }
+}
+
+TEST_CASE("traverse mutates through non-const trees", "[traverse]")
+{
+    auto cell = tree();
+    test::helper::modify_notes(cell, [](Note &note) { note.pitch += 10; });
+
+    auto pitches = std::vector<int>{};
+    test::helper::check_sequence(
+        cell, [&](Note const &note) { pitches.push_back(note.pitch); });
+
+    REQUIRE(pitches == std::vector<int>{10, 11, 12, 13, 14});
+}
+
+TEST_CASE("deeply nested trees do not recurse", "[traverse]")
+{
+    auto constexpr depth = std::size_t{5'000};
+    auto cell = test::helper::deep_tree(depth);
+
+    modify::inplace::shift_pitch(cell, {0, {1}}, 7);
+    modify::inplace::stretch(cell, {0, {1}}, 2);
+
+    auto const tuning = Tuning{{0.f, 200.f, 400.f, 500.f, 700.f, 900.f, 1100.f},
+                               1200.f, "major"};
+    auto const notes =
+        midi::flatten_to_midi(cell.elements, 0, 1'000, tuning, 440.f, 2.f);
+
+    REQUIRE(notes.size() == 2);
+
+    auto counter = SequenceCounter{};
+    traverse(cell, counter);
+
+    REQUIRE(counter.count == depth + 1);
+}
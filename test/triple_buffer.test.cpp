@@ -0,0 +1,109 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/midi_buffer.hpp>
+#include <sequence/triple_buffer.hpp>
+
+using namespace sequence;
+
+TEST_CASE("TripleBuffer hands the latest value to the reader", "[triple_buffer]")
+{
+    auto buffer = TripleBuffer<std::string>{"initial"};
+
+    REQUIRE(buffer.read() == "initial");
+
+    SECTION("reads see the most recent publish")
+    {
+        buffer.publish("first");
+        buffer.publish("second");
+
+        REQUIRE(buffer.read() == "second");
+        REQUIRE(buffer.read() == "second");
+    }
+
+    SECTION("back is filled in place")
+    {
+        buffer.back() = "edited";
+        REQUIRE(buffer.read() == "initial");
+
+        buffer.publish();
+        REQUIRE(buffer.read() == "edited");
+    }
+
+    SECTION("the writer never gets the value being read")
+    {
+        buffer.publish("a");
+        auto const &reading = buffer.read();
+        buffer.back() = "b";
+        buffer.publish();
+        buffer.back() = "c";
+        buffer.publish();
+
+        REQUIRE(reading == "a");
+        REQUIRE(buffer.read() == "c");
+    }
+}
+
+TEST_CASE("NoteBuffer reuses the capacity of old renders", "[triple_buffer]")
+{
+    auto buffer = midi::NoteBuffer{};
+    for (auto i = 0; i < 3; ++i)
+    {
+        buffer.back().assign(100, midi::TimedMidiNote{});
+        buffer.publish();
+        (void)buffer.read();
+    }
+
+    auto &back = buffer.back();
+    auto const *const data = back.data();
+    back.clear();
+    back.resize(100);
+
+    REQUIRE(back.data() == data);
+}
+
+TEST_CASE("TripleBuffer reads are consistent across threads", "[triple_buffer]")
+{
+    auto buffer = midi::NoteBuffer{};
+    auto constexpr generations = SampleTime{20'000};
+    auto done = std::atomic<bool>{false};
+
+    auto writer = std::thread{[&] {
+        for (auto generation = SampleTime{1}; generation <= generations; ++generation)
+        {
+            auto &notes = buffer.back();
+            notes.assign(generation % 7 + 1,
+                         midi::TimedMidiNote{.begin = generation, .end = generation,
+                                             .note = 60, .velocity = 100,
+                                             .pitch_bend = 8'192});
+            buffer.publish();
+        }
+        done = true;
+    }};
+
+    auto last = SampleTime{0};
+    auto consistent = true;
+    while (!done || last != generations)
+    {
+        auto const &notes = buffer.read();
+        if (notes.empty())
+        {
+            continue;
+        }
+        auto const generation = notes.front().begin;
+        consistent = consistent && generation >= last &&
+                     notes.size() == generation % 7 + 1 &&
+                     notes.back().begin == generation;
+        last = generation;
+    }
+    writer.join();
+
+    REQUIRE(consistent);
+    REQUIRE(last == generations);
+}
@@ -0,0 +1,243 @@
+#include "catch.hpp"
+
+#include <cstdint>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include <sequence/midi.hpp>
+#include <sequence/sequence.hpp>
+#include <sequence/timing.hpp>
+#include <sequence/tuning.hpp>
+#include <sequence/ump.hpp>
+
+using namespace sequence;
+
+namespace
+{
+
+auto pitch_map() -> midi::PitchMap
+{
+    // A4 and a note three quarter tones above it.
+    return midi::PitchMap{Tuning{{0.f, 150.f}, 1200.f, ""}, 440.f, 2.f};
+}
+
+// 48'000 samples per second at 120 bpm and 480 ticks per quarter is 50 samples a
+// tick.
+auto const settings = midi::UmpSettings{.sample_rate = 48'000, .bpm = 120.f};
+
+constexpr auto ticks_per_quarter = std::uint32_t{0x0030'01E0};
+constexpr auto center = std::uint32_t{0x8000'0000};
+
+} // namespace
+
+TEST_CASE("UmpRenderer encodes notes as MIDI 2.0 packets", "[ump]")
+{
+    auto renderer = midi::UmpRenderer{pitch_map(), settings};
+    auto out = std::vector<std::uint32_t>(32);
+
+    SECTION("a single note")
+    {
+        auto const elements = std::vector<MusicElement>{Note{.velocity = 1.f}};
+        auto const result = renderer.render(elements, 0, 4'800, out);
+
+        REQUIRE(result == midi::UmpResult{8, midi::RenderStatus::ok});
+        out.resize(result.word_count);
+        REQUIRE(out == std::vector<std::uint32_t>{
+                           ticks_per_quarter,
+                           0x4060'4500, center, // Per-note pitch bend of key 69.
+                           0x4090'4500, 0xFFFF'0000, // Note on, full velocity.
+                           0x0040'0060,              // 96 ticks.
+                           0x4080'4500, 0x0000'0000, // Note off.
+                       });
+    }
+
+    SECTION("bends are 32-bit and only sent when they change")
+    {
+        auto const elements = std::vector<MusicElement>{Sequence{{
+            Cell{{Note{.pitch = 1, .velocity = 1.f}}, 1.f},
+            Cell{{Note{.pitch = 1, .velocity = 1.f}}, 1.f},
+        }}};
+        auto const result = renderer.render(elements, 0, 9'600, out);
+
+        // A quarter tone over a range of 48 semitones.
+        auto const bend = static_cast<std::uint32_t>(2'147'483'648. +
+                                                     0.5 / 48. * 2'147'483'648.);
+        REQUIRE(result.word_count == 13);
+        out.resize(result.word_count);
+        REQUIRE(out == std::vector<std::uint32_t>{
+                           ticks_per_quarter,
+                           0x4060'4600, bend,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x0040'0060,
+                           0x4080'4600, 0x0000'0000,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x0040'0060,
+                           0x4080'4600, 0x0000'0000,
+                       });
+    }
+
+    SECTION("overlapping notes are time ordered")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{.velocity = 1.f, .gate = 0.5f},
+            Note{.velocity = 1.f, .delay = 0.25f},
+        };
+        auto const result = renderer.render(elements, 1'000, 4'000, out);
+
+        out.resize(result.word_count);
+        REQUIRE(out == std::vector<std::uint32_t>{
+                           ticks_per_quarter,
+                           0x4060'4500, center,
+                           0x4090'4500, 0xFFFF'0000,
+                           0x0040'0014,
+                           0x4090'4500, 0xFFFF'0000,
+                           0x0040'0014,
+                           0x4080'4500, 0x0000'0000,
+                           0x0040'0028,
+                           0x4080'4500, 0x0000'0000,
+                       });
+    }
+
+    SECTION("group and channel")
+    {
+        auto addressed = settings;
+        addressed.group = 3;
+        addressed.channel = 9;
+        renderer = midi::UmpRenderer{pitch_map(), addressed};
+
+        auto const elements = std::vector<MusicElement>{Note{}};
+        renderer.render(elements, 0, 4'800, out);
+
+        REQUIRE(out[3] == 0x4399'4500);
+    }
+}
+
+TEST_CASE("UmpRenderer keeps the bends of overlapping notes on one key", "[ump]")
+{
+    // A4, and two pitches on key 70 a quarter tone apart.
+    auto const map =
+        midi::PitchMap{Tuning{{0.f, 100.f, 150.f}, 1200.f, ""}, 440.f, 2.f};
+    auto renderer = midi::UmpRenderer{map, settings};
+    auto out = std::vector<std::uint32_t>(32);
+    auto const bend = static_cast<std::uint32_t>(2'147'483'648. +
+                                                 0.5 / 48. * 2'147'483'648.);
+
+    SECTION("a different bend moves to the next channel")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{.pitch = 1, .velocity = 1.f},
+            Note{.pitch = 2, .velocity = 1.f},
+        };
+        auto const result = renderer.render(elements, 0, 4'800, out);
+
+        out.resize(result.word_count);
+        REQUIRE(out == std::vector<std::uint32_t>{
+                           ticks_per_quarter,
+                           0x4060'4600, center,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x4061'4600, bend, // Channel 1.
+                           0x4091'4600, 0xFFFF'0000,
+                           0x0040'0060,
+                           0x4080'4600, 0x0000'0000,
+                           0x4081'4600, 0x0000'0000,
+                       });
+    }
+
+    SECTION("the same bend, or a silent key, stays on the channel")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Sequence{{
+                Cell{{Note{.pitch = 1, .velocity = 1.f}}, 1.f},
+                Cell{{Note{.pitch = 2, .velocity = 1.f}}, 1.f},
+            }},
+            Note{.pitch = 1, .velocity = 1.f, .gate = 0.5f},
+        };
+        auto const result = renderer.render(elements, 0, 9'600, out);
+
+        out.resize(result.word_count);
+        REQUIRE(out == std::vector<std::uint32_t>{
+                           ticks_per_quarter,
+                           0x4060'4600, center,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x0040'0060,
+                           0x4080'4600, 0x0000'0000,
+                           0x4080'4600, 0x0000'0000,
+                           0x4060'4600, bend,
+                           0x4090'4600, 0xFFFF'0000,
+                           0x0040'0060,
+                           0x4080'4600, 0x0000'0000,
+                       });
+    }
+}
+
+TEST_CASE("UmpRenderer splits long Delta Clockstamps", "[ump]")
+{
+    auto renderer = midi::UmpRenderer{pitch_map(), settings};
+    auto out = std::vector<std::uint32_t>(16);
+    auto const elements = std::vector<MusicElement>{Note{.delay = 0.5f}};
+    auto const count = std::uint32_t{104'858'000};
+
+    auto const result = renderer.render(elements, 0, count, out);
+
+    auto const begin = samples_to_ticks(count / 2, 48'000, 120.f, 480);
+    REQUIRE(begin > 0xF'FFFF);
+    REQUIRE(result.word_count == 11);
+    REQUIRE(out[1] == 0x004F'FFFF);
+    REQUIRE(out[2] == (0x0040'0000 | (begin - 0xF'FFFF)));
+}
+
+TEST_CASE("UmpRenderer reports what it cannot write", "[ump]")
+{
+    auto renderer = midi::UmpRenderer{pitch_map(), settings};
+
+    SECTION("buffers too small for the stream")
+    {
+        auto out = std::vector<std::uint32_t>(4, 0);
+        auto const elements = std::vector<MusicElement>{Note{}, Note{.pitch = 1}};
+
+        REQUIRE(renderer.render(elements, 0, 4'800, std::span{out}.first(2)) ==
+                midi::UmpResult{14, midi::RenderStatus::ok});
+        REQUIRE(out[2] == 0);
+    }
+
+    SECTION("invalid weights")
+    {
+        auto const elements = std::vector<MusicElement>{
+            Note{}, Sequence{{Cell{{Note{}}, 0.f}}}};
+        auto out = std::vector<std::uint32_t>(16);
+
+        REQUIRE(renderer.render(elements, 0, 4'800, out) ==
+                midi::UmpResult{8, midi::RenderStatus::invalid_weight});
+    }
+
+    SECTION("invalid settings")
+    {
+        auto invalid = settings;
+        invalid.pitch_bend_range = 0.f;
+        REQUIRE_THROWS_AS(midi::UmpRenderer(pitch_map(), invalid),
+                          std::invalid_argument);
+
+        invalid = settings;
+        invalid.channel = 16;
+        REQUIRE_THROWS_AS(midi::UmpRenderer(pitch_map(), invalid),
+                          std::invalid_argument);
+
+        invalid = settings;
+        invalid.ticks_per_quarter = 0;
+        REQUIRE_THROWS_AS(midi::UmpRenderer(pitch_map(), invalid),
+                          std::invalid_argument);
+    }
+}
+
+TEST_CASE("PitchMap::fractional_note keeps the pitch MicrotonalNote quantizes",
+          "[ump]")
+{
+    auto const map = pitch_map();
+
+    REQUIRE(map.fractional_note(0) == Approx(69.f));
+    REQUIRE(map.fractional_note(1) == Approx(70.5f));
+    REQUIRE(map(1).note == 70);
+    REQUIRE(map.fractional_note(-1000) == 0.f);
+}